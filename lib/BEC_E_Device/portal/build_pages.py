@@ -0,0 +1,41 @@
+#!/usr/bin/env python3
+"""Compresses the provisioning portal pages into src/Portal/portal_pages.h.
+
+Run this after editing any of the .html files next to it. The pages are
+stored gzipped in flash and sent as-is with Content-Encoding: gzip.
+"""
+
+import gzip
+import os
+
+HERE = os.path.dirname(os.path.abspath(__file__))
+OUTPUT = os.path.join(HERE, "..", "src", "Portal", "portal_pages.h")
+
+
+def c_array(name, data):
+    lines = []
+    for i in range(0, len(data), 16):
+        lines.append("    " + ", ".join("0x%02x" % b for b in data[i:i + 16]) + ",")
+    return "const uint8_t %s[] PROGMEM = {\n%s\n};\n" % (name, "\n".join(lines))
+
+
+def main():
+    parts = [
+        "#pragma once\n",
+        "// generated by portal/build_pages.py from the pages in portal/. Don't edit by hand\n",
+        "#include <Arduino.h>\n",
+    ]
+
+    for page in sorted(f for f in os.listdir(HERE) if f.endswith(".html")):
+        with open(os.path.join(HERE, page), "rb") as f:
+            # mtime=0 keeps the output the same between runs
+            data = gzip.compress(f.read(), compresslevel=9, mtime=0)
+        parts.append("\n// %s\n" % page)
+        parts.append(c_array(page.replace(".", "_") + "_gz", data))
+
+    with open(OUTPUT, "w") as f:
+        f.write("".join(parts))
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,146 @@
+#!/usr/bin/env python3
+"""Reports the RAM each flash-resident command saves, after every build.
+
+Add it to the project with
+
+    extra_scripts = post:lib/BEC_E_Device/scripts/command_ram_report.py
+
+or run it by hand with `command_ram_report.py firmware.elf`.
+
+Command tables are found by their symbol: any array in flash whose name
+ends in "commands" and whose size is a whole number of Command structs,
+like built_in_commands in Commands.cpp. Give tables passed to
+BEC_E::register_commands a name ending in "commands" to have them
+reported too. A command
+saves its Command struct, its name and its option list, which all sat
+in RAM before the tables moved to flash.
+"""
+
+import re
+import struct
+import sys
+
+# packed Command on the ESP8266: name, id, type, additional_args, additional_arg_num, receive_command_function
+COMMAND = struct.Struct("<IHiIBI")
+ARG_VALUE_SIZE = 4
+DROPDOWN = 4
+
+# the ESP8266 maps flash from here, RAM is below it
+FLASH_START = 0x40200000
+
+
+class Elf:
+    def __init__(self, path):
+        with open(path, "rb") as f:
+            self.data = f.read()
+
+        if self.data[:4] != b"\x7fELF" or self.data[4] != 1:
+            raise ValueError("%s isn't a 32 bit ELF file" % path)
+
+        shoff, = struct.unpack_from("<I", self.data, 0x20)
+        shentsize, shnum, _ = struct.unpack_from("<HHH", self.data, 0x2E)
+
+        self.sections = []
+        for i in range(shnum):
+            name, kind, _, addr, offset, size, link = struct.unpack_from("<IIIIIII", self.data, shoff + i * shentsize)
+            self.sections.append({"name": name, "type": kind, "addr": addr, "offset": offset, "size": size, "link": link})
+
+        self.symbols = {}
+        self.by_address = {}
+        for section in self.sections:
+            # SHT_SYMTAB
+            if section["type"] != 2:
+                continue
+
+            strings = self.sections[section["link"]]
+            for offset in range(section["offset"], section["offset"] + section["size"], 16):
+                name, value, size, info, _, _ = struct.unpack_from("<IIIBBH", self.data, offset)
+                # STT_OBJECT
+                if info & 0xF != 1:
+                    continue
+
+                symbol = self.string(strings, name)
+                self.symbols[symbol] = (value, size)
+                self.by_address[value] = size
+
+    def string(self, section, offset):
+        start = section["offset"] + offset
+        return self.data[start:self.data.index(b"\0", start)].decode()
+
+    def read(self, address, length):
+        # SHT_PROGBITS sections hold what is loaded at their address
+        for section in self.sections:
+            if section["type"] == 1 and section["addr"] <= address < section["addr"] + section["size"]:
+                start = section["offset"] + address - section["addr"]
+                return self.data[start:start + length]
+
+        return None
+
+    def c_string(self, address):
+        data = self.read(address, 256)
+        return data[:data.index(b"\0")].decode(errors="replace") if data else "?"
+
+    def object_size(self, address, fallback):
+        return self.by_address.get(address, fallback)
+
+
+def plain_name(symbol):
+    # constexpr tables have internal linkage, which g++ mangles as _ZL<length><name>
+    match = re.match(r"_ZL(\d+)(\w+)", symbol)
+    if match:
+        symbol = match.group(2)[:int(match.group(1))]
+
+    return symbol.split(".")[0]
+
+
+def command_tables(elf):
+    for symbol, (address, size) in sorted(elf.symbols.items()):
+        name = plain_name(symbol)
+        if (name.endswith("commands") and address >= FLASH_START and size > 0 and size % COMMAND.size == 0
+                and elf.read(address, size) is not None):
+            yield name, address, size // COMMAND.size
+
+
+def report(path):
+    elf = Elf(path)
+
+    print("RAM saved by flash-resident commands")
+    total = 0
+    for table, address, count in command_tables(elf):
+        print("  %s" % table)
+
+        for i in range(count):
+            name, command_id, kind, args, arg_count, _ = COMMAND.unpack(elf.read(address + i * COMMAND.size, COMMAND.size))
+            text = elf.c_string(name) if name else ""
+
+            saved = COMMAND.size
+            saved += elf.object_size(name, len(text) + 1) if name else 0
+            if args:
+                saved += elf.object_size(args, arg_count * ARG_VALUE_SIZE)
+
+                # dropdown options are strings of their own
+                if kind == DROPDOWN:
+                    for j in range(arg_count):
+                        option, = struct.unpack("<I", elf.read(args + j * ARG_VALUE_SIZE, ARG_VALUE_SIZE))
+                        saved += elf.object_size(option, len(elf.c_string(option)) + 1)
+
+            print("    %5d %-24s %4d bytes" % (command_id, text, saved))
+            total += saved
+
+    print("  total %d bytes" % total)
+
+    # what is still in RAM for commands
+    for symbol in ("registered_commands", "command_tables"):
+        if symbol in elf.symbols:
+            print("  %s still uses %d bytes of RAM" % (symbol, elf.symbols[symbol][1]))
+
+
+if __name__ == "__main__":
+    if len(sys.argv) != 2:
+        sys.exit("usage: command_ram_report.py firmware.elf")
+
+    report(sys.argv[1])
+else:
+    Import("env")  # noqa: F821, provided by PlatformIO
+
+    env.AddPostAction("$BUILD_DIR/${PROGNAME}.elf", lambda target, source, env: report(str(target[0])))  # noqa: F821
@@ -1,177 +1,96 @@
 #include "BEC_E_Device.h"
 
-#include <EEPROM.h>
 #include <Arduino.h>
 
 #include "debug.h"
-#include "EEPROM/BEC_E_EEPROM.h"
+#include "Config/Config.h"
 #include "Network/Network.h"
 #include "Commands/Commands.h"
-#include "Packet/Packet.h"
-#include "Areana/Arena.h"
+#include "Connection/Connection.h"
+#include "Offline/Offline.h"
+#include "Portal/Portal.h"
+#include "Tasks/Tasks.h"
+#include "Events/Events.h"
+#include "Reporting/Reporting.h"
+#include "Local/Local.h"
+#include "FrameStream/FrameStream.h"
 
 // array of loop functions defaulting to a null function
 void (*loop_functions[MAX_LOOP_FUNCTION_NUM])() = {nullptr};
 
 // function prototypes
 void run_loop_functions();
-uint8_t* read_in_packet(PacketHeader header);
 
 namespace BEC_E {
     void main_setup(){
         DBG_INIT(115200);
         DBG_PRINTLN("");
-        EEPROM.begin(1 + SSID_SIZE + WIFI_PASSWORD_SIZE + SERVER_IP_SIZE);
 
-        // check for magic to see if the eeprom has been reset
-        if (EEPROM.read(0) != EEPROM_MAGIC){
-            DBG_PRINTLN("EEPROM magic number missed");
-            run_AP();
-        }
-
-        // clear the EEPROM if there is a new EEPROM version we have to follow
-        if (EEPROM.read(1) != EEPROM_VERSION){
-            DBG_PRINTLN("new EEPROM version");
-
-            clear_EEPROM();
-
-            // record the new EEPROM version
-            EEPROM.write(1, EEPROM_VERSION);
+        // load the saved config, bringing it up to date if it was written by an older version
+        config_begin();
 
-            // resetup wifi
-            run_AP();
-        }
-
-        // read in the ssid
-        DBG_PRINTLN("reading the ssid");
-        for (int i = 0; i < SSID_SIZE; i++){
-            ssid[i] = EEPROM.read(2 + i);
-        }
+        // the server's report subscriptions survive a restart
+        reporting_begin();
 
-        // read in the password
-        DBG_PRINTLN("reading the password");
-        for (int i = 0; i < WIFI_PASSWORD_SIZE; i++){
-            password[i] = EEPROM.read(2 + SSID_SIZE + i);
+        // set up wifi if it has never been configured
+        if (!config_get_string(CONFIG_SSID, ssid, SSID_SIZE)){
+            DBG_PRINTLN("no saved network");
+            portal_start();
         }
+        else {
+            config_get_string(CONFIG_PASSWORD, password, WIFI_PASSWORD_SIZE);
+            config_get_string(CONFIG_SERVER_IP, server_ip, SERVER_IP_SIZE);
 
-        // read in the server ip
-        DBG_PRINTLN("reading the server ip");
-        for (int i = 0; i < SERVER_IP_SIZE; i++){
-            server_ip[i] = EEPROM.read(2 + SSID_SIZE + WIFI_PASSWORD_SIZE + i);
-        }
-
-        // try to connect to wifi and set up AP if the saved values fail
-        if (! connect_wifi(ssid, password)){
-            run_AP();
-        }
-
-        int attempts = 0;
-
-        // attempt to connect to TCP
-        DBG_PRINTLN("\nconnecting to TCP");
-        while (!tcp_client.connect(server_ip, SERVER_PORT_TCP)){
-            attempts ++;
-            delay(1000);
-
-            // if we try and connect too many time then run the ap again incase the ip was wrong
-            if (attempts >= TCP_CONNECTION_ATTEMPTS){
-                run_AP();
+            // try to connect to wifi and set up AP if the saved values fail. The saved network keeps being retried
+            if (! connect_wifi(ssid, password)){
+                portal_start();
             }
         }
 
-        BEC_E::send_log(DEVICE_NAME "_" DEVICE_ID " CONNECTED");
-        DBG_PRINTF("connected to %s", server_ip);
-
-        // connect to udp
-        if (USE_UDP){
-            DBG_PRINTLN("\nconnecting to UDP");
-            udp_client.begin(SERVER_PORT_UDP);
-
-            // get the port
-            uint16_t port = SERVER_PORT_UDP;
-
-            // build buffer and specify the data type
-            uint8_t buffer[1 + sizeof(uint16_t)];
-            buffer[0] = Argument::UINT16;
-
-            // copy the port into the buffer
-            memcpy(buffer + 1, &port, sizeof(uint16_t));
-
-            // build the header
-            PacketHeader header = build_packet_header(ESTABLISH_UDP, 0, 1, sizeof(buffer), 1);
-            
-            // tell the server to start listening to UDP
-            send_TCP(header, buffer);
+        // find anything left in flash from the last time we were offline
+        if (USE_OFFLINE_STORE){
+            offline_begin();
         }
 
-        init_registered_commands();
+        // the connection is made from the main loop
+        connection_begin();
+
+        // listen for commands from the LAN if enabled
+        local_begin();
     }
 
     void main_loop(){
-        run_loop_functions();
-
-        // TODO: implement heartbeat packet
-        
-        // skip packet stuff if we don't even have a client conencted
-        // DBG_PRINTF("\nclient connected = %d | client available = %d\n", tcp_client.connected(), tcp_client.available());
-        if (!tcp_client.connected() || !tcp_client.available()) return;
-        DBG_PRINTLN("\nbytes available");
-
-        // read in header
-        PacketHeader header;
-        if (tcp_client.readBytes((char*)&header, sizeof(PacketHeader)) != sizeof(PacketHeader)){
-            return;
-        }
-        DBG_PRINTF("read in header:\n");
-        DBG_PRINTF("\tmagic: %d\n", header.magic);
-        DBG_PRINTF("\tcommand_set: %d\n", header.command_set);
-        DBG_PRINTF("\ttype: %d\n", header.type);
-        DBG_PRINTF("\tpacket_id: %d\n", header.packet_id);
-        DBG_PRINTF("\tpacket_num: %d\n", header.packet_num);
-        DBG_PRINTF("\ttotal_packets: %d\n", header.total_packets);
-        DBG_PRINTF("\tpayload_len: %d\n", header.payload_len);
-        DBG_PRINTF("\targument_number: %d\n", header.argument_number);
-
-        // get the packet
-        uint8_t* buffer = read_in_packet(header);
-        if (buffer == nullptr) return;
-        DBG_PRINTLN("read in rest of packet");
-        
-        // check the crc
-        if (!validate_crc(buffer, header)){
-            handle_bad_packet(header);
-            arena_free();
+        network_step();
+        application_step();
 
-            BEC_E::send_log("CRC mismatch!");
-            DBG_PRINTLN("CRC mismatch");
+        // nothing else to do until the server sends something
+        if (BEC_E_IDLE_MS > 0 && !frame_stream_busy()) events_wait(BEC_E_IDLE_MS);
+    }
 
+    void register_command(struct Command command){
+        // add the command if there is room
+#if MAX_REGISTERED_COMMAND_NUM > 0
+        if (registered_command_count < MAX_REGISTERED_COMMAND_NUM){
+            registered_commands[registered_command_count] = command;
+            registered_command_count ++;
             return;
         }
+#endif
 
-        // handle the command
-        if (!handle_command(header, buffer)){
-            BEC_E::send_log("Unknown command");
-            DBG_PRINTLN("unknown command");
+        while (true){
+            Serial.println("Registered command buffer too small");
+            delay(10 * 1000);
         }
-
-        arena_free();
     }
 
-    void register_command(struct Command command){
-        // set up a pointer to the next available spot
-        static int command_pointer = 0;
+    bool register_commands(const Command* commands, uint8_t count){
+        if (command_table_count >= MAX_COMMAND_TABLES) return false;
 
-        // add the command if there is room
-        if (command_pointer < MAX_REGISTERED_COMMAND_NUM){
-            registered_commands[command_pointer] = command;
-            command_pointer ++;
-        }
-        else {
-            while (true){
-                Serial.println("Registered command buffer too small");
-                delay(10 * 1000);
-            }
-        }
+        // only the pointer is kept, the table stays in flash
+        command_tables[command_table_count] = {commands, count};
+        command_table_count ++;
+
+        return true;
     }
 
     void register_loop_function(void (*loop_function)()){
@@ -192,38 +111,34 @@ namespace BEC_E {
     }
 
     PacketHeader build_packet_header(uint16_t type, uint16_t packet_num, uint16_t total_packets, uint16_t payload_len, uint8_t argument_number){
-        static uint32 packet_id = 0;
-        PacketHeader return_header = {MAGIC, COMMAND_SET, type, packet_id++, packet_num, total_packets, payload_len, argument_number};
+        static uint32 next_packet_id = 0;
+        uint32_t packet_id = next_packet_id++;
+        PacketHeader return_header = {MAGIC, COMMAND_SET, type, packet_id, packet_num, total_packets, payload_len, argument_number};
 
         return return_header;
     }
 
-    void send_TCP(PacketHeader header, uint8_t* data){
-        // make sure the server is still connected
-        if (!tcp_client.connected()){
-            tcp_client.connect(server_ip, SERVER_PORT_TCP);
-        }
-
+    bool send_TCP(PacketHeader header, uint8_t* data, send_policy policy){
         // get the total size of the data send
         size_t total_length = sizeof(PacketHeader) + header.payload_len;
-        
-        // make a buffer for the data
-        uint8_t* buffer = new uint8_t[total_length];
+
+        // make a buffer for the data and the crc
+        uint8_t* buffer = new uint8_t[total_length + sizeof(uint16_t)];
 
         // add data to the buffer
         memcpy(buffer, &header, sizeof(PacketHeader));
         memcpy(buffer + sizeof(PacketHeader), data, header.payload_len);
 
-        // calculate the crc
+        // calculate the crc and add it to the end
         uint16_t crc = calculate_crc16(buffer, total_length);
+        memcpy(buffer + total_length, &crc, sizeof(crc));
 
-        // send the packet
-        tcp_client.write(buffer, total_length);
-
-        // send the crc
-        tcp_client.write((const uint8_t*)&crc, sizeof(crc));
+        // send the packet, or queue it if the server is down
+        bool sent = connection_send(buffer, total_length + sizeof(crc), policy);
 
         delete[] buffer;
+
+        return sent;
     }
 
     void send_UDP(PacketHeader header, void* data){
@@ -241,7 +156,7 @@ namespace BEC_E {
         uint16_t crc = calculate_crc16(buffer, total_length);
 
         // start packet to the server
-        udp_client.beginPacket(server_ip, SERVER_PORT_UDP);
+        udp_client.beginPacket(server_ip, server_port_udp);
         
         // add the packet
         udp_client.write(buffer, total_length);
@@ -276,25 +191,8 @@ void run_loop_functions(){
         if (loop_functions[i] == nullptr) return;
 
         loop_functions[i]();
-    }
-}
-
-uint8_t* read_in_packet(PacketHeader header){
-    // allocate memory for the full packet
-    uint16_t total_len = sizeof(PacketHeader) + header.payload_len;
-    uint8_t* buffer = arena_malloc(total_len);
-    if (buffer == nullptr) return nullptr;
-
-    // copy in the header
-    memcpy(buffer, &header, sizeof(PacketHeader));
 
-    // read in the rest of the packet
-    int received = tcp_client.readBytes((char*)buffer + sizeof(PacketHeader), header.payload_len);
-
-    // verify the length
-    if (received != header.payload_len) {
-        return nullptr;
+        // commands that came in while it ran don't wait for the rest of the loop
+        handle_received();
     }
-
-    return buffer;
-}
\ No newline at end of file
+}
@@ -16,6 +16,11 @@
 #define USE_UDP false
 #endif
 
+// bytes of records a telemetry batch can hold
+#ifndef TELEMETRY_BATCH_SIZE
+#define TELEMETRY_BATCH_SIZE 256
+#endif
+
 #ifndef CURRENT_VERSION
 #define CURRENT_VERSION "0.0.0"
 #endif
@@ -23,6 +28,7 @@
 #define MAGIC 0xBECE
 #define COMMAND_SET 0
 
+#include <stddef.h>
 #include <stdint.h>
 
 // struct for receiving RGB colors
@@ -44,6 +50,11 @@ union ArgValue {
     float       float_val;
     Color       color_val;
     const char* str_val;
+
+    // lets option lists be constexpr so they can go in flash
+    ArgValue() = default;
+    constexpr ArgValue(uint8_t value) : uint8_val(value) {}
+    constexpr ArgValue(const char* value) : str_val(value) {}
 };
 
 namespace Argument{
@@ -73,16 +84,35 @@ enum command_type {
     STRONG_BUTTON = 7, // no data passed. Shown as a button but requires a confirmation
 };
 
-// struct for commands
+// struct for commands. The name and additional arguments can be in PROGMEM
 struct Command {
     const char* name;                                   // the display name
     uint16_t id;                                        // the unique ID. Will be sent by server to call function
     command_type type;                                  // the type of command, used to determine what is shown on the webpage
-    ArgValue* additional_args;                          // additional arguments to be passed to the server
+    const ArgValue* additional_args;                    // additional arguments to be passed to the server
     uint8_t additional_arg_num;                         // the number of additional arguments
     void (*receive_command_function)(ArgValue*, uint8_t); // the function to be called with the response
 } __attribute__((packed));
 
+// checks a constexpr command table while compiling. Use it as static_assert(command_ids_unique(table), "...")
+template<size_t N>
+constexpr bool command_ids_unique(const Command (&table)[N]){
+    for (size_t i = 0; i < N; i++){
+        for (size_t j = i + 1; j < N; j++){
+            if (table[i].id == table[j].id) return false;
+        }
+    }
+
+    return true;
+}
+
+// what to do with a packet sent while the server is disconnected
+enum send_policy : uint8_t {
+    SEND_QUEUE = 0, // keep it in the send queue until the server is back, dropping it if the queue is full
+    SEND_DROP  = 1, // fail straight away
+    SEND_PERSIST = 2, // keep it in flash until the server is back and replay it in order. Needs USE_OFFLINE_STORE
+};
+
 // struct for packet headers. Packed so that it can easily be sent
 struct PacketHeader {
     uint16_t magic;           // the magic bytes indicating it is a valid packet
@@ -95,15 +125,80 @@ struct PacketHeader {
     uint8_t argument_number;  // the number of arguments in the payload
 } __attribute__((packed)); 
 
+// counters for the UDP frame stream
+struct FrameStats {
+    float fps;                  // frames sent over the last second
+    uint32_t bytes_per_second;  // bytes sent over the last second
+    uint32_t frames_sent;       // frames sent since boot
+    uint32_t frames_dropped;    // frames replaced by a newer one before they were sent
+};
+
+// telemetry records waiting to be sent together. Only the time between records is stored, so batching
+// doesn't lose when each value was taken
+struct TelemetryBatch {
+    uint16_t channel;                    // which series the records belong to
+    uint16_t count;                      // records in the batch
+    uint16_t length;                     // bytes of data in use
+    uint64_t base_us;                    // device time of the first record
+    uint64_t last_us;                    // device time of the last record
+    uint8_t data[TELEMETRY_BATCH_SIZE];  // the encoded records
+};
+
+// how the samples of a channel are reduced before they are sent
+enum sample_mode : uint8_t {
+    SAMPLE_RAW      = 0, // every sample
+    SAMPLE_DECIMATE = 1, // the min, max and mean of every `decimation` samples
+    SAMPLE_ON_CHANGE = 2, // only read for server subscriptions, never batched
+};
+
+// a value read at a fixed rate and sent in batches
+struct SampleChannel {
+    uint16_t id;                 // the unique ID the server sees the samples under
+    Argument::arg_type type;     // what read_sample returns. Strings and colors can't be sampled
+    uint32_t period_us;          // time between samples. For SAMPLE_ON_CHANGE the fastest it may be read
+    ArgValue (*read_sample)();   // the function called to take a sample
+    sample_mode mode;            // raw or decimated
+    uint16_t decimation;         // samples per record in SAMPLE_DECIMATE mode
+    float scale;                 // float samples are sent as round(value * scale), so 100 keeps 2 decimal places
+};
+
+// how a command finished, sent back to the server in a REPLY
+enum reply_status : uint8_t {
+    REPLY_OK              = 0, // done, any results follow
+    REPLY_ERROR           = 1, // the command failed
+    REPLY_UNKNOWN_COMMAND = 2, // no command has that id
+    REPLY_TIMEOUT         = 3, // a deferred command didn't complete in time
+    REPLY_BUSY            = 4, // too many deferred commands already running
+};
+
+// long running work called from the main loop with its token and context until it returns true
+typedef bool (*scheduled_function)(uint32_t, void*);
+
 // functions that should be available to users of the library
 namespace BEC_E {
     void main_setup(); // sets up the wifi and the server connections
     void main_loop(); // manages the server and runs the user defined loop functions
-    void register_command(struct Command); // adds a command to the user commands list
+    void register_command(struct Command); // adds a command to the user commands list. Copies it into RAM, prefer register_commands
+    bool register_commands(const Command*, uint8_t); // adds a constexpr PROGMEM table of commands, returns false if there is no room
     void register_loop_function(void (*loop_function)(ArgValue*)); // adds a function to the user defined loop functions
     PacketHeader build_packet_header(uint16_t, uint16_t, uint16_t, uint16_t, uint8_t); // builds a packet header removing the need to worry about all fields
     void send_log(const char *); // sends a log message to the server
-    void send_TCP(PacketHeader, uint8_t*); // sends a packet over TCP
+    bool send_TCP(PacketHeader, uint8_t*, send_policy = SEND_QUEUE); // sends a packet over TCP, returns false if it was dropped
     void send_UDP(PacketHeader, uint8_t*); // sends a packet over UDP
     void safe_delay(unsigned long); // delays for the specified time but runs the main loop while waiting
+    uint8_t* begin_frame(); // gets a FRAME_SLOT_SIZE buffer to write the next frame into, nullptr if a frame is already open
+    void commit_frame(uint32_t); // streams the frame written into the begin_frame buffer over UDP
+    FrameStats get_frame_stats(); // gets the frame stream counters
+    int64_t server_time_us(); // gets the server time in microseconds since the epoch, 0 until the clock is synced
+    int64_t device_to_server_us(uint64_t); // converts a micros64() time to server time, 0 until the clock is synced
+    void begin_batch(TelemetryBatch&, uint16_t); // empties a batch and sets its channel
+    bool add_to_batch(TelemetryBatch&, float); // adds a value taken now, returns false if the batch is full
+    bool add_to_batch(TelemetryBatch&, uint64_t, float); // adds a value taken at a micros64() time, returns false if the batch is full
+    bool send_batch(TelemetryBatch&, send_policy = SEND_QUEUE); // sends the batch and empties it
+    bool register_sample_channel(const SampleChannel&); // starts sampling a channel, returns false if there is no room
+    bool reply(reply_status, const ArgValue* = nullptr, const Argument::arg_type* = nullptr, uint8_t = 0); // answers the command being handled with a status and typed results. Commands that don't reply get REPLY_OK
+    uint32_t defer_reply(); // lets the command being handled return before it is done. Returns the token for complete_reply, 0 if too many are waiting
+    bool complete_reply(uint32_t, reply_status, const ArgValue* = nullptr, const Argument::arg_type* = nullptr, uint8_t = 0); // answers a deferred command
+    bool schedule(scheduled_function, uint32_t, void*, uint32_t = 0); // runs a function every interval ms until it returns true, with a token and context passed back
+    bool set_state(uint16_t, Argument::arg_type, ArgValue); // records a new value for a stateful command changed on the device, so the server is told. Returns false if it can't be tracked
 }
@@ -0,0 +1,101 @@
+#include <Arduino.h>
+
+#include "Capture.h"
+
+#include "Network/Network.h"
+
+static_assert(CAPTURE_RING_SIZE <= 0xFFFF, "CAPTURE_RING_SIZE must fit the dump offsets");
+
+#if USE_CAPTURE
+// records stored as [CaptureRecord][frame] in a ring
+uint8_t capture_ring[CAPTURE_RING_SIZE];
+uint16_t capture_head;
+uint16_t capture_used;
+uint32_t capture_dropped;
+
+// stops the dump overwriting the records it is sending
+bool capture_paused;
+
+void capture_read(uint16_t offset, uint8_t* data, uint16_t length);
+void capture_write(uint16_t offset, const uint8_t* data, uint16_t length);
+#endif
+
+void capture_record(capture_direction direction, const uint8_t* frame, uint16_t length){
+#if USE_CAPTURE
+    if (capture_paused) return;
+
+    // the dump going out shouldn't end up in the next one
+    PacketHeader header;
+    memcpy(&header, frame, sizeof(header));
+    if (direction == CAPTURE_TX && header.type == CAPTURE_DUMP) return;
+
+    uint16_t needed = sizeof(CaptureRecord) + length;
+    if (needed > CAPTURE_RING_SIZE){
+        capture_dropped ++;
+        return;
+    }
+
+    // drop the oldest records until there is room
+    while ((uint32_t)capture_used + needed > CAPTURE_RING_SIZE){
+        CaptureRecord oldest;
+        capture_read(capture_head, (uint8_t*)&oldest, sizeof(oldest));
+
+        uint16_t oldest_size = sizeof(CaptureRecord) + oldest.length;
+        capture_head = (capture_head + oldest_size) % CAPTURE_RING_SIZE;
+        capture_used -= oldest_size;
+        capture_dropped ++;
+    }
+
+    CaptureRecord record = {(uint32_t)micros(), direction, length};
+    uint16_t tail = (capture_head + capture_used) % CAPTURE_RING_SIZE;
+    capture_write(tail, (const uint8_t*)&record, sizeof(record));
+    capture_write((tail + sizeof(record)) % CAPTURE_RING_SIZE, frame, length);
+    capture_used += needed;
+#endif
+}
+
+void capture_dump(){
+#if USE_CAPTURE
+    capture_paused = true;
+
+    uint16_t total = capture_used;
+    uint16_t packets = (total + CAPTURE_BYTES_PER_PACKET - 1) / CAPTURE_BYTES_PER_PACKET;
+    uint32_t now = micros();
+
+    // send the ring oldest first, a packet at a time
+    uint8_t buffer[sizeof(CaptureDumpHeader) + CAPTURE_BYTES_PER_PACKET];
+    for (uint16_t offset = 0; offset < total; offset += CAPTURE_BYTES_PER_PACKET){
+        uint16_t length = min<uint16_t>(CAPTURE_BYTES_PER_PACKET, total - offset);
+
+        CaptureDumpHeader dump = {now, capture_dropped, offset, total, length};
+        memcpy(buffer, &dump, sizeof(dump));
+        capture_read((capture_head + offset) % CAPTURE_RING_SIZE, buffer + sizeof(dump), length);
+
+        PacketHeader header = BEC_E::build_packet_header(CAPTURE_DUMP, offset / CAPTURE_BYTES_PER_PACKET, packets, sizeof(dump) + length, 0);
+        BEC_E::send_TCP(header, buffer);
+    }
+
+    capture_paused = false;
+#else
+    BEC_E::send_log("Capture is compiled out, build with USE_CAPTURE true");
+#endif
+}
+
+void handle_send_capture(ArgValue _args[], uint8_t _arg_number){
+    capture_dump();
+}
+
+#if USE_CAPTURE
+void capture_read(uint16_t offset, uint8_t* data, uint16_t length){
+    // in at most two pieces
+    uint16_t first = min<uint16_t>(length, CAPTURE_RING_SIZE - offset);
+    memcpy(data, capture_ring + offset, first);
+    memcpy(data + first, capture_ring, length - first);
+}
+
+void capture_write(uint16_t offset, const uint8_t* data, uint16_t length){
+    uint16_t first = min<uint16_t>(length, CAPTURE_RING_SIZE - offset);
+    memcpy(capture_ring + offset, data, first);
+    memcpy(capture_ring, data + first, length - first);
+}
+#endif
@@ -0,0 +1,46 @@
+#pragma once
+
+#include <stdint.h>
+
+#include "BEC_E_Device.h"
+
+// record the frames going to and from the server, so the stream a device saw can be replayed with tools/capture_replay
+#ifndef USE_CAPTURE
+#define USE_CAPTURE false
+#endif
+
+// bytes of records kept in RAM. The oldest are dropped to make room
+#ifndef CAPTURE_RING_SIZE
+#define CAPTURE_RING_SIZE 4096
+#endif
+
+// bytes of records sent per CAPTURE_DUMP packet
+#ifndef CAPTURE_BYTES_PER_PACKET
+#define CAPTURE_BYTES_PER_PACKET 512
+#endif
+
+enum capture_direction : uint8_t {
+    CAPTURE_RX = 0, // received from the server, before the crc is checked
+    CAPTURE_TX = 1, // handed to the connection to send
+};
+
+// written in front of every frame in the ring
+struct CaptureRecord {
+    uint32_t timestamp_us; // micros() when the frame was captured
+    uint8_t direction;     // capture_direction
+    uint16_t length;       // length of the frame that follows, with its crc
+} __attribute__((packed));
+
+// sent in front of the records of each CAPTURE_DUMP packet. The records are split across packets wherever they fall
+struct CaptureDumpHeader {
+    uint32_t now_us;       // micros() when the dump started
+    uint32_t dropped;      // records dropped since boot to make room, or because they didn't fit the ring
+    uint16_t offset;       // where this packet's bytes start in the dump
+    uint16_t total_bytes;  // bytes of records in the whole dump
+    uint16_t length;       // bytes of records in this packet
+} __attribute__((packed));
+
+// function prototypes for internal functions
+void capture_record(capture_direction direction, const uint8_t* frame, uint16_t length);
+void capture_dump();
+void handle_send_capture(ArgValue *, uint8_t);
@@ -0,0 +1,152 @@
+#include <Arduino.h>
+
+#include "Clock.h"
+
+#include "debug.h"
+#include "Network/Network.h"
+#include "Connection/Connection.h"
+
+// the last CLOCK_SAMPLES exchanges, oldest overwritten first
+ClockSample clock_samples[CLOCK_SAMPLES];
+uint8_t clock_sample_count;
+uint8_t clock_next_sample;
+
+// fitted line: server time = device time + clock_offset_us + clock_drift * (device time - clock_reference_us)
+bool clock_locked;
+uint64_t clock_reference_us;
+int64_t clock_offset_us;
+double clock_drift;
+
+// the request waiting for a reply
+uint32_t clock_sequence;
+uint64_t clock_request_us;
+bool clock_waiting;
+unsigned long clock_last_request_ms;
+
+void send_clock_request();
+void fit_clock();
+
+namespace BEC_E {
+    int64_t device_to_server_us(uint64_t device_us){
+        if (!clock_locked) return 0;
+
+        int64_t elapsed = (int64_t)(device_us - clock_reference_us);
+        return (int64_t)device_us + clock_offset_us + (int64_t)(clock_drift * elapsed);
+    }
+
+    int64_t server_time_us(){
+        return device_to_server_us(micros64());
+    }
+} // BEC_E namespace
+
+void clock_tick(){
+    if (tcp_state != CONNECTION_CONNECTED){
+        clock_waiting = false;
+        return;
+    }
+
+    unsigned long since_request = millis() - clock_last_request_ms;
+
+    // the reply was lost, try again
+    if (clock_waiting && since_request >= CLOCK_REPLY_TIMEOUT_MS){
+        clock_waiting = false;
+    }
+
+    if (clock_waiting) return;
+
+    // fill the window quickly after boot, then only keep up with the drift
+    unsigned long interval = clock_sample_count < CLOCK_SAMPLES ? CLOCK_FAST_SYNC_INTERVAL_MS : CLOCK_SYNC_INTERVAL_MS;
+    if (clock_last_request_ms != 0 && since_request < interval) return;
+
+    send_clock_request();
+}
+
+void send_clock_request(){
+    clock_sequence ++;
+    clock_request_us = micros64();
+    clock_last_request_ms = millis();
+    if (clock_last_request_ms == 0) clock_last_request_ms = 1;
+    clock_waiting = true;
+
+    // the server answers with the Clock Sync command, echoing the sequence
+    uint8_t buffer[1 + sizeof(uint32_t)];
+    buffer[0] = Argument::UINT32;
+    memcpy(buffer + 1, &clock_sequence, sizeof(uint32_t));
+
+    PacketHeader header = BEC_E::build_packet_header(CLOCK_REQUEST, 0, 1, sizeof(buffer), 1);
+    BEC_E::send_TCP(header, buffer, SEND_DROP);
+}
+
+void handle_clock_sync(ArgValue args[], uint8_t arg_number){
+    uint64_t reply_us = micros64();
+
+    // sequence, then the server receive and send times as seconds and microseconds since the epoch
+    if (arg_number < 5 || !clock_waiting || args[0].uint32_val != clock_sequence) return;
+    clock_waiting = false;
+
+    int64_t receive_us = (int64_t)args[1].uint32_val * 1000000 + args[2].uint32_val;
+    int64_t send_us = (int64_t)args[3].uint32_val * 1000000 + args[4].uint32_val;
+
+    // the usual four timestamp exchange. The offset assumes both directions take as long
+    int64_t held_us = send_us - receive_us;
+    int64_t round_trip_us = (int64_t)(reply_us - clock_request_us);
+    if (held_us < 0 || round_trip_us < held_us) return;
+
+    ClockSample& sample = clock_samples[clock_next_sample];
+    sample.local_us = clock_request_us + round_trip_us / 2;
+    sample.offset_us = ((receive_us - (int64_t)clock_request_us) + (send_us - (int64_t)reply_us)) / 2;
+    sample.delay_us = round_trip_us - held_us;
+
+    clock_next_sample = (clock_next_sample + 1) % CLOCK_SAMPLES;
+    if (clock_sample_count < CLOCK_SAMPLES) clock_sample_count ++;
+
+    fit_clock();
+}
+
+void fit_clock(){
+    // only trust the exchanges that weren't held up on the way
+    uint32_t fastest = UINT32_MAX;
+    for (int i = 0; i < clock_sample_count; i++){
+        fastest = min(fastest, clock_samples[i].delay_us);
+    }
+
+    uint32_t limit = fastest * CLOCK_DELAY_FILTER + 1000;
+
+    // least squares line through the offsets, measured from the newest sample
+    uint64_t reference = clock_samples[(clock_next_sample + CLOCK_SAMPLES - 1) % CLOCK_SAMPLES].local_us;
+    int64_t reference_offset = clock_samples[(clock_next_sample + CLOCK_SAMPLES - 1) % CLOCK_SAMPLES].offset_us;
+
+    double sum_x = 0, sum_y = 0, sum_xx = 0, sum_xy = 0;
+    int used = 0;
+    int64_t best_offset = 0;
+    for (int i = 0; i < clock_sample_count; i++){
+        const ClockSample& sample = clock_samples[i];
+        if (sample.delay_us > limit) continue;
+
+        double x = (double)(int64_t)(sample.local_us - reference);
+        double y = (double)(sample.offset_us - reference_offset);
+        sum_x += x;
+        sum_y += y;
+        sum_xx += x * x;
+        sum_xy += x * y;
+        used ++;
+
+        if (sample.delay_us == fastest) best_offset = sample.offset_us;
+    }
+
+    double spread = used * sum_xx - sum_x * sum_x;
+    if (used >= 3 && spread > 0){
+        clock_drift = (used * sum_xy - sum_x * sum_y) / spread;
+        clock_offset_us = reference_offset + (int64_t)((sum_y - clock_drift * sum_x) / used);
+    }
+    else {
+        // not enough to see the drift yet, use the fastest exchange
+        clock_drift = 0;
+        clock_offset_us = best_offset;
+    }
+
+    clock_reference_us = reference;
+    clock_locked = true;
+
+    DBG_PRINTF("clock offset %lld us, drift %d ppb, fastest round trip %u us\n", (long long)clock_offset_us, (int)(clock_drift * 1e9), fastest);
+}
@@ -0,0 +1,39 @@
+#pragma once
+
+#include "BEC_E_Device.h"
+
+// time between sync requests once the clock is locked
+#ifndef CLOCK_SYNC_INTERVAL_MS
+#define CLOCK_SYNC_INTERVAL_MS 60000
+#endif
+
+// time between sync requests until the window of samples is full
+#ifndef CLOCK_FAST_SYNC_INTERVAL_MS
+#define CLOCK_FAST_SYNC_INTERVAL_MS 2000
+#endif
+
+// a request without a reply after this long is given up on
+#ifndef CLOCK_REPLY_TIMEOUT_MS
+#define CLOCK_REPLY_TIMEOUT_MS 5000
+#endif
+
+// samples the offset and drift are fitted over
+#ifndef CLOCK_SAMPLES
+#define CLOCK_SAMPLES 8
+#endif
+
+// samples whose round trip is more than this many times the fastest one are left out of the fit
+#ifndef CLOCK_DELAY_FILTER
+#define CLOCK_DELAY_FILTER 2
+#endif
+
+// one request and reply. Times are in microseconds
+struct ClockSample {
+    uint64_t local_us;  // device time half way through the exchange
+    int64_t offset_us;  // server time - device time
+    uint32_t delay_us;  // round trip less the time the server held the request
+};
+
+// function prototypes for internal functions
+void clock_tick();
+void handle_clock_sync(ArgValue *, uint8_t);
@@ -1,5 +1,4 @@
 #include <ESP8266WiFi.h>
-#include <ESP8266httpUpdate.h>
 
 #include "Commands.h"
 
@@ -7,95 +6,81 @@
 #include "BEC_E_Device.h"
 #include "Network/Network.h"
 #include "EEPROM/BEC_E_EEPROM.h"
+#include "Config/Config.h"
 #include "Areana/Arena.h"
-
-// array of built in commands
-Command built_in_commands[] = {
-    {"Restart",       65534, STRONG_BUTTON, nullptr, 0, handle_restart},
-    {"Update",        65533, STRONG_BUTTON, nullptr, 0, handle_update},
-    {"Send Commands", 65532, HIDDEN,        nullptr, 0, handle_send_commands},
-    {"Send Name",     65531, HIDDEN,        nullptr, 0, handle_send_name},
-    {"Factory Reset", 65530, STRONG_BUTTON, nullptr, 0, handle_factory_reset},
+#include "OTA/OTA.h"
+#include "Trace/Trace.h"
+#include "Clock/Clock.h"
+#include "Reporting/Reporting.h"
+#include "Local/Local.h"
+#include "Shadow/Shadow.h"
+#include "Connection/Connection.h"
+#include "Capture/Capture.h"
+#include "Reply/Reply.h"
+
+// names of the built in commands, kept in flash with the table
+constexpr char restart_name[] PROGMEM       = "Restart";
+constexpr char update_name[] PROGMEM        = "Update";
+constexpr char send_commands_name[] PROGMEM = "Send Commands";
+constexpr char send_name_name[] PROGMEM     = "Send Name";
+constexpr char factory_reset_name[] PROGMEM = "Factory Reset";
+constexpr char send_trace_name[] PROGMEM    = "Send Trace";
+constexpr char clock_sync_name[] PROGMEM    = "Clock Sync";
+constexpr char subscribe_name[] PROGMEM     = "Subscribe";
+constexpr char local_peers_name[] PROGMEM   = "Local Peers";
+constexpr char sync_state_name[] PROGMEM    = "Sync State";
+constexpr char set_servers_name[] PROGMEM   = "Set Servers";
+constexpr char send_capture_name[] PROGMEM  = "Send Capture";
+
+// array of built in commands. In flash, so entries are read with get_command
+constexpr Command built_in_commands[] PROGMEM = {
+    {restart_name,       65534, STRONG_BUTTON, nullptr, 0, handle_restart},
+    {update_name,        65533, STRONG_BUTTON, nullptr, 0, handle_update},
+    {send_commands_name, 65532, HIDDEN,        nullptr, 0, handle_send_commands},
+    {send_name_name,     65531, HIDDEN,        nullptr, 0, handle_send_name},
+    {factory_reset_name, 65530, STRONG_BUTTON, nullptr, 0, handle_factory_reset},
+    {send_trace_name,    65529, HIDDEN,        nullptr, 0, handle_send_trace},
+    {clock_sync_name,    65528, HIDDEN,        nullptr, 0, handle_clock_sync},
+    {subscribe_name,     65527, HIDDEN,        nullptr, 0, handle_subscribe},
+    {local_peers_name,   65526, HIDDEN,        nullptr, 0, handle_local_peers},
+    {sync_state_name,    65525, HIDDEN,        nullptr, 0, handle_sync_state},
+    {set_servers_name,   65524, HIDDEN,        nullptr, 0, handle_set_servers},
+    {send_capture_name,  65523, HIDDEN,        nullptr, 0, handle_send_capture},
 };
 
-// array of registered commands defaulting to a null command
-Command registered_commands [MAX_REGISTERED_COMMAND_NUM];
+static_assert(command_ids_unique(built_in_commands), "built in command ids must be unique");
 
-void handle_restart(ArgValue _args[], uint8_t _arg_number){
-    ESP.restart();
-}
+const uint8_t built_in_command_count = sizeof(built_in_commands) / sizeof(built_in_commands[0]);
 
-// TODO spit into multiple functions
-void handle_update(ArgValue _args[], uint8 _arg_number){
-    WiFiClient client;
-    HTTPClient http;
+// flash tables from register_commands
+CommandTable command_tables[MAX_COMMAND_TABLES];
+uint8_t command_table_count;
 
-    BEC_E::send_log("Checking for updates");
+// commands from register_command, copied into RAM
+#if MAX_REGISTERED_COMMAND_NUM > 0
+Command registered_commands[MAX_REGISTERED_COMMAND_NUM];
+#endif
+uint8_t registered_command_count;
 
-    // set up path for ota version file
-    uint16_t ota_version_path_len = SERVER_IP_SIZE + strlen("/IOT/firmware/") + strlen(DEVICE_NAME) + strlen("/version.txt");
-    char* ota_version_path = new char[ota_version_path_len];
-    snprintf(ota_version_path, ota_version_path_len, "%s/IOT/firmware/%s_version.txt", server_ip, DEVICE_NAME);
-    
-    // set up path for ota firmware file
-    uint16_t ota_firmware_path_len = SERVER_IP_SIZE + strlen("/IOT/firmware/") + strlen(DEVICE_NAME) + strlen("/firmware.txt");
-    char* ota_firmware_path = new char[ota_firmware_path_len];
-    snprintf(ota_firmware_path, ota_version_path_len, "%s/IOT/firmware/%s/firmware.txt", server_ip, DEVICE_NAME);
-    
-    // check for update
-    if (http.begin(client, ota_version_path)){
-        int httpCode = http.GET();
-
-        // make sure it was successful
-        if (httpCode == 200) {
-            // get the version from the file
-            String new_version = http.getString();
-            new_version.trim();
-
-            // match it to the saved version
-            if (new_version != CURRENT_VERSION){
-                BEC_E::send_log("New version available! Starting OTA");
-
-                // start the update
-                t_httpUpdate_return result = ESPhttpUpdate.update(client, ota_firmware_path);
-
-                // handle the result of the update
-                switch (result){
-                    case HTTP_UPDATE_FAILED:
-                        BEC_E::send_log("Update failed");
-                        BEC_E::send_log(ESPhttpUpdate.getLastErrorString().c_str());
-                    break;
-                    case HTTP_UPDATE_NO_UPDATES:
-                        BEC_E::send_log("No updates available");
-                    break;
-                    case HTTP_UPDATE_OK:
-                        BEC_E::send_log("Update successful. Rebooting");
-                    break;
-                }
-            } 
-            else {
-                BEC_E::send_log("Firmware is up-to-date");
-            }
-        }
-        else {
-            BEC_E::send_log("Failed to check update version");
-        }
+// types of the arguments given to the command being handled, only valid while its handler runs
+const Argument::arg_type* argument_types;
+uint8_t argument_type_count;
 
-        // clean up
-        http.end();
-    }
+void handle_restart(ArgValue _args[], uint8_t _arg_number){
+    ESP.restart();
+}
 
+void handle_update(ArgValue _args[], uint8 _arg_number){
+    // runs from the main loop so commands keep being handled during the download
+    ota_start();
 }
 
 void handle_send_commands(ArgValue _args[], uint8 _arg_number) {
-    for (int i = 0; i < MAX_REGISTERED_COMMAND_NUM; i++) {
-        if (registered_commands[i].id == 65535) break;
-        send_single_command(registered_commands[i]);
-    }
-
-    size_t built_in_count = sizeof(built_in_commands) / sizeof(built_in_commands[0]);
-    for (size_t i = 0; i < built_in_count; i++) {
-        send_single_command(built_in_commands[i]);
+    uint16_t count = command_count();
+    for (uint16_t i = 0; i < count; i++) {
+        Command command;
+        get_command(i, command);
+        send_single_command(command);
     }
 }
 
@@ -110,115 +95,134 @@ void handle_send_name(ArgValue _args[], uint8 _arg_number){
 }
 
 void handle_factory_reset(ArgValue _args[], uint8 _arg_number){
+    config_clear();
     clear_EEPROM();
 
     ESP.restart();
 }
 
-bool handle_command(PacketHeader header, uint8_t* buffer){
-    // get the number of commands
-    size_t built_in_commands_len = sizeof(built_in_commands)/sizeof(built_in_commands[0]);
+void handle_send_trace(ArgValue _args[], uint8 _arg_number){
+    trace_dump();
+}
 
+bool handle_command(PacketHeader header, uint8_t* buffer){
     // find what command it is trying to run
-    for (size_t i = 0; i < built_in_commands_len; i++){
-        if (check_command(built_in_commands[i], header, buffer)) return true;
+    uint16_t count = command_count();
+    for (uint16_t i = 0; i < count; i++){
+        Command command;
+        get_command(i, command);
+        if (check_command(command, header, buffer)) return true;
+    }
+
+    return false;
+}
+
+uint16_t command_count(){
+    uint16_t count = built_in_command_count + registered_command_count;
+    for (uint8_t i = 0; i < command_table_count; i++){
+        count += command_tables[i].count;
+    }
+
+    return count;
+}
+
+void get_command(uint16_t index, Command& command){
+    // user tables first, then registered commands, then the built in ones
+    for (uint8_t i = 0; i < command_table_count; i++){
+        if (index < command_tables[i].count){
+            memcpy_P(&command, &command_tables[i].commands[index], sizeof(Command));
+            return;
+        }
+
+        index -= command_tables[i].count;
     }
 
-    for (int i = 0; i < MAX_REGISTERED_COMMAND_NUM; i++){
-        if (check_command(registered_commands[i], header, buffer)) return true;
+#if MAX_REGISTERED_COMMAND_NUM > 0
+    if (index < registered_command_count){
+        command = registered_commands[index];
+        return;
+    }
+#endif
+
+    index -= registered_command_count;
+    memcpy_P(&command, &built_in_commands[index], sizeof(Command));
+}
+
+bool is_user_command(uint16_t id){
+    // everything before the built in commands came from the user
+    uint16_t count = command_count() - built_in_command_count;
+    for (uint16_t i = 0; i < count; i++){
+        Command command;
+        get_command(i, command);
+        if (command.id == id) return command.type != HIDDEN;
     }
 
     return false;
 }
 
+bool arguments_match(const Argument::arg_type* pattern, uint8_t pattern_length){
+    // the pattern repeats to cover every argument, so a partial repeat doesn't match
+    if (pattern_length == 0 || argument_type_count % pattern_length != 0) return false;
+
+    for (uint8_t i = 0; i < argument_type_count; i++){
+        if (argument_types[i] != pattern[i % pattern_length]) return false;
+    }
+
+    return true;
+}
+
 bool check_command(const Command& command, const PacketHeader& header, uint8_t* buffer){
-    if (command.type != header.type){
+    if (command.id != header.type){
         return false;
     }
 
     // get the position of the payload
     uint8_t* payload = buffer + sizeof(PacketHeader);
 
-    // create array for arguments
+    // create arrays for arguments and their types
     ArgValue* args = (ArgValue*)arena_malloc(header.argument_number * sizeof(ArgValue));
+    Argument::arg_type* types = (Argument::arg_type*)arena_malloc(header.argument_number);
     
     // make sure that memory allocation worked
-    if (args == nullptr) {
-        BEC_E::send_log("Arena out of memory for string pointers");
-        return false;
+    // the command exists, so it's answered as failed rather than unknown
+    if (args == nullptr || types == nullptr) {
+        BEC_E::send_log("Arena out of memory for arguments");
+        BEC_E::reply(REPLY_ERROR);
+        return true;
     }
 
-    // add all the arguments
+    // add all the arguments, each starts with its type. The payload ends with the crc, and nothing the sender
+    // claims about the arguments is trusted past that
+    uint16_t remaining = header.payload_len >= sizeof(uint16_t) ? header.payload_len - sizeof(uint16_t) : 0;
     for (int j = 0; j < header.argument_number; j++) {
-        payload += parse_argument(args[j], payload);
+        types[j] = (Argument::arg_type)*payload;
+
+        uint16_t used = parse_argument(args[j], payload, remaining);
+        if (used == 0) {
+            BEC_E::reply(REPLY_ERROR);
+            return true;
+        }
+
+        payload += used;
+        remaining -= used;
     }
 
+    // read before the handler runs, the receive buffer can be reused while it does
+    uint8_t first_type = *(buffer + sizeof(PacketHeader));
+
     // run the function
+    argument_types = types;
+    argument_type_count = header.argument_number;
+    TRACE_BEGIN(TRACE_LEVEL_INFO, TRACE_COMMAND, command.id, header.argument_number);
     command.receive_command_function(args, header.argument_number);
+    TRACE_END(TRACE_LEVEL_INFO, TRACE_COMMAND, command.id, header.argument_number);
+    argument_types = nullptr;
+    argument_type_count = 0;
 
-    return true;
-}
-
-uint16_t parse_argument(ArgValue& arg, uint8_t* payload){
-    switch (*payload){
-        case Argument::BOOL:
-            arg.bool_val = *(bool*)(payload + 1);
-            return 1 + sizeof(bool);
-        case Argument::INT8:
-            arg.int8_val = *(int8_t*)(payload + 1);
-            return 1 + sizeof(int8_t);
-        case Argument::INT16:
-            arg.int16_val = *(int16_t*)(payload + 1);
-            return 1 + sizeof(int16_t);
-        case Argument::INT32:
-            arg.int32_val = *(int32_t*)(payload + 1);
-            return 1 + sizeof(int32_t);
-        case Argument::UINT8:
-            arg.uint8_val = *(uint8_t*)(payload + 1);
-            return 1 + sizeof(uint8_t);
-        case Argument::UINT16:
-            arg.uint16_val = *(uint16_t*)(payload + 1);
-            return 1 + sizeof(uint16_t);
-        case Argument::UINT32:
-            arg.uint32_val = *(uint32_t*)(payload + 1);
-            return 1 + sizeof(uint32_t);
-        case Argument::FLOAT:
-            arg.float_val = *(float*)(payload + 1);
-            return 1 + sizeof(float);
-        case Argument::COLOR:
-            arg.color_val = *(Color*)(payload + 1);
-            return 1 + sizeof(Color);
-        case Argument::STRING: {
-            uint16_t str_len = *(uint16_t*)(payload + 1);
-            
-            // Allocate from arena with room for null terminator
-            char* str = (char*)arena_malloc(str_len + 1);
-            if (!str) {
-                BEC_E::send_log("Arena out of memory for string");
-                arg.str_val = nullptr;
-                return 1 + 2 + str_len; // still advance payload pointer to avoid stuck parsing
-            }
-            
-            // copy the string over
-            memcpy(str, payload + 3, str_len);
-            str[str_len] = '\0';
-            
-            // add the string to the argument
-            arg.str_val = str;
-            
-            return 1 + 2 + str_len;
-        }
-        default:
-            BEC_E::send_log("argument type not defined");
-            return 1;
+    // remember the new value so the server can be synced after a reconnect
+    if (shadow_tracks(command.type) && header.argument_number > 0 && !reply_failed()){
+        shadow_update(command.id, first_type, args[0], reply_from_server());
     }
-}
 
-void init_registered_commands(){
-    DBG_PRINTLN("\ninitializing registered commands");
-    Command default_command = {nullptr, 65535, HIDDEN, nullptr, 0, nullptr};
-    
-    for (int i = 0; i < MAX_REGISTERED_COMMAND_NUM; i++){
-        registered_commands[i] = default_command;
-    }
-}
\ No newline at end of file
+    return true;
+}
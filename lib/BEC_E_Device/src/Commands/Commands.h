@@ -1,14 +1,32 @@
 #pragma once
 
 #include "BEC_E_Device.h"
+#include "Packet/Wire.h"
 
+// commands copied into RAM by register_command. Only needed for commands that can't be known at compile time,
+// tables passed to register_commands stay in flash. 0 turns it off
 #ifndef MAX_REGISTERED_COMMAND_NUM
-#define MAX_REGISTERED_COMMAND_NUM 10
+#define MAX_REGISTERED_COMMAND_NUM 4
 #endif
 
+// flash command tables that can be registered
+#ifndef MAX_COMMAND_TABLES
+#define MAX_COMMAND_TABLES 2
+#endif
+
+// a command table in flash, passed to register_commands
+struct CommandTable {
+    const Command* commands;
+    uint8_t count;
+};
+
 // make globals available to everyone
-extern Command built_in_commands[];
-extern Command registered_commands [];
+extern CommandTable command_tables[];
+extern uint8_t command_table_count;
+#if MAX_REGISTERED_COMMAND_NUM > 0
+extern Command registered_commands[];
+#endif
+extern uint8_t registered_command_count;
 
 // function prototypes for build in commands
 void handle_restart(ArgValue *, uint8_t);
@@ -16,9 +34,12 @@ void handle_update(ArgValue *, uint8_t);
 void handle_send_commands(ArgValue *, uint8_t);
 void handle_send_name(ArgValue *, uint8_t);
 void handle_factory_reset(ArgValue *, uint8_t);
+void handle_send_trace(ArgValue *, uint8_t);
 
 // function prototypes for internal functions
 bool handle_command(PacketHeader header, uint8_t* buffer);
 bool check_command(const Command& command, const PacketHeader& header, uint8_t* buffer);
-void init_registered_commands();
-uint16_t parse_argument(ArgValue& arg, uint8_t* payload);
\ No newline at end of file
+uint16_t command_count();
+void get_command(uint16_t index, Command& command);
+bool is_user_command(uint16_t id);
+bool arguments_match(const Argument::arg_type* pattern, uint8_t pattern_length); // for handlers, whether the command's argument types are the pattern repeated
\ No newline at end of file
@@ -0,0 +1,313 @@
+#include "Config.h"
+
+#include <Arduino.h>
+
+#include "debug.h"
+#include "Network/Network.h"
+#include "EEPROM/BEC_E_EEPROM.h"
+
+static_assert(sizeof(ConfigRecord) + CONFIG_MAX_VALUE <= CONFIG_READ_BLOCK, "a record has to fit in a read block");
+static_assert(CONFIG_SECTOR_COUNT >= 2, "compacting erases the next sector, so the config needs at least 2 sectors");
+static_assert(CONFIG_KEY_COUNT <= 32, "the dirty mask only has room for 32 keys");
+
+// the sector being appended to. -1 if there is no config yet
+int8_t active_sector = -1;
+uint32_t active_sequence;
+uint16_t config_tail;
+
+// offset of the latest record for each key in the active sector, 0 if there isn't one
+uint16_t config_offsets[CONFIG_KEY_COUNT];
+
+// changed values waiting for config_commit, laid out exactly as they will be written
+uint8_t config_stage[CONFIG_STAGE_SIZE];
+uint16_t config_stage_used;
+uint32_t config_dirty;
+
+uint32_t config_address(uint8_t sector);
+uint16_t config_record_size(uint8_t length);
+void scan_config_sector();
+int16_t find_staged(config_key key);
+bool stage_record(config_key key, const void* data, uint8_t length);
+bool compact_config();
+void migrate_config(uint8_t from);
+
+void config_begin(){
+    uint8_t schema = 0;
+
+    // find the active sector
+    for (uint8_t i = 0; i < CONFIG_SECTOR_COUNT; i++){
+        ConfigSector header;
+        if (!flash.read(config_address(i), (uint8_t*)&header, sizeof(header))) continue;
+        if (header.magic != CONFIG_SECTOR_MAGIC) continue;
+
+        if (active_sector < 0 || header.sequence > active_sequence){
+            active_sector = i;
+            active_sequence = header.sequence;
+            schema = header.schema;
+        }
+    }
+
+    if (active_sector >= 0){
+        scan_config_sector();
+    }
+    else {
+        DBG_PRINTLN("no config found");
+    }
+
+    // bring values written by older versions up to date instead of throwing them away
+    if (schema < CONFIG_SCHEMA_VERSION){
+        migrate_config(schema);
+        compact_config();
+    }
+}
+
+int16_t config_get(config_key key, void* data, uint8_t max_length){
+    if (key >= CONFIG_KEY_COUNT) return -1;
+
+    // values waiting to be committed are newer than the flash
+    int16_t staged = find_staged(key);
+    if (staged >= 0){
+        ConfigRecord record;
+        memcpy(&record, config_stage + staged, sizeof(record));
+        if (record.length == 0) return -1;
+
+        memcpy(data, config_stage + staged + sizeof(record), min(record.length, max_length));
+        return record.length;
+    }
+
+    if (active_sector < 0 || config_offsets[key] == 0) return -1;
+
+    ConfigRecord record;
+    uint32_t address = config_address(active_sector) + config_offsets[key];
+    if (!flash.read(address, (uint8_t*)&record, sizeof(record))) return -1;
+
+    uint8_t copy = min(record.length, max_length);
+    if (copy > 0 && !flash.read(address + sizeof(record), (uint8_t*)data, copy)) return -1;
+
+    return record.length;
+}
+
+bool config_get_string(config_key key, char* data, uint8_t size){
+    int16_t length = config_get(key, data, size - 1);
+
+    if (length < 0){
+        data[0] = '\0';
+        return false;
+    }
+
+    data[min<int16_t>(length, size - 1)] = '\0';
+    return true;
+}
+
+bool config_set(config_key key, const void* data, uint8_t length){
+    if (key >= CONFIG_KEY_COUNT || length > CONFIG_MAX_VALUE) return false;
+
+    // don't write anything if the value didn't change
+    uint8_t current[CONFIG_MAX_VALUE];
+    if (config_get(key, current, sizeof(current)) == length && memcmp(current, data, length) == 0){
+        return true;
+    }
+
+    return stage_record(key, data, length);
+}
+
+bool config_erase(config_key key){
+    uint8_t current;
+    if (config_get(key, &current, 0) < 0) return true;
+
+    return stage_record(key, nullptr, 0);
+}
+
+bool config_commit(){
+    if (config_dirty == 0) return true;
+
+    // append the changes if they fit, otherwise move everything to the next sector
+    if (active_sector < 0 || config_tail + config_stage_used > FLASH_SECTOR_SIZE){
+        return compact_config();
+    }
+
+    if (!flash.write(config_address(active_sector) + config_tail, config_stage, config_stage_used)) return false;
+
+    // point the keys at their new records
+    uint16_t offset = 0;
+    while (offset < config_stage_used){
+        ConfigRecord record;
+        memcpy(&record, config_stage + offset, sizeof(record));
+
+        config_offsets[record.key] = record.length == 0 ? 0 : config_tail + offset;
+        offset += config_record_size(record.length);
+    }
+
+    config_tail += config_stage_used;
+    config_stage_used = 0;
+    config_dirty = 0;
+
+    return true;
+}
+
+void config_clear(){
+    for (uint8_t i = 0; i < CONFIG_SECTOR_COUNT; i++){
+        flash.erase_sector(config_address(i));
+    }
+
+    active_sector = -1;
+    active_sequence = 0;
+    config_tail = 0;
+    config_stage_used = 0;
+    config_dirty = 0;
+    memset(config_offsets, 0, sizeof(config_offsets));
+}
+
+void save_credentials(const char* ssid, const char* password, const char* server_address) {
+    DBG_PRINTF("Saving the SSID (%s)\n", ssid);
+    config_set(CONFIG_SSID, ssid, strnlen(ssid, SSID_SIZE - 1));
+
+    DBG_PRINTF("Saving the password (%s)\n", password);
+    config_set(CONFIG_PASSWORD, password, strnlen(password, WIFI_PASSWORD_SIZE - 1));
+
+    DBG_PRINTF("Saving the server IP (%s)\n", server_address);
+    config_set(CONFIG_SERVER_IP, server_address, strnlen(server_address, SERVER_IP_SIZE - 1));
+
+    // the cached access point belongs to the old network
+    config_erase(CONFIG_WIFI_CACHE);
+
+    // look for the server again rather than trusting one found with the old settings
+    config_erase(CONFIG_DISCOVERED_SERVER);
+
+    // the address typed in replaces any list the old server gave out
+    config_erase(CONFIG_SERVERS);
+
+    config_commit();
+}
+
+uint32_t config_address(uint8_t sector){
+    return flash.size - (uint32_t)(CONFIG_SECTOR_COUNT - sector) * FLASH_SECTOR_SIZE;
+}
+
+uint16_t config_record_size(uint8_t length){
+    return sizeof(ConfigRecord) + ((length + 3) & ~3);
+}
+
+void scan_config_sector(){
+    uint32_t address = config_address(active_sector);
+
+    // the sector is read a block at a time rather than a record at a time
+    uint8_t block[CONFIG_READ_BLOCK];
+    uint16_t block_start = 0;
+    uint16_t block_end = 0;
+
+    memset(config_offsets, 0, sizeof(config_offsets));
+    uint16_t offset = sizeof(ConfigSector);
+
+    while (offset + sizeof(ConfigRecord) <= FLASH_SECTOR_SIZE){
+        // read the next block if the record could run off the end of this one
+        if (offset + sizeof(ConfigRecord) + CONFIG_MAX_VALUE > block_end && block_end < FLASH_SECTOR_SIZE){
+            block_start = offset;
+            block_end = min<uint16_t>(offset + CONFIG_READ_BLOCK, FLASH_SECTOR_SIZE);
+
+            if (!flash.read(address + block_start, block, block_end - block_start)) break;
+        }
+
+        ConfigRecord record;
+        memcpy(&record, block + offset - block_start, sizeof(record));
+
+        // erased space is the end of the config
+        if (record.key == 0xFF) break;
+
+        // anything that doesn't make sense is a write that got cut off. Don't append after it
+        uint16_t size = config_record_size(record.length);
+        if (record.key >= CONFIG_KEY_COUNT || record.length > CONFIG_MAX_VALUE || offset + size > FLASH_SECTOR_SIZE){
+            DBG_PRINTLN("config sector damaged");
+            offset = FLASH_SECTOR_SIZE;
+            break;
+        }
+
+        if (calculate_crc16(block + offset - block_start + sizeof(record), record.length) == record.crc){
+            config_offsets[record.key] = record.length == 0 ? 0 : offset;
+        }
+
+        offset += size;
+    }
+
+    config_tail = offset;
+}
+
+int16_t find_staged(config_key key){
+    int16_t found = -1;
+    uint16_t offset = 0;
+
+    // the last record for the key wins
+    while (offset < config_stage_used){
+        if (config_stage[offset] == key) found = offset;
+
+        offset += config_record_size(config_stage[offset + 1]);
+    }
+
+    return found;
+}
+
+bool stage_record(config_key key, const void* data, uint8_t length){
+    uint16_t size = config_record_size(length);
+
+    // make room by writing out what is already staged
+    if (config_stage_used + size > CONFIG_STAGE_SIZE && !config_commit()) return false;
+
+    ConfigRecord record = {key, length, calculate_crc16((const uint8_t*)data, length)};
+
+    memset(config_stage + config_stage_used, 0xFF, size);
+    memcpy(config_stage + config_stage_used, &record, sizeof(record));
+    if (length > 0) memcpy(config_stage + config_stage_used + sizeof(record), data, length);
+
+    config_stage_used += size;
+    config_dirty |= 1UL << key;
+
+    return true;
+}
+
+bool compact_config(){
+    uint8_t next = active_sector < 0 ? 0 : (active_sector + 1) % CONFIG_SECTOR_COUNT;
+    uint32_t address = config_address(next);
+
+    DBG_PRINTF("moving config to sector %d\n", next);
+    if (!flash.erase_sector(address)) return false;
+
+    // copy over the latest value of every key
+    uint16_t offsets[CONFIG_KEY_COUNT] = {0};
+    uint16_t offset = sizeof(ConfigSector);
+    uint8_t buffer[sizeof(ConfigRecord) + CONFIG_MAX_VALUE];
+
+    for (uint8_t key = 0; key < CONFIG_KEY_COUNT; key++){
+        int16_t length = config_get((config_key)key, buffer + sizeof(ConfigRecord), CONFIG_MAX_VALUE);
+        if (length <= 0) continue;
+
+        ConfigRecord record = {key, (uint8_t)length, calculate_crc16(buffer + sizeof(ConfigRecord), length)};
+        memcpy(buffer, &record, sizeof(record));
+
+        if (!flash.write(address + offset, buffer, sizeof(record) + length)) return false;
+
+        offsets[key] = offset;
+        offset += config_record_size(length);
+    }
+
+    // the header goes last so the old sector stays active if we lose power before this
+    ConfigSector header = {CONFIG_SECTOR_MAGIC, active_sequence + 1, CONFIG_SCHEMA_VERSION, {0xFF, 0xFF, 0xFF}};
+    if (!flash.write(address, (const uint8_t*)&header, sizeof(header))) return false;
+
+    active_sector = next;
+    active_sequence ++;
+    config_tail = offset;
+    memcpy(config_offsets, offsets, sizeof(config_offsets));
+    config_stage_used = 0;
+    config_dirty = 0;
+
+    return true;
+}
+
+void migrate_config(uint8_t from){
+    DBG_PRINTF("migrating config from schema %d\n", from);
+
+    // schema 0 is the old fixed EEPROM layout
+    if (from < 1){
+        import_legacy_EEPROM();
+    }
+}
@@ -0,0 +1,64 @@
+#pragma once
+
+#include <stdint.h>
+
+#include "Flash/Flash.h"
+
+// sectors at the end of the flash partition used for the config. Writes rotate through them
+#ifndef CONFIG_SECTOR_COUNT
+#define CONFIG_SECTOR_COUNT 4
+#endif
+
+// bytes of changed values that can be waiting for config_commit
+#ifndef CONFIG_STAGE_SIZE
+#define CONFIG_STAGE_SIZE 256
+#endif
+
+// size of the blocks the config is read in at boot
+#ifndef CONFIG_READ_BLOCK
+#define CONFIG_READ_BLOCK 256
+#endif
+
+#define CONFIG_MAX_VALUE 64
+#define CONFIG_SECTOR_MAGIC 0xBECEC0F1
+
+// bump this and add a step to migrate_config when the meaning of a key changes
+#define CONFIG_SCHEMA_VERSION 1
+
+// the values kept in the config
+enum config_key : uint8_t {
+    CONFIG_SSID         = 0,
+    CONFIG_PASSWORD     = 1,
+    CONFIG_SERVER_IP    = 2,
+    CONFIG_WIFI_CACHE   = 3,
+    CONFIG_SUBSCRIPTIONS = 4,
+    CONFIG_LOCAL_PEERS  = 5,
+    CONFIG_DISCOVERED_SERVER = 6,
+    CONFIG_SERVERS      = 7,
+    CONFIG_KEY_COUNT,
+};
+
+// written at the start of every config sector. Written last so a half copied sector is never used
+struct ConfigSector {
+    uint32_t magic;     // CONFIG_SECTOR_MAGIC
+    uint32_t sequence;  // the sector with the highest sequence is the active one
+    uint8_t schema;     // CONFIG_SCHEMA_VERSION the values were written with
+    uint8_t reserved[3];
+};
+
+// written in front of every value. Records are 4 byte aligned and the last one for a key wins
+struct ConfigRecord {
+    uint8_t key;        // the config_key. 0xFF marks the end of the sector
+    uint8_t length;     // length of the value. 0 means the key was erased
+    uint16_t crc;       // crc of the value
+};
+
+// function prototypes for internal functions
+void config_begin();
+int16_t config_get(config_key key, void* data, uint8_t max_length);
+bool config_get_string(config_key key, char* data, uint8_t size);
+bool config_set(config_key key, const void* data, uint8_t length);
+bool config_erase(config_key key);
+bool config_commit();
+void config_clear();
+void save_credentials(const char*, const char*, const char*);
@@ -0,0 +1,389 @@
+#include <ESP8266WiFi.h>
+
+#include "Connection.h"
+
+#include "debug.h"
+#include "Network/Network.h"
+#include "FastConnect/FastConnect.h"
+#include "Offline/Offline.h"
+#include "Portal/Portal.h"
+#include "Discovery/Discovery.h"
+#include "Config/Config.h"
+#include "ConnectionRace.h"
+#include "Probe.h"
+#include "Tasks/Tasks.h"
+#include "Capture/Capture.h"
+#include "Trace/Trace.h"
+#include "Commands/Commands.h"
+
+static_assert(MAX_SERVERS * sizeof(ServerEndpoint) <= CONFIG_MAX_VALUE, "MAX_SERVERS don't fit in a config value");
+
+connection_state tcp_state = CONNECTION_BACKOFF;
+
+// frames waiting for the connection, stored as [length][frame] in a ring
+uint8_t tx_queue[TX_QUEUE_SIZE];
+uint16_t tx_queue_head;
+uint16_t tx_queue_used;
+
+// backoff state
+unsigned long next_attempt_ms;
+unsigned long backoff_ms = CONNECTION_BACKOFF_MIN_MS;
+uint8_t failed_attempts;
+bool ever_connected;
+
+// the address from the portal. server_ip follows whichever server we connect to
+char saved_server_ip[SERVER_IP_SIZE];
+
+// the list from the server, saved in the config
+ServerEndpoint configured_servers[MAX_SERVERS];
+uint8_t configured_server_count;
+
+// the servers being raced, primary first. The index of the one we are connected to, -1 if none
+ServerEndpoint servers[RACE_MAX_SERVERS];
+uint8_t server_count;
+int8_t connected_server = -1;
+
+// index of a discovered server that hasn't been connected to before, -1 if there isn't one
+int8_t fresh_discovered = -1;
+
+ConnectionRace race;
+
+// checks for the primary coming back
+unsigned long next_primary_check_ms;
+unsigned long primary_check_ms;
+bool primary_checking;
+
+uint8_t load_servers();
+void race_tick();
+void primary_tick();
+void connect_failed();
+bool connect_to(uint8_t index);
+void on_connected();
+void on_disconnected();
+bool tx_queue_push(const uint8_t* frame, uint16_t length);
+bool tx_queue_flush();
+
+void connection_begin(){
+    // make sure devices that boot together don't pick the same delays
+    randomSeed(ESP.random());
+
+    tcp_state = CONNECTION_BACKOFF;
+    next_attempt_ms = millis();
+
+    strncpy(saved_server_ip, server_ip, SERVER_IP_SIZE - 1);
+
+    int16_t length = config_get(CONFIG_SERVERS, configured_servers, sizeof(configured_servers));
+    configured_server_count = length > 0 ? min<int16_t>(length, sizeof(configured_servers)) / sizeof(ServerEndpoint) : 0;
+
+    discovery_begin();
+}
+
+void connection_tick(){
+    switch (tcp_state){
+        case CONNECTION_CONNECTED:
+            if (!tcp_client.connected()){
+                on_disconnected();
+            }
+            else {
+                if (USE_OFFLINE_STORE) offline_replay_tick();
+                primary_tick();
+            }
+        break;
+        case CONNECTION_BACKOFF:
+            if ((long)(millis() - next_attempt_ms) < 0) return;
+
+            // nothing to do until wifi is back
+            if (WiFi.status() != WL_CONNECTED) return;
+
+            DBG_PRINTF("\nconnecting to TCP (attempt %d)\n", failed_attempts + 1);
+            if (load_servers() == 0){
+                connect_failed();
+                return;
+            }
+
+            // every server gets tried, a dead one only holds the others back by the stagger
+            race_begin(race, server_count, millis());
+            tcp_state = CONNECTION_RACING;
+            race_tick();
+        break;
+        case CONNECTION_RACING:
+            race_tick();
+        break;
+    }
+}
+
+bool connection_send(const uint8_t* frame, uint16_t length, send_policy policy){
+    bool persist = USE_OFFLINE_STORE && policy == SEND_PERSIST;
+    capture_record(CAPTURE_TX, frame, length);
+
+    // persisted packets have to wait behind the ones still in flash to keep their order
+    if (tcp_state == CONNECTION_CONNECTED && !(persist && offline_pending())){
+        // keep the order by sending anything still waiting first
+        if (tx_queue_flush() && tcp_client.write(frame, length) == length){
+            TRACE(TRACE_LEVEL_VERBOSE, TRACE_PACKET_SENT, length, 0);
+            return true;
+        }
+
+        on_disconnected();
+    }
+
+    if (policy == SEND_DROP) return false;
+
+    TRACE(TRACE_LEVEL_VERBOSE, TRACE_PACKET_QUEUED, length, policy);
+    if (persist) return offline_append(frame, length);
+
+    return tx_queue_push(frame, length);
+}
+
+uint8_t load_servers(){
+    // the list the server gave out, or the address typed into the portal
+    server_count = 0;
+    for (uint8_t i = 0; i < configured_server_count; i++){
+        servers[server_count++] = configured_servers[i];
+    }
+
+    IPAddress address;
+    if (server_count == 0 && saved_server_ip[0] != '\0' && WiFi.hostByName(saved_server_ip, address)){
+        servers[server_count++] = {(uint32_t)address, SERVER_PORT_TCP, SERVER_PORT_UDP};
+    }
+
+    // whatever answered discovery goes last, the list says where the server should be
+    fresh_discovered = -1;
+    DiscoveredServer found;
+    bool saved;
+    if (!discovered_server(found, saved)) return server_count;
+
+    for (uint8_t i = 0; i < server_count; i++){
+        if (servers[i].address == found.address && servers[i].tcp_port == found.tcp_port) return server_count;
+    }
+
+    if (!saved) fresh_discovered = server_count;
+    servers[server_count++] = {found.address, found.tcp_port, found.udp_port};
+    return server_count;
+}
+
+void race_tick(){
+    unsigned long now = millis();
+
+    // start whichever attempts are due
+    int8_t index;
+    while ((index = race_next_start(race, now)) >= 0){
+        DBG_PRINTF("trying %s:%u\n", IPAddress(servers[index].address).toString().c_str(), servers[index].tcp_port);
+        if (!probe_start(index, servers[index].address, servers[index].tcp_port)) race_result(race, index, false);
+    }
+
+    for (uint8_t i = 0; i < race.started; i++){
+        if (race.attempts[i] != ATTEMPT_PENDING) continue;
+
+        probe_state state = probe_poll(i);
+        if (state == PROBE_CONNECTED || state == PROBE_FAILED) race_result(race, i, state == PROBE_CONNECTED);
+    }
+
+    while ((index = race_expired(race, now)) >= 0){
+        probe_stop(index);
+    }
+
+    race_state state = race_status(race);
+    if (state == RACE_RUNNING) return;
+
+    probe_stop_all();
+    TRACE(TRACE_LEVEL_INFO, TRACE_CONNECT_RACE, race.winner < 0 ? 0xFF : race.winner, now - race.begin_ms);
+
+    // the winner just answered, so this doesn't wait long
+    if (state == RACE_WON && connect_to(race.winner)){
+        on_connected();
+        return;
+    }
+
+    connect_failed();
+}
+
+void primary_tick(){
+    // already on the primary
+    if (connected_server <= 0) return;
+
+    unsigned long now = millis();
+    if (!primary_checking){
+        if ((long)(now - next_primary_check_ms) < 0) return;
+
+        primary_checking = probe_start(0, servers[0].address, servers[0].tcp_port);
+        primary_check_ms = now;
+        if (!primary_checking) next_primary_check_ms = now + PRIMARY_CHECK_MS;
+        return;
+    }
+
+    probe_state state = probe_poll(0);
+    if (state == PROBE_PENDING && now - primary_check_ms < CONNECTION_ATTEMPT_TIMEOUT_MS) return;
+
+    probe_stop(0);
+    primary_checking = false;
+    next_primary_check_ms = now + PRIMARY_CHECK_MS;
+    if (state != PROBE_CONNECTED) return;
+
+    // the primary is back. Anything queued goes to it
+    DBG_PRINTLN("moving back to the primary server");
+    tcp_client.stop();
+
+    if (connect_to(0)) on_connected();
+    else on_disconnected();
+}
+
+void connect_failed(){
+    failed_attempts ++;
+    tcp_state = CONNECTION_BACKOFF;
+
+    // if we have never reached the server and nothing answered discovery the ip is probably wrong, so run the ap again.
+    // Not once the server has handed out a list, those servers are just down
+    if (!ever_connected && failed_attempts >= TCP_CONNECTION_ATTEMPTS && !discovery_found() && configured_server_count == 0){
+        portal_start();
+    }
+
+    // wait somewhere between half and all of the backoff so devices spread out
+    TRACE(TRACE_LEVEL_INFO, TRACE_CONNECT_FAILED, failed_attempts, backoff_ms);
+    next_attempt_ms = millis() + backoff_ms / 2 + random(backoff_ms / 2 + 1);
+    backoff_ms = min<unsigned long>(backoff_ms * 2, CONNECTION_BACKOFF_MAX_MS);
+}
+
+bool connect_to(uint8_t index){
+    const ServerEndpoint& server = servers[index];
+    IPAddress address(server.address);
+
+    // bound how long the attempt can block the loop
+    tcp_client.setTimeout(CONNECTION_TIMEOUT_MS);
+    bool connected = tcp_client.connect(address, server.tcp_port);
+    tcp_client.setTimeout(CONNECTION_READ_TIMEOUT_MS);
+
+    if (!connected) return false;
+
+    // everything else talking to the server uses these
+    strncpy(server_ip, address.toString().c_str(), SERVER_IP_SIZE - 1);
+    server_port_tcp = server.tcp_port;
+    server_port_udp = server.udp_port;
+
+    connected_server = index;
+    next_primary_check_ms = millis() + PRIMARY_CHECK_MS;
+
+    // a connection worked, so the next boot can go straight to it
+    if (index == fresh_discovered) discovery_confirm();
+
+    return true;
+}
+
+void handle_set_servers(ArgValue args[], uint8_t arg_number){
+    // [UINT32 address][UINT16 tcp port][UINT16 udp port] for each server, primary first. None goes back to the portal address.
+    // Used from the next connection. A bad list is refused before anything is changed
+    const Argument::arg_type server_types[] = {Argument::UINT32, Argument::UINT16, Argument::UINT16};
+    if (arg_number / 3 > MAX_SERVERS || !arguments_match(server_types, 3)){
+        BEC_E::reply(REPLY_ERROR);
+        return;
+    }
+
+    configured_server_count = arg_number / 3;
+    for (uint8_t i = 0; i < configured_server_count; i++){
+        configured_servers[i] = {args[i * 3].uint32_val, args[i * 3 + 1].uint16_val, args[i * 3 + 2].uint16_val};
+    }
+
+    if (configured_server_count == 0) config_erase(CONFIG_SERVERS);
+    else config_set(CONFIG_SERVERS, configured_servers, configured_server_count * sizeof(ServerEndpoint));
+
+    config_commit();
+}
+
+void on_connected(){
+    TRACE(TRACE_LEVEL_INFO, TRACE_CONNECTED, 0, 0);
+    tcp_state = CONNECTION_CONNECTED;
+    backoff_ms = CONNECTION_BACKOFF_MIN_MS;
+    failed_attempts = 0;
+
+    // start reading packets from the top of the new stream
+    receive_reset();
+
+    // the saved settings work, the ap isn't needed any more
+    portal_stop();
+
+    BEC_E::send_log(DEVICE_NAME "_" DEVICE_ID " CONNECTED");
+    DBG_PRINTF("connected to %s\n", server_ip);
+
+    if (!ever_connected){
+        ever_connected = true;
+        send_wifi_timings();
+    }
+
+    // connect to udp
+    if (USE_UDP){
+        DBG_PRINTLN("\nconnecting to UDP");
+        udp_client.begin(SERVER_PORT_UDP);
+
+        // get the port
+        uint16_t port = SERVER_PORT_UDP;
+
+        // build buffer and specify the data type
+        uint8_t buffer[1 + sizeof(uint16_t)];
+        buffer[0] = Argument::UINT16;
+
+        // copy the port into the buffer
+        memcpy(buffer + 1, &port, sizeof(uint16_t));
+
+        // build the header
+        PacketHeader header = BEC_E::build_packet_header(ESTABLISH_UDP, 0, 1, sizeof(buffer), 1);
+
+        // tell the server to start listening to UDP
+        BEC_E::send_TCP(header, buffer);
+    }
+
+    tx_queue_flush();
+}
+
+void on_disconnected(){
+    TRACE(TRACE_LEVEL_INFO, TRACE_DISCONNECTED, 0, 0);
+    DBG_PRINTLN("TCP connection lost");
+    tcp_client.stop();
+
+    probe_stop(0);
+    primary_checking = false;
+    connected_server = -1;
+
+    // don't retry straight away so a restarted server isn't hit by every device at once
+    tcp_state = CONNECTION_BACKOFF;
+    next_attempt_ms = millis() + random(backoff_ms + 1);
+}
+
+bool tx_queue_push(const uint8_t* frame, uint16_t length){
+    if (tx_queue_used + sizeof(length) + length > TX_QUEUE_SIZE) return false;
+
+    // write the length then the frame, wrapping around the end of the buffer
+    const uint8_t* parts[2] = {(const uint8_t*)&length, frame};
+    uint16_t lengths[2] = {sizeof(length), length};
+
+    for (int part = 0; part < 2; part++){
+        for (uint16_t i = 0; i < lengths[part]; i++){
+            tx_queue[(tx_queue_head + tx_queue_used) % TX_QUEUE_SIZE] = parts[part][i];
+            tx_queue_used ++;
+        }
+    }
+
+    return true;
+}
+
+bool tx_queue_flush(){
+    while (tx_queue_used > 0){
+        // read the length
+        uint16_t length;
+        uint8_t* length_bytes = (uint8_t*)&length;
+        for (uint16_t i = 0; i < sizeof(length); i++){
+            length_bytes[i] = tx_queue[(tx_queue_head + i) % TX_QUEUE_SIZE];
+        }
+
+        // send the frame in at most two pieces
+        uint16_t start = (tx_queue_head + sizeof(length)) % TX_QUEUE_SIZE;
+        uint16_t first = min<uint16_t>(length, TX_QUEUE_SIZE - start);
+
+        if (tcp_client.write(tx_queue + start, first) != first) return false;
+        if (first < length && tcp_client.write(tx_queue, length - first) != (size_t)(length - first)) return false;
+
+        tx_queue_head = (tx_queue_head + sizeof(length) + length) % TX_QUEUE_SIZE;
+        tx_queue_used -= sizeof(length) + length;
+    }
+
+    return true;
+}
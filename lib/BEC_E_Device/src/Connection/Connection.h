@@ -0,0 +1,58 @@
+#pragma once
+
+#include "BEC_E_Device.h"
+
+// how long a single connection attempt may hold up the loop
+#ifndef CONNECTION_TIMEOUT_MS
+#define CONNECTION_TIMEOUT_MS 250
+#endif
+
+// read timeout restored once connected
+#ifndef CONNECTION_READ_TIMEOUT_MS
+#define CONNECTION_READ_TIMEOUT_MS 1000
+#endif
+
+#ifndef CONNECTION_BACKOFF_MIN_MS
+#define CONNECTION_BACKOFF_MIN_MS 500
+#endif
+
+#ifndef CONNECTION_BACKOFF_MAX_MS
+#define CONNECTION_BACKOFF_MAX_MS 30000
+#endif
+
+// servers the server can list for the device to fail over to, primary first
+#ifndef MAX_SERVERS
+#define MAX_SERVERS 4
+#endif
+
+// while connected to a backup, how often to check if the primary is back
+#ifndef PRIMARY_CHECK_MS
+#define PRIMARY_CHECK_MS 30000
+#endif
+
+// bytes of frames kept while disconnected
+#ifndef TX_QUEUE_SIZE
+#define TX_QUEUE_SIZE 1024
+#endif
+
+// the states of the server connection
+enum connection_state : uint8_t {
+    CONNECTION_BACKOFF   = 0, // waiting for the next attempt
+    CONNECTION_CONNECTED = 1, // connected to the server
+    CONNECTION_RACING    = 2, // attempts on the servers running
+};
+
+// a server the device can connect to. Saved in CONFIG_SERVERS
+struct ServerEndpoint {
+    uint32_t address;   // first octet in the low byte, like IPAddress
+    uint16_t tcp_port;
+    uint16_t udp_port;
+} __attribute__((packed));
+
+extern connection_state tcp_state;
+
+// function prototypes for internal functions
+void connection_begin();
+void connection_tick();
+bool connection_send(const uint8_t* frame, uint16_t length, send_policy policy);
+void handle_set_servers(ArgValue *, uint8_t);
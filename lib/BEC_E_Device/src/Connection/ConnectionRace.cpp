@@ -0,0 +1,62 @@
+#include "ConnectionRace.h"
+
+void race_begin(ConnectionRace& race, uint8_t count, uint32_t now_ms){
+    race.count = count < RACE_MAX_SERVERS ? count : RACE_MAX_SERVERS;
+    race.started = 0;
+    race.winner = -1;
+    race.begin_ms = now_ms;
+    race.last_start_ms = now_ms;
+
+    for (uint8_t i = 0; i < RACE_MAX_SERVERS; i++){
+        race.attempts[i] = ATTEMPT_WAITING;
+    }
+}
+
+int8_t race_next_start(ConnectionRace& race, uint32_t now_ms){
+    if (race.winner >= 0 || race.started == race.count) return -1;
+
+    // the next server waits out the stagger unless everything started so far has already failed
+    bool waiting = false;
+    for (uint8_t i = 0; i < race.started; i++){
+        if (race.attempts[i] == ATTEMPT_PENDING) waiting = true;
+    }
+
+    if (waiting && now_ms - race.last_start_ms < CONNECTION_STAGGER_MS) return -1;
+
+    uint8_t index = race.started++;
+    race.attempts[index] = ATTEMPT_PENDING;
+    race.started_ms[index] = now_ms;
+    race.last_start_ms = now_ms;
+    return index;
+}
+
+int8_t race_expired(ConnectionRace& race, uint32_t now_ms){
+    for (uint8_t i = 0; i < race.started; i++){
+        if (race.attempts[i] != ATTEMPT_PENDING || now_ms - race.started_ms[i] < CONNECTION_ATTEMPT_TIMEOUT_MS) continue;
+
+        race.attempts[i] = ATTEMPT_FAILED;
+        return i;
+    }
+
+    return -1;
+}
+
+void race_result(ConnectionRace& race, uint8_t index, bool connected){
+    if (index >= race.count || race.attempts[index] != ATTEMPT_PENDING) return;
+
+    race.attempts[index] = connected ? ATTEMPT_CONNECTED : ATTEMPT_FAILED;
+
+    // first to answer wins, the rest get dropped
+    if (connected && race.winner < 0) race.winner = index;
+}
+
+race_state race_status(const ConnectionRace& race){
+    if (race.winner >= 0) return RACE_WON;
+    if (race.started < race.count) return RACE_RUNNING;
+
+    for (uint8_t i = 0; i < race.count; i++){
+        if (race.attempts[i] == ATTEMPT_PENDING) return RACE_RUNNING;
+    }
+
+    return RACE_LOST;
+}
@@ -0,0 +1,51 @@
+#pragma once
+
+#include <stdint.h>
+
+#include "Connection.h"
+
+// time between starting attempts on the servers in turn. One that fails straight away starts the next early
+#ifndef CONNECTION_STAGGER_MS
+#define CONNECTION_STAGGER_MS 200
+#endif
+
+// how long an attempt on one server has to connect before it counts as failed
+#ifndef CONNECTION_ATTEMPT_TIMEOUT_MS
+#define CONNECTION_ATTEMPT_TIMEOUT_MS 2000
+#endif
+
+// every configured server plus the one discovery found
+#define RACE_MAX_SERVERS (MAX_SERVERS + 1)
+
+// where an attempt on one server is up to
+enum race_attempt : uint8_t {
+    ATTEMPT_WAITING   = 0, // not started yet
+    ATTEMPT_PENDING   = 1, // started, no answer yet
+    ATTEMPT_FAILED    = 2, // refused, unreachable or timed out
+    ATTEMPT_CONNECTED = 3, // the server answered
+};
+
+enum race_state : uint8_t {
+    RACE_RUNNING = 0,
+    RACE_WON     = 1, // winner holds the first server to answer
+    RACE_LOST    = 2, // every server failed
+};
+
+// attempts on a list of servers, each started a stagger after the one before, so a dead server only costs the stagger.
+// Only decides when to start and give up on attempts, the caller makes the connections
+struct ConnectionRace {
+    uint8_t count;
+    uint8_t started;        // attempts started so far, in list order
+    int8_t winner;          // -1 until a server answers
+    uint32_t begin_ms;
+    uint32_t last_start_ms;
+    uint32_t started_ms[RACE_MAX_SERVERS];
+    race_attempt attempts[RACE_MAX_SERVERS];
+};
+
+// function prototypes for internal functions
+void race_begin(ConnectionRace& race, uint8_t count, uint32_t now_ms);
+int8_t race_next_start(ConnectionRace& race, uint32_t now_ms);
+int8_t race_expired(ConnectionRace& race, uint32_t now_ms);
+void race_result(ConnectionRace& race, uint8_t index, bool connected);
+race_state race_status(const ConnectionRace& race);
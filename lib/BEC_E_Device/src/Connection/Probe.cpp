@@ -0,0 +1,129 @@
+#include <Arduino.h>
+
+#include "Probe.h"
+
+#if defined(ESP32)
+#include <lwip/sockets.h>
+
+// lwip sockets on the esp32 can connect without blocking and be checked with select
+struct Probe {
+    int fd = -1;
+    probe_state state;
+};
+
+Probe probes[RACE_MAX_SERVERS];
+
+bool probe_start(uint8_t slot, uint32_t address, uint16_t port){
+    probe_stop(slot);
+    Probe& probe = probes[slot];
+
+    probe.fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (probe.fd < 0) return false;
+    fcntl(probe.fd, F_SETFL, fcntl(probe.fd, F_GETFL, 0) | O_NONBLOCK);
+
+    sockaddr_in to = {};
+    to.sin_family = AF_INET;
+    to.sin_port = htons(port);
+    to.sin_addr.s_addr = address;
+
+    if (connect(probe.fd, (sockaddr*)&to, sizeof(to)) == 0) probe.state = PROBE_CONNECTED;
+    else if (errno == EINPROGRESS) probe.state = PROBE_PENDING;
+    else probe.state = PROBE_FAILED;
+
+    return true;
+}
+
+probe_state probe_poll(uint8_t slot){
+    Probe& probe = probes[slot];
+    if (probe.state != PROBE_PENDING) return probe.state;
+
+    // writable once the connection finished one way or the other
+    fd_set writable;
+    FD_ZERO(&writable);
+    FD_SET(probe.fd, &writable);
+    timeval no_wait = {0, 0};
+    if (select(probe.fd + 1, nullptr, &writable, nullptr, &no_wait) <= 0) return probe.state;
+
+    int error = 0;
+    socklen_t length = sizeof(error);
+    getsockopt(probe.fd, SOL_SOCKET, SO_ERROR, &error, &length);
+    probe.state = error == 0 ? PROBE_CONNECTED : PROBE_FAILED;
+    return probe.state;
+}
+
+void probe_stop(uint8_t slot){
+    Probe& probe = probes[slot];
+    if (probe.fd >= 0) close(probe.fd);
+
+    probe.fd = -1;
+    probe.state = PROBE_IDLE;
+}
+#else
+#include <lwip/tcp.h>
+
+// the raw lwip api, the callbacks run as soon as the server answers
+struct Probe {
+    tcp_pcb* pcb;
+    volatile probe_state state;
+};
+
+Probe probes[RACE_MAX_SERVERS];
+
+err_t probe_connected(void* arg, tcp_pcb* pcb, err_t err){
+    ((Probe*)arg)->state = PROBE_CONNECTED;
+    return ERR_OK;
+}
+
+void probe_error(void* arg, err_t err){
+    // lwip has already freed the pcb
+    Probe* probe = (Probe*)arg;
+    probe->pcb = nullptr;
+    probe->state = PROBE_FAILED;
+}
+
+bool probe_start(uint8_t slot, uint32_t address, uint16_t port){
+    probe_stop(slot);
+    Probe& probe = probes[slot];
+
+    probe.pcb = tcp_new();
+    if (probe.pcb == nullptr) return false;
+
+    tcp_arg(probe.pcb, &probe);
+    tcp_err(probe.pcb, probe_error);
+
+    ip_addr_t to;
+    ip_addr_set_ip4_u32(&to, address);
+
+    probe.state = PROBE_PENDING;
+    if (tcp_connect(probe.pcb, &to, port, probe_connected) != ERR_OK){
+        probe_stop(slot);
+        return false;
+    }
+
+    return true;
+}
+
+probe_state probe_poll(uint8_t slot){
+    return probes[slot].state;
+}
+
+void probe_stop(uint8_t slot){
+    Probe& probe = probes[slot];
+
+    if (probe.pcb != nullptr){
+        // nothing may call back into a probe that is being reused
+        tcp_arg(probe.pcb, nullptr);
+        tcp_err(probe.pcb, nullptr);
+        if (tcp_close(probe.pcb) != ERR_OK) tcp_abort(probe.pcb);
+    }
+
+    probe.pcb = nullptr;
+    probe.state = PROBE_IDLE;
+}
+#endif
+
+void probe_stop_all(){
+    for (uint8_t i = 0; i < RACE_MAX_SERVERS; i++){
+        probe_stop(i);
+    }
+}
@@ -0,0 +1,20 @@
+#pragma once
+
+#include <stdint.h>
+
+#include "ConnectionRace.h"
+
+// probes are tcp connections opened without waiting on them, to find out which servers are up.
+// WiFiClient::connect blocks the loop until it connects or times out, so it only connects to a server a probe reached
+enum probe_state : uint8_t {
+    PROBE_IDLE      = 0,
+    PROBE_PENDING   = 1,
+    PROBE_CONNECTED = 2,
+    PROBE_FAILED    = 3,
+};
+
+// function prototypes for internal functions
+bool probe_start(uint8_t slot, uint32_t address, uint16_t port);
+probe_state probe_poll(uint8_t slot);
+void probe_stop(uint8_t slot);
+void probe_stop_all();
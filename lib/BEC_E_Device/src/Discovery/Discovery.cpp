@@ -0,0 +1,141 @@
+#include <ESP8266WiFi.h>
+#include <WiFiUdp.h>
+
+#include "Discovery.h"
+
+#include "debug.h"
+#include "Network/Network.h"
+#include "Config/Config.h"
+#include "Connection/Connection.h"
+
+static_assert(sizeof(DiscoveredServer) <= CONFIG_MAX_VALUE, "DiscoveredServer doesn't fit in a config value");
+
+WiFiUDP discovery_udp;
+
+DiscoveredServer discovered;
+bool discovered_valid;
+
+// the server came from the config, so a connection to it has worked before
+bool discovered_saved;
+
+unsigned long next_query_ms;
+unsigned long query_interval_ms = DISCOVERY_INTERVAL_MS;
+
+void send_discovery_query();
+void read_discovery_replies();
+
+void discovery_begin(){
+    if (!USE_DISCOVERY) return;
+
+    // the server found last time, so the first attempt doesn't have to wait for an answer
+    discovered_valid = config_get(CONFIG_DISCOVERED_SERVER, &discovered, sizeof(discovered)) == sizeof(discovered);
+    discovered_saved = discovered_valid;
+
+    discovery_udp.begin(DISCOVERY_PORT);
+    next_query_ms = millis();
+}
+
+void discovery_tick(){
+    if (!USE_DISCOVERY) return;
+
+    // ask again straight away if the connection is lost, the server may have moved
+    if (tcp_state == CONNECTION_CONNECTED){
+        query_interval_ms = DISCOVERY_INTERVAL_MS;
+        next_query_ms = millis();
+        return;
+    }
+
+    if (WiFi.status() != WL_CONNECTED) return;
+
+    read_discovery_replies();
+
+    if ((long)(millis() - next_query_ms) < 0) return;
+
+    send_discovery_query();
+    next_query_ms = millis() + query_interval_ms;
+    query_interval_ms = min<unsigned long>(query_interval_ms * 2, DISCOVERY_INTERVAL_MAX_MS);
+}
+
+bool discovered_server(DiscoveredServer& server, bool& saved){
+    if (!USE_DISCOVERY || !discovered_valid) return false;
+
+    server = discovered;
+    saved = discovered_saved;
+    return true;
+}
+
+bool discovery_found(){
+    return USE_DISCOVERY && discovered_valid;
+}
+
+void discovery_confirm(){
+    if (!discovered_valid || discovered_saved) return;
+
+    // a connection worked, so the next boot can go straight to it
+    config_set(CONFIG_DISCOVERED_SERVER, &discovered, sizeof(discovered));
+    config_commit();
+    discovered_saved = true;
+}
+
+void send_discovery_query(){
+    // the name lets the server tell devices apart before they connect
+    const char name[] = DEVICE_NAME "_" DEVICE_ID;
+    uint16_t name_length = sizeof(name) - 1;
+    uint16_t payload_length = 1 + sizeof(name_length) + name_length;
+
+    uint8_t buffer[sizeof(PacketHeader) + 1 + sizeof(name_length) + sizeof(name) - 1 + sizeof(uint16_t)];
+    PacketHeader header = BEC_E::build_packet_header(DISCOVERY_QUERY, 0, 1, payload_length, 1);
+
+    uint16_t offset = 0;
+    memcpy(buffer + offset, &header, sizeof(header));
+    offset += sizeof(header);
+    buffer[offset++] = Argument::STRING;
+    memcpy(buffer + offset, &name_length, sizeof(name_length));
+    offset += sizeof(name_length);
+    memcpy(buffer + offset, name, name_length);
+    offset += name_length;
+
+    uint16_t crc = calculate_crc16(buffer, offset);
+    memcpy(buffer + offset, &crc, sizeof(crc));
+    offset += sizeof(crc);
+
+    DBG_PRINTLN("looking for the server");
+    discovery_udp.beginPacket(IPAddress(255, 255, 255, 255), DISCOVERY_PORT);
+    discovery_udp.write(buffer, offset);
+    discovery_udp.endPacket();
+}
+
+void read_discovery_replies(){
+    // [UINT16][tcp port][UINT16][udp port]. The server's address is where the reply came from
+    const uint16_t payload_length = 2 * (1 + sizeof(uint16_t));
+    uint8_t buffer[sizeof(PacketHeader) + payload_length + sizeof(uint16_t)];
+
+    int length;
+    while ((length = discovery_udp.parsePacket()) > 0){
+        // anything else, like our own query coming back, is thrown away by the next parsePacket
+        if (length != sizeof(buffer)) continue;
+
+        discovery_udp.read(buffer, sizeof(buffer));
+        if (!validate_datagram(buffer, length)) continue;
+
+        PacketHeader header;
+        memcpy(&header, buffer, sizeof(header));
+
+        uint8_t* payload = buffer + sizeof(header);
+        if (header.type != DISCOVERY_REPLY || header.payload_len != payload_length
+            || payload[0] != Argument::UINT16 || payload[1 + sizeof(uint16_t)] != Argument::UINT16) continue;
+
+        DiscoveredServer server;
+        server.address = (uint32_t)discovery_udp.remoteIP();
+        memcpy(&server.tcp_port, payload + 1, sizeof(uint16_t));
+        memcpy(&server.udp_port, payload + 2 + sizeof(uint16_t), sizeof(uint16_t));
+
+        // a fresh answer wins over the saved one, which may be where the server used to be
+        if (!discovered_valid || memcmp(&server, &discovered, sizeof(server)) != 0){
+            DBG_PRINTF("found the server at %s:%u\n", discovery_udp.remoteIP().toString().c_str(), server.tcp_port);
+            discovered = server;
+            discovered_saved = false;
+            discovered_valid = true;
+        }
+    }
+}
@@ -0,0 +1,36 @@
+#pragma once
+
+#include "BEC_E_Device.h"
+
+// ask the LAN where the server is instead of relying only on the address typed into the portal
+#ifndef USE_DISCOVERY
+#define USE_DISCOVERY true
+#endif
+
+// the server listens for queries on this port and answers to the port they came from
+#ifndef DISCOVERY_PORT
+#define DISCOVERY_PORT 15003
+#endif
+
+// time between queries while there is no connection. Doubles up to the max
+#ifndef DISCOVERY_INTERVAL_MS
+#define DISCOVERY_INTERVAL_MS 1000
+#endif
+
+#ifndef DISCOVERY_INTERVAL_MAX_MS
+#define DISCOVERY_INTERVAL_MAX_MS 30000
+#endif
+
+// where a server that answered can be reached. Saved in CONFIG_DISCOVERED_SERVER once a connection to it worked
+struct DiscoveredServer {
+    uint32_t address;   // first octet in the low byte, like IPAddress
+    uint16_t tcp_port;
+    uint16_t udp_port;
+} __attribute__((packed));
+
+// function prototypes for internal functions
+void discovery_begin();
+void discovery_tick();
+bool discovered_server(DiscoveredServer& server, bool& saved);
+bool discovery_found();
+void discovery_confirm();
@@ -4,38 +4,39 @@
 
 #include "debug.h"
 #include "Network/Network.h"
+#include "Config/Config.h"
 
 void clear_EEPROM(){
+    EEPROM.begin(EEPROM_SIZE);
+
     for (size_t i = 0; i < EEPROM.length(); i++) {
         EEPROM.write(i, 0xFF);
     }
 
     EEPROM.commit();
+    EEPROM.end();
 }
 
-void save_credentials(const char* ssid, const char* password, const char* server_address) {
-    if (EEPROM.read(0) != EEPROM_MAGIC){
-        DBG_PRINTLN("Setting magic number");
-        EEPROM.write(0, EEPROM_MAGIC);
-    }
+void import_legacy_EEPROM(){
+    EEPROM.begin(EEPROM_SIZE);
 
-    // Write SSID
-    DBG_PRINTF("Saving the SSID (%s)\n", ssid);
-    for (int i = 0; i < SSID_SIZE; i++){
-        EEPROM.write(2 + i, ssid[i]);
-    }
+    // read the whole layout at once
+    const uint8_t* data = EEPROM.getConstDataPtr();
 
-    // Write password
-    DBG_PRINTF("Saving the password (%s)\n", password);
-    for (int i = 0; i < WIFI_PASSWORD_SIZE; i++){
-        EEPROM.write(2 + SSID_SIZE + i, password[i]);
-    }
+    if (data[0] == EEPROM_MAGIC && data[1] == EEPROM_VERSION){
+        DBG_PRINTLN("importing the EEPROM");
 
-    // Write server IP
-    DBG_PRINTF("Saving the server IP (%s)\n", server_address);
-    for (int i = 0; i < SERVER_IP_SIZE; i++){
-        EEPROM.write(2 + SSID_SIZE + WIFI_PASSWORD_SIZE + i, server_address[i]);
+        config_set(CONFIG_SSID, data + EEPROM_SSID_OFFSET, strnlen((const char*)data + EEPROM_SSID_OFFSET, SSID_SIZE - 1));
+        config_set(CONFIG_PASSWORD, data + EEPROM_PASSWORD_OFFSET, strnlen((const char*)data + EEPROM_PASSWORD_OFFSET, WIFI_PASSWORD_SIZE - 1));
+        config_set(CONFIG_SERVER_IP, data + EEPROM_SERVER_IP_OFFSET, strnlen((const char*)data + EEPROM_SERVER_IP_OFFSET, SERVER_IP_SIZE - 1));
+
+        WiFiCache cache;
+        memcpy(&cache, data + EEPROM_WIFI_CACHE_OFFSET, sizeof(cache));
+        if (wifi_cache_valid(cache)){
+            config_set(CONFIG_WIFI_CACHE, &cache, sizeof(cache));
+        }
     }
 
-    EEPROM.commit();
-}
\ No newline at end of file
+    // free the RAM copy of the sector
+    EEPROM.end();
+}
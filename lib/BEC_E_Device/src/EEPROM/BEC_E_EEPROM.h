@@ -1,10 +1,19 @@
 #pragma once
 
 #include "BEC_E_Device.h"
+#include "Network/Network.h"
+#include "FastConnect/FastConnect.h"
 
 #define EEPROM_MAGIC 0x42
 #define EEPROM_VERSION 0
 
+// layout of the EEPROM used before the config store. Only read to import old devices
+#define EEPROM_SSID_OFFSET          2
+#define EEPROM_PASSWORD_OFFSET      (EEPROM_SSID_OFFSET + SSID_SIZE)
+#define EEPROM_SERVER_IP_OFFSET     (EEPROM_PASSWORD_OFFSET + WIFI_PASSWORD_SIZE)
+#define EEPROM_WIFI_CACHE_OFFSET    (EEPROM_SERVER_IP_OFFSET + SERVER_IP_SIZE)
+#define EEPROM_SIZE                 (EEPROM_WIFI_CACHE_OFFSET + sizeof(WiFiCache))
+
 // function prototypes for internal functions
-void save_credentials(const char*, const char*, const char*);
-void clear_EEPROM();
\ No newline at end of file
+void import_legacy_EEPROM();
+void clear_EEPROM();
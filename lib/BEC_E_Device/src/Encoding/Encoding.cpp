@@ -0,0 +1,75 @@
+#include "Encoding.h"
+
+// kept free of arduino so the host tools can use the same code
+
+uint8_t write_varint(uint8_t* buffer, uint32_t value){
+    // 7 bits per byte, the top bit set on every byte but the last
+    uint8_t length = 0;
+    while (value >= 0x80){
+        buffer[length++] = (value & 0x7F) | 0x80;
+        value >>= 7;
+    }
+    buffer[length++] = value;
+
+    return length;
+}
+
+uint8_t read_varint(const uint8_t* buffer, size_t length, uint32_t* value){
+    *value = 0;
+
+    for (uint8_t i = 0; i < MAX_VARINT_SIZE && i < length; i++){
+        *value |= (uint32_t)(buffer[i] & 0x7F) << (7 * i);
+        if ((buffer[i] & 0x80) == 0) return i + 1;
+    }
+
+    // ran off the end
+    return 0;
+}
+
+uint32_t zigzag_encode(int32_t value){
+    // small negative numbers become small positive ones so they stay short as varints
+    return ((uint32_t)value << 1) ^ (uint32_t)(value >> 31);
+}
+
+int32_t zigzag_decode(uint32_t value){
+    return (int32_t)(value >> 1) ^ -(int32_t)(value & 1);
+}
+
+size_t encode_deltas(const int32_t* values, uint16_t records, uint8_t width, uint8_t* buffer, size_t size, uint16_t* records_written){
+    // each record is width values. Every value is stored as the difference to the same value in the
+    // record before, the first record against 0. Differences wrap so unsigned values work too
+    size_t length = 0;
+    uint16_t record = 0;
+
+    for (; record < records; record++){
+        if (length + width * MAX_VARINT_SIZE > size) break;
+
+        for (uint8_t field = 0; field < width; field++){
+            uint32_t current = values[record * width + field];
+            uint32_t previous = record == 0 ? 0 : values[(record - 1) * width + field];
+            length += write_varint(buffer + length, zigzag_encode((int32_t)(current - previous)));
+        }
+    }
+
+    *records_written = record;
+
+    return length;
+}
+
+size_t decode_deltas(const uint8_t* buffer, size_t length, uint16_t records, uint8_t width, int32_t* values){
+    size_t offset = 0;
+
+    for (uint16_t record = 0; record < records; record++){
+        for (uint8_t field = 0; field < width; field++){
+            uint32_t encoded;
+            uint8_t used = read_varint(buffer + offset, length - offset, &encoded);
+            if (used == 0) return 0;
+            offset += used;
+
+            uint32_t previous = record == 0 ? 0 : values[(record - 1) * width + field];
+            values[record * width + field] = (int32_t)(previous + (uint32_t)zigzag_decode(encoded));
+        }
+    }
+
+    return offset;
+}
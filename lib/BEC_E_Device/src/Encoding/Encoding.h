@@ -0,0 +1,15 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+// most bytes a varint of a uint32_t can take
+#define MAX_VARINT_SIZE 5
+
+// function prototypes for internal functions
+uint8_t write_varint(uint8_t* buffer, uint32_t value);
+uint8_t read_varint(const uint8_t* buffer, size_t length, uint32_t* value);
+uint32_t zigzag_encode(int32_t value);
+int32_t zigzag_decode(uint32_t value);
+size_t encode_deltas(const int32_t* values, uint16_t records, uint8_t width, uint8_t* buffer, size_t size, uint16_t* records_written);
+size_t decode_deltas(const uint8_t* buffer, size_t length, uint16_t records, uint8_t width, int32_t* values);
@@ -0,0 +1,120 @@
+#include <Arduino.h>
+
+#include "Events.h"
+
+#include "Network/Network.h"
+
+#if defined(ESP32)
+#include <lwip/sockets.h>
+#else
+#include <coredecls.h>
+#include <lwip/tcp.h>
+#include <lwip/priv/tcp_priv.h>
+
+// the client's own lwip callbacks. Ours run in front of them and wake the loop out of client_wait
+tcp_recv_fn client_recv;
+tcp_err_fn client_error;
+volatile bool client_event;
+
+err_t client_recv_hook(void* arg, tcp_pcb* pcb, pbuf* data, err_t err);
+void client_error_hook(void* arg, err_t err);
+void watch_client();
+#endif
+
+uint16_t client_read(uint8_t* buffer, uint16_t size);
+bool client_wait(uint32_t timeout_ms);
+
+EventSource event_source = {client_read, client_wait};
+
+void events_set_source(const EventSource& source){
+    event_source = source;
+}
+
+uint16_t events_read(uint8_t* buffer, uint16_t size){
+    return event_source.read(buffer, size);
+}
+
+bool events_wait(uint32_t timeout_ms){
+    return event_source.wait(timeout_ms);
+}
+
+uint16_t client_read(uint8_t* buffer, uint16_t size){
+    // one call for everything that is there instead of a byte at a time
+    int available = tcp_client.available();
+    if (available <= 0) return 0;
+
+    int received = tcp_client.read(buffer, min<int>(available, size));
+    return received > 0 ? received : 0;
+}
+
+bool client_wait(uint32_t timeout_ms){
+    if (tcp_client.available() > 0) return true;
+
+#if defined(ESP32)
+    // lwip wakes the task as soon as data arrives, so nothing runs while we wait
+    int fd = tcp_client.fd();
+    if (fd >= 0){
+        fd_set readable;
+        FD_ZERO(&readable);
+        FD_SET(fd, &readable);
+
+        timeval timeout = {(time_t)(timeout_ms / 1000), (suseconds_t)(timeout_ms % 1000) * 1000};
+        return select(fd + 1, &readable, nullptr, nullptr, &timeout) > 0;
+    }
+
+    // not connected, nothing can arrive
+    delay(timeout_ms);
+    return false;
+#else
+    // lwip calls the hooks when data or an error arrives, which ends the delay early. The cpu and the radio
+    // sleep until then
+    client_event = false;
+    watch_client();
+    esp_delay(timeout_ms, [](){ return !client_event; });
+
+    return tcp_client.available() > 0;
+#endif
+}
+
+#if !defined(ESP32)
+void watch_client(){
+    if (!tcp_client.connected()) return;
+
+    // the client doesn't hand out its pcb, so find it among lwip's connections. It is looked up every time
+    // rather than kept, lwip frees it when the connection goes
+    uint32_t remote_address = tcp_client.remoteIP();
+    uint16_t remote_port = tcp_client.remotePort();
+    uint16_t local_port = tcp_client.localPort();
+
+    for (tcp_pcb* pcb = tcp_active_pcbs; pcb != nullptr; pcb = pcb->next){
+        if (pcb->local_port != local_port || pcb->remote_port != remote_port
+            || ip_addr_get_ip4_u32(&pcb->remote_ip) != remote_address) continue;
+
+        // a closing client clears its callbacks, leave those alone
+        if (pcb->recv != nullptr && pcb->recv != client_recv_hook){
+            client_recv = pcb->recv;
+            pcb->recv = client_recv_hook;
+        }
+        if (pcb->errf != nullptr && pcb->errf != client_error_hook){
+            client_error = pcb->errf;
+            pcb->errf = client_error_hook;
+        }
+        return;
+    }
+}
+
+err_t client_recv_hook(void* arg, tcp_pcb* pcb, pbuf* data, err_t err){
+    client_event = true;
+    esp_schedule();
+
+    return client_recv(arg, pcb, data, err);
+}
+
+void client_error_hook(void* arg, err_t err){
+    // the connection is gone, connection_tick notices on the next loop
+    client_event = true;
+    esp_schedule();
+
+    client_error(arg, err);
+}
+#endif
@@ -0,0 +1,23 @@
+#pragma once
+
+#include <stdint.h>
+
+#include "BEC_E_Device.h"
+
+// longest main_loop sleeps waiting for the server when it has nothing else to do. It wakes as soon as the server
+// sends something, but sampling, reports, local commands and loop functions run late by up to this much.
+// 0 keeps the loop spinning
+#ifndef BEC_E_IDLE_MS
+#define BEC_E_IDLE_MS 10
+#endif
+
+// where received bytes come from. The default reads the server connection, host tests swap in their own
+struct EventSource {
+    uint16_t (*read)(uint8_t* buffer, uint16_t size);  // copies out bytes that have already arrived, 0 if there are none
+    bool (*wait)(uint32_t timeout_ms);                 // sleeps until bytes arrive or the timeout passes. True if bytes are waiting
+};
+
+// function prototypes for internal functions
+void events_set_source(const EventSource& source);
+uint16_t events_read(uint8_t* buffer, uint16_t size);
+bool events_wait(uint32_t timeout_ms);
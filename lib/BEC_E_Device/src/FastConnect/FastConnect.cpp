@@ -0,0 +1,41 @@
+#include "FastConnect.h"
+
+#include <stdio.h>
+
+#include "debug.h"
+#include "BEC_E_Device.h"
+#include "Network/Network.h"
+#include "Config/Config.h"
+
+WiFiConnectState wifi_connect_state;
+
+bool wifi_cache_valid(const WiFiCache& cache){
+    if (cache.magic != WIFI_CACHE_MAGIC) return false;
+
+    return calculate_crc16((const uint8_t*)&cache, sizeof(WiFiCache) - sizeof(cache.crc)) == cache.crc;
+}
+
+void wifi_cache_seal(WiFiCache& cache){
+    cache.magic = WIFI_CACHE_MAGIC;
+    cache.crc = calculate_crc16((const uint8_t*)&cache, sizeof(WiFiCache) - sizeof(cache.crc));
+}
+
+bool load_wifi_cache(WiFiCache& cache){
+    return config_get(CONFIG_WIFI_CACHE, &cache, sizeof(cache)) == sizeof(cache) && wifi_cache_valid(cache);
+}
+
+void save_wifi_cache(const WiFiCache& cache){
+    // nothing is written if the cache didn't change
+    config_set(CONFIG_WIFI_CACHE, &cache, sizeof(cache));
+    config_commit();
+}
+
+void send_wifi_timings(){
+    char message[64];
+
+    snprintf(message, sizeof(message), "WiFi %s in %lums (fast %lums, scan %lums)",
+        wifi_connect_state.scan_ms == 0 ? "fast connected" : "connected",
+        wifi_connect_state.total_ms, wifi_connect_state.fast_ms, wifi_connect_state.scan_ms);
+
+    BEC_E::send_log(message);
+}
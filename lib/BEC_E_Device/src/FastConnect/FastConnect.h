@@ -0,0 +1,76 @@
+#pragma once
+
+#include <stdint.h>
+
+#ifndef WIFI_TIMEOUT_SECONDS
+#define WIFI_TIMEOUT_SECONDS 20
+#endif
+
+#ifndef WIFI_POLL_INTERVAL_MS
+#define WIFI_POLL_INTERVAL_MS 10
+#endif
+
+#ifndef WIFI_FAST_CONNECT_TIMEOUT_MS
+#define WIFI_FAST_CONNECT_TIMEOUT_MS 3000
+#endif
+
+// reuse the cached DHCP lease as a static ip so the fast path skips DHCP too. Off by default, the lease isn't
+// renewed while it's used this way, so only turn it on where the addresses are reserved for the devices
+#ifndef WIFI_CACHE_IP
+#define WIFI_CACHE_IP false
+#endif
+
+#define WIFI_CACHE_MAGIC 0xFC
+
+// the last good connection. Saved next to the credentials so the next boot can skip the scan and DHCP
+struct WiFiCache {
+    uint8_t magic;      // WIFI_CACHE_MAGIC when the cache has been written
+    uint8_t bssid[6];   // the access point we were associated with
+    uint8_t channel;    // the channel the access point was on
+    uint32_t local_ip;  // the DHCP lease
+    uint32_t gateway;
+    uint32_t subnet;
+    uint32_t dns;
+    uint16_t crc;       // crc of everything above
+} __attribute__((packed));
+
+// the phases of a connection attempt
+enum wifi_connect_phase : uint8_t {
+    WIFI_IDLE       = 0, // nothing started yet
+    WIFI_FAST       = 1, // direct association with the cached BSSID and channel
+    WIFI_SCAN       = 2, // full scan and DHCP
+    WIFI_CONNECTED  = 3,
+    WIFI_FAILED     = 4,
+};
+
+// what the caller has to do with the radio after a step
+enum wifi_connect_action : uint8_t {
+    WIFI_WAIT       = 0, // poll again after WIFI_POLL_INTERVAL_MS
+    WIFI_BEGIN_FAST = 1, // start a direct association from the cache
+    WIFI_BEGIN_SCAN = 2, // start a full scan with DHCP
+    WIFI_DONE       = 3, // connected
+    WIFI_GIVE_UP    = 4, // timed out
+};
+
+// state of a connection attempt. Contains no radio calls so it can be driven by a fake on the host
+struct WiFiConnectState {
+    wifi_connect_phase phase;
+    bool has_cache;                 // whether the fast phase can be tried
+    unsigned long start_ms;         // when the attempt started
+    unsigned long phase_start_ms;   // when the current phase started
+    unsigned long fast_ms;          // time spent in the fast phase
+    unsigned long scan_ms;          // time spent in the scan phase
+    unsigned long total_ms;         // time until connected or given up
+};
+
+// the last connection attempt, kept around so the timings can be reported once the server is up
+extern WiFiConnectState wifi_connect_state;
+
+// function prototypes for internal functions
+void wifi_connect_init(WiFiConnectState& state, bool has_cache, unsigned long now);
+wifi_connect_action wifi_connect_step(WiFiConnectState& state, bool connected, unsigned long now);
+bool wifi_cache_valid(const WiFiCache& cache);
+void wifi_cache_seal(WiFiCache& cache);
+bool load_wifi_cache(WiFiCache& cache);
+void save_wifi_cache(const WiFiCache& cache);
+void send_wifi_timings();
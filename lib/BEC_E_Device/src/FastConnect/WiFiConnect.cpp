@@ -0,0 +1,72 @@
+#include "FastConnect.h"
+
+void wifi_connect_init(WiFiConnectState& state, bool has_cache, unsigned long now){
+    state.phase = WIFI_IDLE;
+    state.has_cache = has_cache;
+    state.start_ms = now;
+    state.phase_start_ms = now;
+    state.fast_ms = 0;
+    state.scan_ms = 0;
+    state.total_ms = 0;
+}
+
+wifi_connect_action wifi_connect_step(WiFiConnectState& state, bool connected, unsigned long now){
+    unsigned long in_phase = now - state.phase_start_ms;
+
+    switch (state.phase){
+        case WIFI_IDLE:
+            state.phase_start_ms = now;
+
+            // only try the direct association if we have somewhere to go
+            if (state.has_cache){
+                state.phase = WIFI_FAST;
+                return WIFI_BEGIN_FAST;
+            }
+
+            state.phase = WIFI_SCAN;
+            return WIFI_BEGIN_SCAN;
+
+        case WIFI_FAST:
+            if (connected){
+                state.fast_ms = in_phase;
+                state.total_ms = now - state.start_ms;
+                state.phase = WIFI_CONNECTED;
+                return WIFI_DONE;
+            }
+
+            // the access point moved or the lease is gone, fall back to scanning
+            if (in_phase >= WIFI_FAST_CONNECT_TIMEOUT_MS){
+                state.fast_ms = in_phase;
+                state.phase = WIFI_SCAN;
+                state.phase_start_ms = now;
+                return WIFI_BEGIN_SCAN;
+            }
+
+            return WIFI_WAIT;
+
+        case WIFI_SCAN:
+            if (connected){
+                state.scan_ms = in_phase;
+                state.total_ms = now - state.start_ms;
+                state.phase = WIFI_CONNECTED;
+                return WIFI_DONE;
+            }
+
+            if (in_phase >= WIFI_TIMEOUT_SECONDS * 1000UL){
+                state.scan_ms = in_phase;
+                state.total_ms = now - state.start_ms;
+                state.phase = WIFI_FAILED;
+                return WIFI_GIVE_UP;
+            }
+
+            return WIFI_WAIT;
+
+        case WIFI_CONNECTED:
+            return WIFI_DONE;
+
+        case WIFI_FAILED:
+            return WIFI_GIVE_UP;
+    }
+
+    return WIFI_GIVE_UP;
+}
@@ -0,0 +1,17 @@
+#include "Flash.h"
+
+#include <flash_hal.h>
+
+bool chip_flash_read(uint32_t address, uint8_t* data, uint32_t length){
+    return flash_hal_read(FS_PHYS_ADDR + address, length, data) == FLASH_HAL_OK;
+}
+
+bool chip_flash_write(uint32_t address, const uint8_t* data, uint32_t length){
+    return flash_hal_write(FS_PHYS_ADDR + address, length, data) == FLASH_HAL_OK;
+}
+
+bool chip_flash_erase_sector(uint32_t address){
+    return flash_hal_erase(FS_PHYS_ADDR + address, FLASH_SECTOR_SIZE) == FLASH_HAL_OK;
+}
+
+FlashBackend flash = {chip_flash_read, chip_flash_write, chip_flash_erase_sector, FS_PHYS_SIZE};
@@ -0,0 +1,19 @@
+#pragma once
+
+#include <stdint.h>
+
+#ifndef FLASH_SECTOR_SIZE
+#define FLASH_SECTOR_SIZE 4096
+#endif
+
+// the raw flash used by the stores. The library uses the filesystem partition directly, so don't mount a filesystem on it.
+// addresses are relative to the start of the partition
+struct FlashBackend {
+    bool (*read)(uint32_t address, uint8_t* data, uint32_t length);
+    bool (*write)(uint32_t address, const uint8_t* data, uint32_t length); // can only clear bits
+    bool (*erase_sector)(uint32_t address);                                // sets the whole sector to 0xFF
+    uint32_t size;                                                         // bytes available
+};
+
+// defaults to the chip flash. Can be swapped out (e.g. for a file on the host) before main_setup
+extern FlashBackend flash;
@@ -0,0 +1,219 @@
+#include <Arduino.h>
+
+#include "FrameStream.h"
+
+#include "debug.h"
+#include "Network/Network.h"
+#include "Connection/Connection.h"
+
+// a frame being written, waiting or being sent
+struct FrameSlot {
+    uint8_t* data;
+    uint32_t length;
+    uint32_t frame_id;
+    uint32_t timestamp_us;
+    frame_slot_state state;
+};
+
+// the slots and the datagram buffer are only allocated once the first frame is started
+FrameSlot frame_slots[FRAME_SLOT_COUNT];
+uint8_t* fragment_buffer;
+
+int8_t writing_slot = -1;
+int8_t sending_slot = -1;
+uint16_t next_fragment;
+uint32_t next_frame_id;
+
+// bytes that can be sent right now, refilled at FRAME_STREAM_BITRATE
+uint32_t frame_tokens;
+unsigned long last_refill_us;
+
+FrameStats frame_stats;
+uint32_t window_frames;
+uint32_t window_bytes;
+unsigned long window_start_ms;
+
+int8_t pick_frame_to_send();
+bool send_fragment();
+void update_frame_stats();
+
+namespace BEC_E {
+    uint8_t* begin_frame(){
+        if (writing_slot >= 0) return nullptr;
+
+        // allocate everything the first time the stream is used
+        if (fragment_buffer == nullptr){
+            for (int i = 0; i < FRAME_SLOT_COUNT; i++){
+                frame_slots[i].data = new uint8_t[FRAME_SLOT_SIZE];
+                frame_slots[i].state = FRAME_FREE;
+            }
+
+            fragment_buffer = new uint8_t[FRAME_MTU];
+            last_refill_us = micros();
+            window_start_ms = millis();
+        }
+
+        // use a free slot, or the oldest frame still waiting. The sender is behind so that frame is stale anyway
+        int8_t slot = -1;
+        for (int i = 0; i < FRAME_SLOT_COUNT; i++){
+            if (frame_slots[i].state == FRAME_FREE){
+                slot = i;
+                break;
+            }
+
+            if (frame_slots[i].state == FRAME_READY && (slot < 0 || frame_slots[i].frame_id < frame_slots[slot].frame_id)){
+                slot = i;
+            }
+        }
+
+        if (slot < 0) return nullptr;
+
+        if (frame_slots[slot].state == FRAME_READY){
+            frame_stats.frames_dropped ++;
+        }
+
+        frame_slots[slot].state = FRAME_WRITING;
+        writing_slot = slot;
+
+        return frame_slots[slot].data;
+    }
+
+    void commit_frame(uint32_t length){
+        if (writing_slot < 0) return;
+
+        FrameSlot& slot = frame_slots[writing_slot];
+        slot.length = min<uint32_t>(length, FRAME_SLOT_SIZE);
+        slot.frame_id = next_frame_id++;
+        slot.timestamp_us = micros();
+        slot.state = FRAME_READY;
+
+        writing_slot = -1;
+    }
+
+    FrameStats get_frame_stats(){
+        return frame_stats;
+    }
+} // BEC_E namespace
+
+void frame_stream_tick(){
+    if (fragment_buffer == nullptr) return;
+
+    update_frame_stats();
+
+    // the server only listens for UDP once the TCP connection has set it up
+    if (tcp_state != CONNECTION_CONNECTED) return;
+
+    if (sending_slot < 0){
+        sending_slot = pick_frame_to_send();
+        if (sending_slot < 0) return;
+
+        frame_slots[sending_slot].state = FRAME_SENDING;
+        next_fragment = 0;
+    }
+
+    // refill the bucket for the time that has passed, allowing a small burst
+    unsigned long now_us = micros();
+    uint64_t refill = (uint64_t)(now_us - last_refill_us) * FRAME_STREAM_BITRATE / 8000000;
+    uint64_t burst = (uint64_t)FRAME_MTU * FRAME_FRAGMENTS_PER_TICK;
+    if (frame_tokens + refill >= burst){
+        // time spent with a full bucket isn't saved up
+        frame_tokens = burst;
+        last_refill_us = now_us;
+    }
+    else {
+        // only count the time the whole bytes stand for, the rest carries over to the next tick.
+        // Otherwise ticks shorter than a byte's time never refill anything
+        frame_tokens += refill;
+        last_refill_us += refill * 8000000 / FRAME_STREAM_BITRATE;
+    }
+
+    for (int i = 0; i < FRAME_FRAGMENTS_PER_TICK && frame_tokens >= FRAME_MTU; i++){
+        if (send_fragment()){
+            frame_slots[sending_slot].state = FRAME_FREE;
+            sending_slot = -1;
+            frame_stats.frames_sent ++;
+            window_frames ++;
+            return;
+        }
+    }
+}
+
+bool frame_stream_busy(){
+    // fragments go out a bucket at a time, so a frame being sent needs the loop to keep coming round
+    if (fragment_buffer == nullptr || tcp_state != CONNECTION_CONNECTED) return false;
+    if (sending_slot >= 0) return true;
+
+    for (int i = 0; i < FRAME_SLOT_COUNT; i++){
+        if (frame_slots[i].state == FRAME_READY) return true;
+    }
+
+    return false;
+}
+
+int8_t pick_frame_to_send(){
+    // send the newest frame, anything older has been overtaken
+    int8_t newest = -1;
+    for (int i = 0; i < FRAME_SLOT_COUNT; i++){
+        if (frame_slots[i].state != FRAME_READY) continue;
+
+        if (newest < 0 || frame_slots[i].frame_id > frame_slots[newest].frame_id){
+            newest = i;
+        }
+    }
+
+    for (int i = 0; i < FRAME_SLOT_COUNT; i++){
+        if (i != newest && frame_slots[i].state == FRAME_READY){
+            frame_slots[i].state = FRAME_FREE;
+            frame_stats.frames_dropped ++;
+        }
+    }
+
+    return newest;
+}
+
+bool send_fragment(){
+    FrameSlot& slot = frame_slots[sending_slot];
+
+    uint16_t fragment_count = max<uint32_t>(1, (slot.length + FRAME_FRAGMENT_DATA - 1) / FRAME_FRAGMENT_DATA);
+    uint32_t start = (uint32_t)next_fragment * FRAME_FRAGMENT_DATA;
+    uint16_t data_length = min<uint32_t>(FRAME_FRAGMENT_DATA, slot.length - start);
+
+    FragmentHeader fragment = {slot.frame_id, next_fragment, fragment_count, slot.timestamp_us, slot.length};
+    uint16_t payload_length = sizeof(fragment) + data_length;
+    PacketHeader header = BEC_E::build_packet_header(FRAME_FRAGMENT, next_fragment, fragment_count, payload_length, 0);
+
+    // build the datagram
+    uint16_t offset = 0;
+    memcpy(fragment_buffer + offset, &header, sizeof(header));
+    offset += sizeof(header);
+    memcpy(fragment_buffer + offset, &fragment, sizeof(fragment));
+    offset += sizeof(fragment);
+    memcpy(fragment_buffer + offset, slot.data + start, data_length);
+    offset += data_length;
+
+    uint16_t crc = calculate_crc16(fragment_buffer, offset);
+    memcpy(fragment_buffer + offset, &crc, sizeof(crc));
+    offset += sizeof(crc);
+
+    udp_client.beginPacket(server_ip, server_port_udp);
+    udp_client.write(fragment_buffer, offset);
+    udp_client.endPacket();
+
+    frame_tokens -= min<uint32_t>(frame_tokens, offset);
+    window_bytes += offset;
+    next_fragment ++;
+
+    return next_fragment >= fragment_count;
+}
+
+void update_frame_stats(){
+    unsigned long elapsed = millis() - window_start_ms;
+    if (elapsed < 1000) return;
+
+    frame_stats.fps = window_frames * 1000.0f / elapsed;
+    frame_stats.bytes_per_second = (uint64_t)window_bytes * 1000 / elapsed;
+
+    window_frames = 0;
+    window_bytes = 0;
+    window_start_ms = millis();
+}
@@ -0,0 +1,52 @@
+#pragma once
+
+#include <stdint.h>
+
+#include "BEC_E_Device.h"
+
+// number of frame slots. 2 double buffers, 3 lets the producer keep going while one frame is waiting
+#ifndef FRAME_SLOT_COUNT
+#define FRAME_SLOT_COUNT 3
+#endif
+
+#ifndef FRAME_SLOT_SIZE
+#define FRAME_SLOT_SIZE 4096
+#endif
+
+// largest datagram sent, including all headers and the crc
+#ifndef FRAME_MTU
+#define FRAME_MTU 1400
+#endif
+
+// bits per second the sender is allowed to use
+#ifndef FRAME_STREAM_BITRATE
+#define FRAME_STREAM_BITRATE 2000000
+#endif
+
+// most fragments sent per loop so user loop functions still get to run
+#ifndef FRAME_FRAGMENTS_PER_TICK
+#define FRAME_FRAGMENTS_PER_TICK 4
+#endif
+
+// added to the payload of every fragment after the packet header
+struct FragmentHeader {
+    uint32_t frame_id;        // increases by one for every committed frame
+    uint16_t fragment_index;  // position of this fragment in the frame
+    uint16_t fragment_count;  // total fragments in the frame
+    uint32_t timestamp_us;    // micros() when the frame was committed
+    uint32_t frame_length;    // length of the whole frame
+} __attribute__((packed));
+
+#define FRAME_FRAGMENT_DATA (FRAME_MTU - sizeof(PacketHeader) - sizeof(FragmentHeader) - sizeof(uint16_t))
+
+// the states of a frame slot
+enum frame_slot_state : uint8_t {
+    FRAME_FREE    = 0, // can be handed to the producer
+    FRAME_WRITING = 1, // being filled by the producer
+    FRAME_READY   = 2, // committed and waiting to be sent
+    FRAME_SENDING = 3, // fragments being sent
+};
+
+// function prototypes for internal functions
+void frame_stream_tick();
+bool frame_stream_busy();
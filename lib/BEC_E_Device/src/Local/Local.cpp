@@ -0,0 +1,170 @@
+#include <ESP8266WiFi.h>
+#include <WiFiUdp.h>
+
+#include "Local.h"
+
+#include "debug.h"
+#include "Network/Network.h"
+#include "Config/Config.h"
+#include "Areana/Arena.h"
+#include "Tasks/Tasks.h"
+#include "Commands/Commands.h"
+
+static_assert(MAX_LOCAL_PEERS * sizeof(uint32_t) <= CONFIG_MAX_VALUE, "MAX_LOCAL_PEERS don't fit in a config value");
+
+WiFiUDP local_udp;
+
+uint32_t local_peers[MAX_LOCAL_PEERS];
+uint8_t local_peer_count;
+
+RecentCommand recent_commands[LOCAL_RECENT_COMMANDS];
+uint8_t next_recent_command;
+
+bool local_peer_allowed(uint32_t address);
+RecentCommand* find_recent_command(uint32_t address, uint32_t packet_id);
+void mirror_to_server(uint32_t address, reply_status status, const uint8_t* frame, uint16_t length);
+void set_payload_length(uint8_t* frame, uint16_t payload_len);
+
+void local_begin(){
+    if (!USE_LOCAL_CONTROL) return;
+
+    int16_t length = config_get(CONFIG_LOCAL_PEERS, local_peers, sizeof(local_peers));
+    local_peer_count = length > 0 ? min<int16_t>(length, sizeof(local_peers)) / sizeof(uint32_t) : 0;
+
+    local_udp.begin(LOCAL_CONTROL_PORT);
+}
+
+void local_tick(){
+    if (!USE_LOCAL_CONTROL) return;
+
+    for (int i = 0; i < LOCAL_PACKETS_PER_TICK; i++){
+        int length = local_udp.parsePacket();
+        if (length <= 0) return;
+
+        // anything not read is thrown away by the next parsePacket
+        ReplyPeer peer = {(uint32_t)local_udp.remoteIP(), local_udp.remotePort()};
+        if (!local_peer_allowed(peer.address)){
+            DBG_PRINTF("local command from %s refused\n", local_udp.remoteIP().toString().c_str());
+            continue;
+        }
+
+        uint8_t* buffer = arena_malloc(length);
+        if (buffer == nullptr) continue;
+
+        local_udp.read(buffer, length);
+        if (!validate_datagram(buffer, length)){
+            arena_free();
+            continue;
+        }
+
+        PacketHeader header;
+        memcpy(&header, buffer, sizeof(header));
+
+        // the source address can be spoofed, so peers only get the device's own visible commands. Nothing sent
+        // locally can restart, update, reset or reconfigure the device
+        if (!is_user_command(header.type)){
+            DBG_PRINTF("local command %u refused\n", header.type);
+            send_reply(peer, header.packet_id, REPLY_UNKNOWN_COMMAND, nullptr, nullptr, 0);
+            arena_free();
+            continue;
+        }
+
+        // a resend because the reply got lost. Answer it again without running it twice
+        RecentCommand* recent = find_recent_command(peer.address, header.packet_id);
+        if (recent != nullptr){
+            if (recent->status != REPLY_DEFERRED) send_reply(peer, header.packet_id, recent->status, nullptr, nullptr, 0);
+            arena_free();
+            continue;
+        }
+
+        // commands are parsed the way the server frames them, with the crc counted in payload_len. A datagram
+        // framed like the device's packets is relabelled while it runs and mirrored as it came
+        bool crc_after_payload = sizeof(PacketHeader) + header.payload_len + sizeof(uint16_t) == (size_t)length;
+        if (crc_after_payload) set_payload_length(buffer, header.payload_len + sizeof(uint16_t));
+
+        reply_status status = handle_packet(buffer, peer);
+
+        if (crc_after_payload) set_payload_length(buffer, header.payload_len);
+
+        RecentCommand& remembered = recent_commands[next_recent_command];
+        remembered = {peer.address, header.packet_id, status};
+        next_recent_command = (next_recent_command + 1) % LOCAL_RECENT_COMMANDS;
+
+        // the server stays in charge of the device state, so tell it what ran
+        mirror_to_server(peer.address, status, buffer, length);
+
+        arena_free();
+    }
+}
+
+void set_payload_length(uint8_t* frame, uint16_t payload_len){
+    memcpy(frame + offsetof(PacketHeader, payload_len), &payload_len, sizeof(payload_len));
+}
+
+bool local_send(const ReplyPeer& peer, PacketHeader header, const uint8_t* payload){
+    // same framing as send_UDP, but to the peer
+    uint8_t buffer[sizeof(PacketHeader) + REPLY_MAX_SIZE + sizeof(uint16_t)];
+    if (header.payload_len > REPLY_MAX_SIZE) return false;
+
+    memcpy(buffer, &header, sizeof(header));
+    memcpy(buffer + sizeof(header), payload, header.payload_len);
+    uint16_t length = sizeof(header) + header.payload_len;
+
+    uint16_t crc = calculate_crc16(buffer, length);
+    memcpy(buffer + length, &crc, sizeof(crc));
+    length += sizeof(crc);
+
+    local_udp.beginPacket(IPAddress(peer.address), peer.port);
+    local_udp.write(buffer, length);
+    return local_udp.endPacket() == 1;
+}
+
+void handle_local_peers(ArgValue args[], uint8_t arg_number){
+    // each argument is a UINT32 address with the first octet in the low byte. None closes local control
+    // a bad list is refused before anything is changed, so the saved peers stay as they were
+    const Argument::arg_type address_type = Argument::UINT32;
+    if (arg_number > MAX_LOCAL_PEERS || !arguments_match(&address_type, 1)){
+        BEC_E::reply(REPLY_ERROR);
+        return;
+    }
+
+    local_peer_count = arg_number;
+    for (uint8_t i = 0; i < local_peer_count; i++){
+        local_peers[i] = args[i].uint32_val;
+    }
+
+    if (local_peer_count == 0) config_erase(CONFIG_LOCAL_PEERS);
+    else config_set(CONFIG_LOCAL_PEERS, local_peers, local_peer_count * sizeof(uint32_t));
+
+    config_commit();
+}
+
+bool local_peer_allowed(uint32_t address){
+    for (uint8_t i = 0; i < local_peer_count; i++){
+        if (local_peers[i] == address) return true;
+    }
+
+    return false;
+}
+
+RecentCommand* find_recent_command(uint32_t address, uint32_t packet_id){
+    for (int i = 0; i < LOCAL_RECENT_COMMANDS; i++){
+        RecentCommand& recent = recent_commands[i];
+        if (recent.address == address && recent.packet_id == packet_id) return &recent;
+    }
+
+    return nullptr;
+}
+
+void mirror_to_server(uint32_t address, reply_status status, const uint8_t* frame, uint16_t length){
+    uint8_t* buffer = arena_malloc(sizeof(LocalCommandHeader) + length);
+    if (buffer == nullptr) return;
+
+    LocalCommandHeader local_header = {address, status};
+    memcpy(buffer, &local_header, sizeof(local_header));
+    memcpy(buffer + sizeof(local_header), frame, length);
+
+    // raw binary like the frame stream, so no typed arguments
+    PacketHeader header = BEC_E::build_packet_header(LOCAL_COMMAND, 0, 1, sizeof(local_header) + length, 0);
+    BEC_E::send_TCP(header, buffer);
+}
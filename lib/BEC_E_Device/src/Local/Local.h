@@ -0,0 +1,49 @@
+#pragma once
+
+#include "BEC_E_Device.h"
+#include "Reply/Reply.h"
+
+// accept commands straight from allowed devices on the LAN. Only the user's visible commands, never the built in ones
+#ifndef USE_LOCAL_CONTROL
+#define USE_LOCAL_CONTROL false
+#endif
+
+// commands can be framed like the server's, with the crc counted in payload_len, or like the device's packets,
+// with the crc after it. Replies are framed like the device's packets
+#ifndef LOCAL_CONTROL_PORT
+#define LOCAL_CONTROL_PORT 15002
+#endif
+
+// addresses allowed to send local commands, set by the server and saved in one config value
+#ifndef MAX_LOCAL_PEERS
+#define MAX_LOCAL_PEERS 8
+#endif
+
+// commands remembered so a peer resending one doesn't run it twice
+#ifndef LOCAL_RECENT_COMMANDS
+#define LOCAL_RECENT_COMMANDS 16
+#endif
+
+// most datagrams handled per loop
+#ifndef LOCAL_PACKETS_PER_TICK
+#define LOCAL_PACKETS_PER_TICK 4
+#endif
+
+// sent to the server in front of a command a peer ran locally, followed by the whole command packet
+struct LocalCommandHeader {
+    uint32_t peer_address;  // who sent it
+    uint8_t status;         // the reply_status it was answered with, 0xFF if it completes later
+} __attribute__((packed));
+
+// a command already run for a peer
+struct RecentCommand {
+    uint32_t address;
+    uint32_t packet_id;
+    reply_status status;
+};
+
+// function prototypes for internal functions
+void local_begin();
+void local_tick();
+bool local_send(const ReplyPeer& peer, PacketHeader header, const uint8_t* payload);
+void handle_local_peers(ArgValue *, uint8_t);
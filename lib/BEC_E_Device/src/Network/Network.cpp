@@ -1,27 +1,26 @@
 #include <ESP8266WiFi.h>
-#include <ESP8266WebServer.h>
 #include <WiFiUdp.h>
 
 #include "Network.h"
 
 #include "debug.h"
 #include "BEC_E_Device.h"
-#include "EEPROM/BEC_E_EEPROM.h"
+#include "Config/Config.h"
+#include "FastConnect/FastConnect.h"
 
 // give everything access to the server ip, ssid, and password
 char ssid[SSID_SIZE];
 char password[WIFI_PASSWORD_SIZE];
 char server_ip[SERVER_IP_SIZE];
 
+// the ports of the server we are connected to, which discovery can change
+uint16_t server_port_tcp = SERVER_PORT_TCP;
+uint16_t server_port_udp = SERVER_PORT_UDP;
+
 // communication controllers
 WiFiClient tcp_client;
 WiFiUDP udp_client;
 
-ESP8266WebServer server(80);
-
-void handle_root();
-void handle_submit();
-
 bool connect_wifi(char* ssid, char* password){
     DBG_PRINTLN();
     DBG_PRINT("Connecting to ");
@@ -29,146 +28,71 @@ bool connect_wifi(char* ssid, char* password){
     DBG_PRINT(" with password ");
     DBG_PRINTLN(password);
 
-    WiFi.begin(ssid, password);
-    
-    int attempts = 0;
-    
-    // loop until connected or until timeout
-    while (WiFi.status() != WL_CONNECTED) {
-        delay(500);
-        DBG_PRINT(".");
-
-        if (attempts >= 2 * WIFI_TIMEOUT_SECONDS){
-            DBG_PRINTLN("\nWIFI timed out");
-            return false;
-        }
-        else{
-            attempts ++;
-        }
-    }
-
-    DBG_PRINTLN("");
-    DBG_PRINTLN("WiFi connected");
-    DBG_PRINT("IP address: ");
-    DBG_PRINTLN(WiFi.localIP());
-
-    return true;
-}
-
-void run_AP(){
-    DBG_PRINTLN("running AP with name " DEVICE_NAME "_" DEVICE_ID ". Go to 192.168.0.1 to set up device");
-
-    const IPAddress local_ip(192, 168, 0, 1);     // ESP's own IP
-    const IPAddress gateway(192, 168, 0, 1);      // Gateway (same as IP for SoftAP)
-    const IPAddress subnet(255, 255, 255, 0);     // Subnet mask
-    
-    WiFi.softAPConfig(local_ip, gateway, subnet);
-
-    WiFi.softAP(DEVICE_NAME "_" DEVICE_ID);
-    
-    server.on("/", handle_root);
-    server.on("/submit", handle_submit);
-    server.begin();
-
-    for(;;) server.handleClient();
-}
-
-void handle_root() {
-    String html;
-    html += "<!DOCTYPE html><html><head>";
-    html += "<meta name=\"viewport\" content=\"width=device-width, initial-scale=1\">";
-    html += "<style>";
-    html += "body{font-family:sans-serif;background:#f5f5f5;margin:0;padding:20px;}";
-    html += "form{max-width:400px;margin:auto;background:#fff;padding:20px;border-radius:8px;}";
-    html += "label{display:block;margin-top:15px;font-weight:bold;}";
-    html += "input{width:100%;padding:10px;margin-top:5px;font-size:16px;}";
-    html += "button{width:100%;margin-top:20px;padding:12px;font-size:18px;";
-    html += "background:#007bff;color:#fff;border:none;border-radius:6px;}";
-    html += "</style></head><body>";
-
-    html += "<form action=\"/submit\" method=\"POST\">";
-
-    html += "<label>WiFi SSID</label>";
-    html += "<input name=\"ssid\" maxlength=\"" + String(SSID_SIZE - 1) + "\" value=\"" + ssid + "\">";
-
-    html += "<label>Password</label>";
-    html += "<input type=\"password\" name=\"pass\" maxlength=\"" + String(WIFI_PASSWORD_SIZE - 1) + "\" value=\"" + password + "\">";
+    // load where we were connected last time
+    WiFiCache cache;
+    bool has_cache = load_wifi_cache(cache);
 
-    html += "<label>Server IP</label>";
-    html += "<input name=\"server_ip\" maxlength=\"" + String(SERVER_IP_SIZE - 1) + "\" value=\"" + server_ip + "\">";
+    // stop the SDK from rewriting its own copy of the credentials to flash on every begin
+    WiFi.persistent(false);
+    WiFi.mode(WIFI_STA);
 
-    html += "<button type=\"submit\">Save & Connect</button>";
-    html += "</form></body></html>";
+    wifi_connect_init(wifi_connect_state, has_cache, millis());
 
-    server.send(200, "text/html", html);
-
-}
+    // loop until connected or until timeout
+    bool waiting = true;
+    while (waiting) {
+        switch (wifi_connect_step(wifi_connect_state, WiFi.status() == WL_CONNECTED, millis())){
+            case WIFI_BEGIN_FAST:
+                DBG_PRINTF("fast connecting on channel %d\n", cache.channel);
 
-void handle_submit() {
-    char ssid[SSID_SIZE];
-    char pass[WIFI_PASSWORD_SIZE];
-    char ip[SERVER_IP_SIZE];
-
-    // --- Copy SSID ---
-    if (server.hasArg("ssid")) {
-        strncpy(ssid, server.arg("ssid").c_str(), SSID_SIZE);
-        ssid[SSID_SIZE - 1] = '\0';
-    } else {
-        ssid[0] = '\0';
-    }
+                if (WIFI_CACHE_IP){
+                    WiFi.config(IPAddress(cache.local_ip), IPAddress(cache.gateway), IPAddress(cache.subnet), IPAddress(cache.dns));
+                }
 
-    // --- Copy password ---
-    if (server.hasArg("pass")) {
-        strncpy(pass, server.arg("pass").c_str(), WIFI_PASSWORD_SIZE);
-        pass[WIFI_PASSWORD_SIZE - 1] = '\0';
-    } else {
-        pass[0] = '\0';
-    }
+                WiFi.begin(ssid, password, cache.channel, cache.bssid);
+            break;
+            case WIFI_BEGIN_SCAN:
+                DBG_PRINTLN("scanning for the network");
 
-    // --- Copy server IP ---
-    if (server.hasArg("server_ip")) {
-        strncpy(ip, server.arg("server_ip").c_str(), SERVER_IP_SIZE);
-        ip[SERVER_IP_SIZE - 1] = '\0';
-    } else {
-        ip[0] = '\0';
+                // drop the cached access point and lease and go back to DHCP
+                WiFi.disconnect();
+                WiFi.config(0u, 0u, 0u);
+                WiFi.begin(ssid, password);
+            break;
+            case WIFI_WAIT:
+                delay(WIFI_POLL_INTERVAL_MS);
+            break;
+            case WIFI_DONE:
+                waiting = false;
+            break;
+            case WIFI_GIVE_UP:
+                DBG_PRINTLN("\nWIFI timed out");
+                return false;
+        }
     }
 
-    // --- Save credentials ---
-    save_credentials(ssid, pass, ip);
-
-    // --- Build mobile-friendly response ---
-    String html;
-    html += "<!DOCTYPE html><html><head>";
-    html += "<meta name=\"viewport\" content=\"width=device-width, initial-scale=1\">";
-    html += "<style>";
-    html += "body{font-family:sans-serif;background:#f5f5f5;margin:0;padding:20px;text-align:center;}";
-    html += ".card{max-width:400px;margin:auto;background:#fff;padding:30px;border-radius:8px;}";
-    html += "h1{margin-top:0;font-size:22px;}";
-    html += "p{font-size:16px;color:#555;}";
-    html += "</style></head><body>";
-
-    html += "<div class=\"card\">";
-    html += "<h1>Settings Saved</h1>";
-    html += "<p>The device is restarting.</p>";
-    html += "<p>Please reconnect to your normal Wi-Fi network.</p>";
-    html += "</div>";
-
-    html += "</body></html>";
-
-    // --- Send response ---
-    server.send(200, "text/html", html);
+    // remember the access point and lease for the next boot
+    memcpy(cache.bssid, WiFi.BSSID(), sizeof(cache.bssid));
+    cache.channel = WiFi.channel();
+    cache.local_ip = WiFi.localIP();
+    cache.gateway = WiFi.gatewayIP();
+    cache.subnet = WiFi.subnetMask();
+    cache.dns = WiFi.dnsIP();
+    wifi_cache_seal(cache);
+    save_wifi_cache(cache);
 
-    // Give browser time to receive page
-    delay(1500);
+    DBG_PRINTLN("");
+    DBG_PRINTF("WiFi connected in %lums\n", wifi_connect_state.total_ms);
+    DBG_PRINT("IP address: ");
+    DBG_PRINTLN(WiFi.localIP());
 
-    // Restart device
-    ESP.restart();
+    return true;
 }
 
 // TODO split into multiple
 void send_single_command(const Command& cmd) {
-    // get the normal size
-    uint16_t name_len = strlen(cmd.name);
+    // the name and options may be in flash. The _P functions read RAM too
+    uint16_t name_len = strlen_P(cmd.name);
 
     //                    arg type          string len         string     command id       command type
     uint16_t total_size = sizeof(uint8_t) + sizeof(uint16_t) + name_len + sizeof(cmd.id) + sizeof(cmd.type);
@@ -194,9 +118,12 @@ void send_single_command(const Command& cmd) {
 
             // add enough space for all of the arguments
             for (int i = 0; i < cmd.additional_arg_num; i++){
+                ArgValue option;
+                memcpy_P(&option, &cmd.additional_args[i], sizeof(option));
+
                 total_size += sizeof(uint8_t); //for the argument type
                 total_size += sizeof(uint8_t); //for the string len
-                total_size += strlen(cmd.additional_args[i].str_val);
+                total_size += strlen_P(option.str_val);
             }
         break;
         case BUTTON:
@@ -224,7 +151,7 @@ void send_single_command(const Command& cmd) {
     offset += sizeof(name_len);
 
     // add the name
-    memcpy(buffer + offset, cmd.name, name_len);
+    memcpy_P(buffer + offset, cmd.name, name_len);
     offset += name_len;
 
     // add the id
@@ -245,7 +172,7 @@ void send_single_command(const Command& cmd) {
             offset += sizeof(argument_type);
 
             // add the starting value
-            memcpy(buffer + offset, &cmd.additional_args[0].uint8_val, sizeof(ArgValue().uint8_val));
+            memcpy_P(buffer + offset, &cmd.additional_args[0].uint8_val, sizeof(ArgValue().uint8_val));
             offset += sizeof(ArgValue().uint8_val);
             
             // add second argument as type uint8
@@ -253,15 +180,18 @@ void send_single_command(const Command& cmd) {
             offset += sizeof(argument_type);
 
             // add the ending value
-            memcpy(buffer + offset, &cmd.additional_args[1].uint8_val, sizeof(ArgValue().uint8_val));
+            memcpy_P(buffer + offset, &cmd.additional_args[1].uint8_val, sizeof(ArgValue().uint8_val));
             offset += sizeof(ArgValue().uint8_val);
         break;
         case DROPDOWN:
             argument_type = Argument::STRING;
             
             for (int i = 0; i < cmd.additional_arg_num; i++){
+                ArgValue option;
+                memcpy_P(&option, &cmd.additional_args[i], sizeof(option));
+
                 // get the length of the string
-                uint8_t str_len = strlen(cmd.additional_args[i].str_val);
+                uint8_t str_len = strlen_P(option.str_val);
                 
                 // add argument as type string
                 memcpy(buffer + offset, &argument_type, sizeof(argument_type));
@@ -272,7 +202,7 @@ void send_single_command(const Command& cmd) {
                 offset += sizeof(uint8_t);
 
                 // add the string to the buffer
-                memcpy(buffer + offset, cmd.additional_args[i].str_val, str_len);
+                memcpy_P(buffer + offset, option.str_val, str_len);
                 offset += str_len;
             }
         break;
@@ -290,30 +220,3 @@ void send_single_command(const Command& cmd) {
 
     delete[] buffer;
 }
-
-uint16_t calculate_crc16(const uint8_t* data, size_t length) {
-    uint16_t crc = 0xFFFF;
-    for (size_t i = 0; i < length; i++) {
-        crc ^= (uint16_t)data[i] << 8;
-        for (uint8_t j = 0; j < 8; j++) {
-            if (crc & 0x8000)
-                crc = (crc << 1) ^ 0x1021;
-            else
-                crc <<= 1;
-        }
-    }
-    return crc;
-}
-
-bool validate_crc(uint8_t* buffer, PacketHeader header){
-    uint16_t total_len = sizeof(PacketHeader) + header.payload_len;
-
-    // get the crc at the end of the packet
-    uint16_t crc_received;
-    memcpy(&crc_received, buffer + total_len - 2, sizeof(crc_received));
-
-    // calculate the crc of the packet
-    uint16_t crc_computed = calculate_crc16(buffer, total_len - 2);
-
-    return crc_received == crc_computed;
-}
\ No newline at end of file
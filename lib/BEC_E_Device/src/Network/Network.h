@@ -4,10 +4,7 @@
 #include <WiFiUdp.h>
 
 #include "BEC_E_Device.h"
-
-#ifndef WIFI_TIMEOUT_SECONDS
-#define WIFI_TIMEOUT_SECONDS 20
-#endif
+#include "Packet/Wire.h"
 
 #ifndef SSID_SIZE
 #define SSID_SIZE 33
@@ -34,6 +31,8 @@
 #endif
 
 extern char server_ip[];
+extern uint16_t server_port_tcp;
+extern uint16_t server_port_udp;
 extern char ssid[];
 extern char password[];
 
@@ -47,12 +46,21 @@ enum default_message_type : uint16_t {
     SEND_NAME       = 65533,
     ESTABLISH_UDP   = 65532,
     RESEND          = 65531,
+    OTA_PROGRESS    = 65530,
+    FRAME_FRAGMENT  = 65529,
+    TRACE_DUMP      = 65528,
+    CLOCK_REQUEST   = 65527,
+    TELEMETRY_BATCH = 65526,
+    SAMPLE_BATCH    = 65525,
+    REPORT          = 65524,
+    REPLY           = 65523,
+    LOCAL_COMMAND   = 65522,
+    DISCOVERY_QUERY = 65521,
+    DISCOVERY_REPLY = 65520,
+    STATE_SYNC      = 65519,
+    CAPTURE_DUMP    = 65518,
 };
 
 // function prototypes for internal functions
 void send_single_command(const Command&);
-bool connect_wifi(char*, char*);
-void run_AP();
-uint16_t calculate_crc16(const uint8_t* data, size_t length);
-bool validate_crc(uint8_t* buffer, PacketHeader header);
-uint16_t parse_argument(ArgValue& arg, uint8_t* payload);
\ No newline at end of file
+bool connect_wifi(char*, char*);
\ No newline at end of file
@@ -0,0 +1,387 @@
+#include <ESP8266WiFi.h>
+#include <Updater.h>
+
+#include "OTA.h"
+
+#include "debug.h"
+#include "Network/Network.h"
+
+ota_state ota_current_state = OTA_IDLE;
+ota_file ota_current_file;
+
+WiFiClient ota_client;
+
+// response being read
+int ota_status;
+uint32_t ota_content_length;
+uint32_t ota_range_start;
+uint32_t ota_range_total;
+bool ota_chunked;
+char ota_line[128];
+uint8_t ota_line_length;
+
+// body of the version and hash files
+char ota_text[40];
+uint8_t ota_text_length;
+
+// firmware progress. The offset is everything handed to the updater so far and is where a resume starts
+char ota_md5[33];
+uint32_t ota_offset;
+uint32_t ota_total;
+uint32_t ota_skip;
+uint8_t ota_last_progress;
+
+uint8_t ota_retries;
+unsigned long ota_wait_start_ms;
+unsigned long ota_last_data_ms;
+
+void ota_request();
+void ota_read_headers();
+void ota_read_body();
+void ota_read_firmware();
+void ota_finish_file();
+void ota_header(const char* line);
+void ota_connection_lost();
+void ota_fail(const char* message);
+void ota_send_progress();
+
+void ota_start(){
+    if (ota_current_state != OTA_IDLE){
+        BEC_E::send_log("Update already running");
+        return;
+    }
+
+    BEC_E::send_log("Checking for updates");
+
+    ota_current_file = OTA_VERSION_FILE;
+    ota_retries = 0;
+    ota_current_state = OTA_REQUEST;
+}
+
+void ota_tick(){
+    switch (ota_current_state){
+        case OTA_IDLE:
+        break;
+        case OTA_REQUEST:
+            ota_request();
+        break;
+        case OTA_HEADERS:
+            ota_read_headers();
+        break;
+        case OTA_BODY:
+            ota_read_body();
+        break;
+        case OTA_RETRY:
+            if (millis() - ota_wait_start_ms >= OTA_RETRY_MS){
+                ota_current_state = OTA_REQUEST;
+            }
+        break;
+        case OTA_RESTART:
+            // give the log time to reach the server
+            if (millis() - ota_wait_start_ms >= 500){
+                ESP.restart();
+            }
+        break;
+    }
+}
+
+void ota_request(){
+    // set up the path for the file we need
+    char path[64];
+    switch (ota_current_file){
+        case OTA_VERSION_FILE:
+            snprintf(path, sizeof(path), "/IOT/firmware/%s_version.txt", DEVICE_NAME);
+        break;
+        case OTA_HASH_FILE:
+            snprintf(path, sizeof(path), "/IOT/firmware/%s/firmware.md5", DEVICE_NAME);
+        break;
+        case OTA_FIRMWARE_FILE:
+            snprintf(path, sizeof(path), "/IOT/firmware/%s/firmware.txt", DEVICE_NAME);
+        break;
+    }
+
+    DBG_PRINTF("OTA requesting %s from %u\n", path, ota_offset);
+
+    // bound how long connecting can hold up the loop
+    ota_client.setTimeout(250);
+    if (!ota_client.connect(server_ip, OTA_HTTP_PORT)){
+        ota_connection_lost();
+        return;
+    }
+
+    // HTTP/1.0 so the server can't answer with a chunked body, which isn't decoded here.
+    // Asks for the rest of the firmware if we are resuming
+    char request[192];
+    int length = snprintf(request, sizeof(request), "GET %s HTTP/1.0\r\nHost: %s\r\n", path, server_ip);
+    if (ota_current_file == OTA_FIRMWARE_FILE && ota_offset > 0){
+        length += snprintf(request + length, sizeof(request) - length, "Range: bytes=%u-\r\n", ota_offset);
+    }
+    length += snprintf(request + length, sizeof(request) - length, "\r\n");
+
+    ota_client.write((const uint8_t*)request, length);
+
+    ota_status = 0;
+    ota_content_length = 0;
+    ota_range_start = 0;
+    ota_range_total = 0;
+    ota_chunked = false;
+    ota_line_length = 0;
+    ota_text_length = 0;
+    ota_last_data_ms = millis();
+    ota_current_state = OTA_HEADERS;
+}
+
+void ota_read_headers(){
+    // only read what has already arrived
+    while (ota_client.available()){
+        char c = ota_client.read();
+        ota_last_data_ms = millis();
+
+        if (c == '\r') continue;
+
+        if (c != '\n'){
+            if (ota_line_length < sizeof(ota_line) - 1) ota_line[ota_line_length++] = c;
+            continue;
+        }
+
+        ota_line[ota_line_length] = '\0';
+        ota_line_length = 0;
+
+        // a blank line ends the headers
+        if (ota_line[0] == '\0'){
+            if (ota_status != 200 && ota_status != 206){
+                ota_fail(ota_current_file == OTA_VERSION_FILE ? "Failed to check update version" : "Update failed");
+                return;
+            }
+
+            // a server that sends chunked anyway would have the chunk sizes written into the image
+            if (ota_chunked){
+                ota_fail("Update server sent a chunked response");
+                return;
+            }
+
+            ota_current_state = OTA_BODY;
+            if (ota_current_file != OTA_FIRMWARE_FILE) return;
+
+            // a range starting after what we have would leave a gap in the image
+            if (ota_status == 206 && ota_range_start > ota_offset){
+                ota_fail("Update server sent the wrong range");
+                return;
+            }
+
+            // the server ignored the range or started it early, throw away what we already have
+            ota_skip = ota_offset - (ota_status == 206 ? ota_range_start : 0);
+
+            // start the update on the first response
+            if (ota_total == 0){
+                ota_total = ota_status == 206 ? ota_range_total : ota_content_length;
+
+                if (ota_total == 0 || !Update.begin(ota_total)){
+                    ota_fail("Not enough space for update");
+                    return;
+                }
+
+                // the updater hashes everything written and checks it at the end
+                Update.setMD5(ota_md5);
+            }
+
+            return;
+        }
+
+        ota_header(ota_line);
+    }
+
+    if (!ota_client.connected() || millis() - ota_last_data_ms >= OTA_STALL_MS){
+        ota_connection_lost();
+    }
+}
+
+void ota_header(const char* line){
+    // status line
+    if (ota_status == 0){
+        const char* code = strchr(line, ' ');
+        ota_status = code == nullptr ? -1 : atoi(code + 1);
+        return;
+    }
+
+    if (strncasecmp(line, "Content-Length:", 15) == 0){
+        ota_content_length = strtoul(line + 15, nullptr, 10);
+    }
+    else if (strncasecmp(line, "Content-Range:", 14) == 0){
+        // bytes start-end/total
+        const char* start = strstr(line, "bytes ");
+        if (start != nullptr) ota_range_start = strtoul(start + 6, nullptr, 10);
+
+        const char* total = strchr(line, '/');
+        if (total != nullptr) ota_range_total = strtoul(total + 1, nullptr, 10);
+    }
+    else if (strncasecmp(line, "Transfer-Encoding:", 18) == 0){
+        // anything but identity (in practice chunked) can't be read as the plain body
+        const char* encoding = line + 18;
+        while (*encoding == ' ') encoding++;
+        ota_chunked = strncasecmp(encoding, "identity", 8) != 0;
+    }
+}
+
+void ota_read_body(){
+    if (ota_current_file == OTA_FIRMWARE_FILE){
+        ota_read_firmware();
+        return;
+    }
+
+    // the version and hash files are small, keep them whole
+    while (ota_client.available()){
+        char c = ota_client.read();
+        ota_last_data_ms = millis();
+
+        if (ota_text_length < sizeof(ota_text) - 1) ota_text[ota_text_length++] = c;
+    }
+
+    bool complete = ota_content_length > 0 && ota_text_length >= min<uint32_t>(ota_content_length, sizeof(ota_text) - 1);
+
+    if (complete || (!ota_client.connected() && !ota_client.available())){
+        ota_text[ota_text_length] = '\0';
+        ota_client.stop();
+        ota_finish_file();
+    }
+    else if (millis() - ota_last_data_ms >= OTA_STALL_MS){
+        ota_connection_lost();
+    }
+}
+
+void ota_read_firmware(){
+    static uint8_t buffer[OTA_CHUNK_SIZE];
+
+    // one chunk per loop so commands keep being handled
+    int available = ota_client.available();
+    if (available > 0){
+        uint32_t wanted = min<uint32_t>(available, sizeof(buffer));
+        if (ota_skip > 0) wanted = min<uint32_t>(wanted, ota_skip);
+
+        int received = ota_client.read(buffer, wanted);
+        if (received <= 0) return;
+        ota_last_data_ms = millis();
+
+        if (ota_skip > 0){
+            ota_skip -= received;
+            return;
+        }
+
+        if (Update.write(buffer, received) != (size_t)received){
+            ota_fail("Update failed");
+            return;
+        }
+
+        ota_offset += received;
+        ota_retries = 0;
+        ota_send_progress();
+
+        if (ota_offset >= ota_total){
+            ota_client.stop();
+            ota_finish_file();
+        }
+
+        return;
+    }
+
+    if (!ota_client.connected() || millis() - ota_last_data_ms >= OTA_STALL_MS){
+        ota_connection_lost();
+    }
+}
+
+void ota_finish_file(){
+    switch (ota_current_file){
+        case OTA_VERSION_FILE: {
+            // trim the whitespace
+            char* version = ota_text;
+            while (*version == ' ' || *version == '\n' || *version == '\r') version++;
+            for (int i = strlen(version) - 1; i >= 0 && (version[i] == ' ' || version[i] == '\n' || version[i] == '\r'); i--){
+                version[i] = '\0';
+            }
+
+            // match it to the saved version
+            if (strcmp(version, CURRENT_VERSION) == 0){
+                BEC_E::send_log("Firmware is up-to-date");
+                ota_current_state = OTA_IDLE;
+                return;
+            }
+
+            BEC_E::send_log("New version available! Starting OTA");
+            ota_current_file = OTA_HASH_FILE;
+            ota_current_state = OTA_REQUEST;
+        }
+        break;
+        case OTA_HASH_FILE:
+            if (ota_text_length < 32){
+                ota_fail("Update hash missing");
+                return;
+            }
+
+            memcpy(ota_md5, ota_text, 32);
+            ota_md5[32] = '\0';
+
+            ota_offset = 0;
+            ota_total = 0;
+            ota_last_progress = 0;
+            ota_current_file = OTA_FIRMWARE_FILE;
+            ota_current_state = OTA_REQUEST;
+        break;
+        case OTA_FIRMWARE_FILE:
+            // checks the size and the hash
+            if (!Update.end()){
+                BEC_E::send_log("Update failed");
+                BEC_E::send_log(Update.getErrorString().c_str());
+                ota_current_state = OTA_IDLE;
+                return;
+            }
+
+            BEC_E::send_log("Update successful. Rebooting");
+            ota_wait_start_ms = millis();
+            ota_current_state = OTA_RESTART;
+        break;
+    }
+}
+
+void ota_connection_lost(){
+    ota_client.stop();
+
+    if (++ota_retries > OTA_MAX_RETRIES){
+        ota_fail("Update failed, server unreachable");
+        return;
+    }
+
+    // the firmware carries on from ota_offset
+    DBG_PRINTF("OTA connection lost at %u, retrying\n", ota_offset);
+    ota_wait_start_ms = millis();
+    ota_current_state = OTA_RETRY;
+}
+
+void ota_fail(const char* message){
+    ota_client.stop();
+
+    // throw away a partly written update. Ending without forcing it never marks it for boot
+    if (ota_current_file == OTA_FIRMWARE_FILE && ota_total > 0){
+        Update.end();
+    }
+
+    BEC_E::send_log(message);
+    ota_total = 0;
+    ota_offset = 0;
+    ota_current_state = OTA_IDLE;
+}
+
+void ota_send_progress(){
+    uint8_t percent = (uint64_t)ota_offset * 100 / ota_total;
+    if (percent < ota_last_progress + OTA_PROGRESS_STEP && ota_offset < ota_total) return;
+    ota_last_progress = percent;
+
+    // build the buffer with the bytes written and the total
+    uint8_t buffer[2 * (1 + sizeof(uint32_t))];
+    buffer[0] = Argument::UINT32;
+    memcpy(buffer + 1, &ota_offset, sizeof(uint32_t));
+    buffer[1 + sizeof(uint32_t)] = Argument::UINT32;
+    memcpy(buffer + 2 + sizeof(uint32_t), &ota_total, sizeof(uint32_t));
+
+    PacketHeader header = BEC_E::build_packet_header(OTA_PROGRESS, 0, 1, sizeof(buffer), 2);
+    BEC_E::send_TCP(header, buffer, SEND_DROP);
+}
@@ -0,0 +1,53 @@
+#pragma once
+
+#include "BEC_E_Device.h"
+
+#ifndef OTA_HTTP_PORT
+#define OTA_HTTP_PORT 80
+#endif
+
+// bytes of firmware written per loop
+#ifndef OTA_CHUNK_SIZE
+#define OTA_CHUNK_SIZE 512
+#endif
+
+// how long the download can go without data before the connection is dropped and resumed
+#ifndef OTA_STALL_MS
+#define OTA_STALL_MS 5000
+#endif
+
+#ifndef OTA_RETRY_MS
+#define OTA_RETRY_MS 2000
+#endif
+
+#ifndef OTA_MAX_RETRIES
+#define OTA_MAX_RETRIES 10
+#endif
+
+// send progress every time another this many percent is written
+#ifndef OTA_PROGRESS_STEP
+#define OTA_PROGRESS_STEP 10
+#endif
+
+// the states of the update
+enum ota_state : uint8_t {
+    OTA_IDLE    = 0, // no update running
+    OTA_REQUEST = 1, // connecting and sending the request
+    OTA_HEADERS = 2, // reading the response headers
+    OTA_BODY    = 3, // reading the file
+    OTA_RETRY   = 4, // waiting to resume after the connection dropped
+    OTA_RESTART = 5, // update written, waiting to restart
+};
+
+// the files fetched during an update, in order
+enum ota_file : uint8_t {
+    OTA_VERSION_FILE  = 0, // the version on the server
+    OTA_HASH_FILE     = 1, // md5 of the firmware
+    OTA_FIRMWARE_FILE = 2, // the firmware itself
+};
+
+extern ota_state ota_current_state;
+
+// function prototypes for internal functions
+void ota_start();
+void ota_tick();
@@ -0,0 +1,41 @@
+#include "Offline.h"
+
+#include <Arduino.h>
+
+#include "debug.h"
+#include "BEC_E_Device.h"
+#include "Network/Network.h"
+#include "Connection/Connection.h"
+
+unsigned long last_replay_ms;
+
+void offline_begin(){
+    if (!offline_open()){
+        DBG_PRINTLN("offline log overlaps the config sectors, not storing packets");
+        return;
+    }
+
+    DBG_PRINTLN(offline_pending() ? "offline log has packets to replay" : "offline log empty");
+}
+
+void offline_replay_tick(){
+    if (!offline_pending() || millis() - last_replay_ms < OFFLINE_REPLAY_INTERVAL_MS) return;
+
+    OfflineRecord record;
+    if (!offline_next(record)) return;
+
+    // read in the frame
+    uint8_t* frame = new uint8_t[record.length];
+    bool valid = offline_read(record, frame);
+
+    // send it, dropping it if it got corrupted
+    bool sent = valid && connection_send(frame, record.length, SEND_DROP);
+    delete[] frame;
+
+    if (valid && !sent) return;
+
+    if (!valid) DBG_PRINTLN("offline record corrupted");
+
+    offline_pop(record);
+    last_replay_ms = millis();
+}
@@ -0,0 +1,56 @@
+#pragma once
+
+#include <stdint.h>
+
+#include "Flash/Flash.h"
+
+// keep SEND_PERSIST packets in flash while the server is down
+#ifndef USE_OFFLINE_STORE
+#define USE_OFFLINE_STORE false
+#endif
+
+// sectors at the start of the flash partition used for the log
+#ifndef OFFLINE_SECTOR_COUNT
+#define OFFLINE_SECTOR_COUNT 16
+#endif
+
+// minimum time between replayed packets so live traffic still gets through
+#ifndef OFFLINE_REPLAY_INTERVAL_MS
+#define OFFLINE_REPLAY_INTERVAL_MS 20
+#endif
+
+#ifndef OFFLINE_MAX_FRAME
+#define OFFLINE_MAX_FRAME 1024
+#endif
+
+#define OFFLINE_SECTOR_MAGIC 0xBECE0F10
+
+// record states. Flash bits can only be cleared so each state clears more of them
+#define OFFLINE_RECORD_ERASED    0xFFFFFFFF // never finished writing
+#define OFFLINE_RECORD_WRITTEN   0xFFFF0000 // waiting to be sent
+#define OFFLINE_RECORD_SENT      0x00000000 // replayed
+
+// written at the start of every sector in the log
+struct OfflineSector {
+    uint32_t magic;     // OFFLINE_SECTOR_MAGIC once the sector has been started
+    uint32_t sequence;  // incremented for every sector started, the highest is the one being written
+};
+
+// written in front of every frame in the log. Records are 4 byte aligned
+struct OfflineRecord {
+    uint16_t length;    // length of the frame. 0xFFFF marks the end of the sector
+    uint16_t crc;       // crc of the frame
+    uint32_t state;     // one of the OFFLINE_RECORD states
+};
+
+// function prototypes for internal functions
+void offline_begin();
+bool offline_append(const uint8_t* frame, uint16_t length);
+bool offline_pending();
+void offline_replay_tick();
+
+// the log itself, in OfflineLog.cpp. It only goes through the flash backend so the host tools can run it on a file
+bool offline_open();
+bool offline_next(OfflineRecord& record);
+bool offline_read(const OfflineRecord& record, uint8_t* frame);
+void offline_pop(const OfflineRecord& record);
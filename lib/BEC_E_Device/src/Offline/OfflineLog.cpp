@@ -0,0 +1,186 @@
+#include "Offline.h"
+
+#include <stddef.h>
+
+#include "Config/Config.h"
+#include "Packet/Wire.h"
+
+static_assert(OFFLINE_SECTOR_COUNT >= 2, "the offline log needs at least 2 sectors");
+
+// where the next record is appended
+uint8_t tail_sector;
+uint16_t tail_offset;
+uint32_t tail_sequence;
+
+// the next record to look at for replay
+uint8_t head_sector;
+uint16_t head_offset;
+
+// false when the log doesn't fit in the partition, nothing is stored then
+bool offline_ready = false;
+
+uint32_t sector_address(uint8_t sector);
+uint16_t record_size(uint16_t length);
+bool read_record(uint8_t sector, uint16_t offset, OfflineRecord& record);
+void set_record_state(uint8_t sector, uint16_t offset, uint32_t state);
+bool start_next_sector();
+
+bool offline_open(){
+    // the log is at the start of the partition and the config at the end, they must not meet
+    offline_ready = (uint32_t)(OFFLINE_SECTOR_COUNT + CONFIG_SECTOR_COUNT) * FLASH_SECTOR_SIZE <= flash.size;
+    if (!offline_ready) return false;
+
+    // find the oldest and newest sectors
+    int oldest = -1;
+    int newest = -1;
+    uint32_t oldest_sequence = 0;
+    uint32_t newest_sequence = 0;
+
+    for (uint8_t i = 0; i < OFFLINE_SECTOR_COUNT; i++){
+        OfflineSector header;
+        if (!flash.read(sector_address(i), (uint8_t*)&header, sizeof(header))) continue;
+        if (header.magic != OFFLINE_SECTOR_MAGIC) continue;
+
+        if (oldest == -1 || header.sequence < oldest_sequence){
+            oldest = i;
+            oldest_sequence = header.sequence;
+        }
+
+        if (newest == -1 || header.sequence > newest_sequence){
+            newest = i;
+            newest_sequence = header.sequence;
+        }
+    }
+
+    // nothing stored yet. Park at the end so the first append starts sector 0
+    if (newest == -1){
+        tail_sector = OFFLINE_SECTOR_COUNT - 1;
+        tail_offset = FLASH_SECTOR_SIZE;
+        tail_sequence = 0;
+        head_sector = tail_sector;
+        head_offset = tail_offset;
+        return true;
+    }
+
+    // find the end of the newest sector
+    OfflineRecord record;
+    tail_sector = newest;
+    tail_sequence = newest_sequence;
+    tail_offset = sizeof(OfflineSector);
+    while (read_record(tail_sector, tail_offset, record)){
+        tail_offset += record_size(record.length);
+    }
+
+    // walk from the oldest sector to find the first record that still has to be sent
+    head_sector = oldest;
+    head_offset = sizeof(OfflineSector);
+    for (;;){
+        if (!read_record(head_sector, head_offset, record)){
+            if (head_sector == tail_sector) break;
+
+            head_sector = (head_sector + 1) % OFFLINE_SECTOR_COUNT;
+            head_offset = sizeof(OfflineSector);
+            continue;
+        }
+
+        if (record.state == OFFLINE_RECORD_WRITTEN) break;
+
+        head_offset += record_size(record.length);
+    }
+
+    return true;
+}
+
+bool offline_append(const uint8_t* frame, uint16_t length){
+    if (!offline_ready || length > OFFLINE_MAX_FRAME) return false;
+
+    // move on to the next sector if this one is full
+    if (tail_offset + record_size(length) > FLASH_SECTOR_SIZE && !start_next_sector()){
+        return false;
+    }
+
+    uint32_t address = sector_address(tail_sector) + tail_offset;
+    OfflineRecord record = {length, calculate_crc16(frame, length), OFFLINE_RECORD_ERASED};
+
+    // write the record, then mark it written so a power cut part way through leaves it ignored
+    if (!flash.write(address, (const uint8_t*)&record, sizeof(record))) return false;
+    if (!flash.write(address + sizeof(record), frame, length)) return false;
+    set_record_state(tail_sector, tail_offset, OFFLINE_RECORD_WRITTEN);
+
+    tail_offset += record_size(length);
+
+    return true;
+}
+
+bool offline_pending(){
+    return offline_ready && (head_sector != tail_sector || head_offset < tail_offset);
+}
+
+bool offline_next(OfflineRecord& record){
+    while (offline_pending()){
+        // move on to the next sector when we reach the end of this one
+        if (!read_record(head_sector, head_offset, record)){
+            head_sector = (head_sector + 1) % OFFLINE_SECTOR_COUNT;
+            head_offset = sizeof(OfflineSector);
+            continue;
+        }
+
+        if (record.state == OFFLINE_RECORD_WRITTEN) return true;
+
+        // skip records that were already sent or never finished
+        head_offset += record_size(record.length);
+    }
+
+    return false;
+}
+
+bool offline_read(const OfflineRecord& record, uint8_t* frame){
+    return flash.read(sector_address(head_sector) + head_offset + sizeof(record), frame, record.length)
+        && calculate_crc16(frame, record.length) == record.crc;
+}
+
+void offline_pop(const OfflineRecord& record){
+    set_record_state(head_sector, head_offset, OFFLINE_RECORD_SENT);
+    head_offset += record_size(record.length);
+}
+
+uint32_t sector_address(uint8_t sector){
+    return (uint32_t)sector * FLASH_SECTOR_SIZE;
+}
+
+uint16_t record_size(uint16_t length){
+    return sizeof(OfflineRecord) + ((length + 3) & ~3);
+}
+
+bool read_record(uint8_t sector, uint16_t offset, OfflineRecord& record){
+    if (offset + sizeof(OfflineRecord) > FLASH_SECTOR_SIZE) return false;
+    if (!flash.read(sector_address(sector) + offset, (uint8_t*)&record, sizeof(record))) return false;
+
+    // erased space or a length that can't fit means the end of the sector
+    return record.length != 0xFFFF && offset + record_size(record.length) <= FLASH_SECTOR_SIZE;
+}
+
+void set_record_state(uint8_t sector, uint16_t offset, uint32_t state){
+    flash.write(sector_address(sector) + offset + offsetof(OfflineRecord, state), (const uint8_t*)&state, sizeof(state));
+}
+
+bool start_next_sector(){
+    uint8_t next = (tail_sector + 1) % OFFLINE_SECTOR_COUNT;
+
+    // the log is full, drop the oldest sector
+    if (head_sector == next){
+        head_sector = (next + 1) % OFFLINE_SECTOR_COUNT;
+        head_offset = sizeof(OfflineSector);
+    }
+
+    if (!flash.erase_sector(sector_address(next))) return false;
+
+    OfflineSector header = {OFFLINE_SECTOR_MAGIC, tail_sequence + 1};
+    if (!flash.write(sector_address(next), (const uint8_t*)&header, sizeof(header))) return false;
+
+    tail_sector = next;
+    tail_offset = sizeof(OfflineSector);
+    tail_sequence ++;
+
+    return true;
+}
@@ -16,6 +16,6 @@ void handle_bad_packet(PacketHeader header){
     // build the header
     PacketHeader resend_header = BEC_E::build_packet_header(RESEND, 0, 1, sizeof(buffer), 1);
 
-    // request the server to resend the packet
-    BEC_E::send_TCP(resend_header, buffer);
+    // request the server to resend the packet. No point queueing it, the server won't have it after a reconnect
+    BEC_E::send_TCP(resend_header, buffer, SEND_DROP);
 }
\ No newline at end of file
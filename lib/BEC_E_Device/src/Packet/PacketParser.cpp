@@ -0,0 +1,56 @@
+#include "PacketParser.h"
+
+#include <string.h>
+
+void parser_reset(PacketParser& parser){
+    parser.received = 0;
+    parser.length = 0;
+    parser.state = PARSER_RECEIVING;
+}
+
+uint8_t* parser_next(PacketParser& parser, uint16_t* wanted){
+    if (parser.state != PARSER_RECEIVING) parser_reset(parser);
+
+    // the header first, nothing past it can be known before then
+    if (parser.length == 0){
+        *wanted = sizeof(PacketHeader) - parser.received;
+        return parser.buffer + parser.received;
+    }
+
+    // a packet that doesn't fit is read over the same bytes after the header until it is gone
+    if (parser.length > parser.size){
+        uint16_t space = parser.size - sizeof(PacketHeader);
+        uint32_t left = parser.length - parser.received;
+        *wanted = left < space ? left : space;
+        return parser.buffer + sizeof(PacketHeader);
+    }
+
+    *wanted = parser.length - parser.received;
+    return parser.buffer + parser.received;
+}
+
+parser_state parser_received(PacketParser& parser, uint16_t count){
+    parser.received += count;
+
+    if (parser.length == 0){
+        if (parser.received < sizeof(PacketHeader)) return parser.state;
+
+        PacketHeader header;
+        memcpy(&header, parser.buffer, sizeof(header));
+
+        // lost our place in the stream. Move along a byte at a time until a header lines up again
+        if (header.magic != MAGIC || header.payload_len < sizeof(uint16_t)){
+            memmove(parser.buffer, parser.buffer + 1, sizeof(PacketHeader) - 1);
+            parser.received --;
+            return parser.state;
+        }
+
+        // the payload the server sends counts the crc
+        parser.length = (uint32_t)sizeof(PacketHeader) + header.payload_len;
+    }
+
+    if (parser.received < parser.length) return parser.state;
+
+    parser.state = parser.length > parser.size ? PARSER_TOO_LARGE : PARSER_READY;
+    return parser.state;
+}
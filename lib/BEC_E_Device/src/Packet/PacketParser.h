@@ -0,0 +1,27 @@
+#pragma once
+
+#include <stdint.h>
+
+#include "BEC_E_Device.h"
+
+// what the parser has after the last bytes were added
+enum parser_state : uint8_t {
+    PARSER_RECEIVING = 0, // waiting for more of the packet
+    PARSER_READY     = 1, // a whole packet is in the buffer
+    PARSER_TOO_LARGE = 2, // a packet bigger than the buffer was skipped, only its header is in the buffer
+};
+
+// builds packets from the stream as bytes arrive, so nothing waits for the rest of a packet.
+// Bytes are read straight into the buffer, parser_next says where and how many
+struct PacketParser {
+    uint8_t* buffer;     // holds the packet being built, header first
+    uint16_t size;       // must be more than a header
+    uint32_t received;   // bytes of the packet so far
+    uint32_t length;     // length of the packet with its crc, 0 until the header is in
+    parser_state state;
+};
+
+// function prototypes for internal functions
+void parser_reset(PacketParser& parser);
+uint8_t* parser_next(PacketParser& parser, uint16_t* wanted);
+parser_state parser_received(PacketParser& parser, uint16_t count);
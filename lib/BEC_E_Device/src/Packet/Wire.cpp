@@ -0,0 +1,163 @@
+#include "Wire.h"
+
+#include <string.h>
+
+#include "Areana/Arena.h"
+
+uint16_t calculate_crc16(const uint8_t* data, size_t length) {
+    uint16_t crc = 0xFFFF;
+    for (size_t i = 0; i < length; i++) {
+        crc ^= (uint16_t)data[i] << 8;
+        for (uint8_t j = 0; j < 8; j++) {
+            if (crc & 0x8000)
+                crc = (crc << 1) ^ 0x1021;
+            else
+                crc <<= 1;
+        }
+    }
+    return crc;
+}
+
+bool validate_crc(uint8_t* buffer, PacketHeader header){
+    uint16_t total_len = sizeof(PacketHeader) + header.payload_len;
+
+    // get the crc at the end of the packet
+    uint16_t crc_received;
+    memcpy(&crc_received, buffer + total_len - 2, sizeof(crc_received));
+
+    // calculate the crc of the packet
+    uint16_t crc_computed = calculate_crc16(buffer, total_len - 2);
+
+    return crc_received == crc_computed;
+}
+
+bool validate_datagram(const uint8_t* buffer, int length){
+    if (length < (int)(sizeof(PacketHeader) + sizeof(uint16_t))) return false;
+
+    PacketHeader header;
+    memcpy(&header, buffer, sizeof(header));
+
+    // framed like the packets we send, with the crc after the payload, or like the server's, with the crc
+    // counted in payload_len. Either way it is the last two bytes
+    if (header.magic != MAGIC) return false;
+    if (sizeof(PacketHeader) + header.payload_len + sizeof(uint16_t) != (size_t)length
+        && sizeof(PacketHeader) + header.payload_len != (size_t)length) return false;
+
+    uint16_t crc_received;
+    memcpy(&crc_received, buffer + length - sizeof(crc_received), sizeof(crc_received));
+
+    return crc_received == calculate_crc16(buffer, length - sizeof(crc_received));
+}
+
+uint16_t parse_argument(ArgValue& arg, uint8_t* payload, uint16_t remaining){
+    // returns the bytes used, 0 if the type is unknown or the argument runs past the remaining bytes
+    if (remaining == 0) return 0;
+
+    uint16_t size = argument_size(*payload);
+    if (*payload == Argument::STRING){
+        if (remaining < 1 + sizeof(uint16_t)) return 0;
+
+        uint16_t str_len;
+        memcpy(&str_len, payload + 1, sizeof(str_len));
+        size = sizeof(uint16_t) + str_len;
+    }
+    else if (size == 0){
+        BEC_E::send_log("argument type not defined");
+        return 0;
+    }
+
+    if (1 + (uint32_t)size > remaining){
+        BEC_E::send_log("argument past the end of the packet");
+        return 0;
+    }
+
+    switch (*payload){
+        case Argument::BOOL:
+            arg.bool_val = *(bool*)(payload + 1);
+            return 1 + sizeof(bool);
+        case Argument::INT8:
+            arg.int8_val = *(int8_t*)(payload + 1);
+            return 1 + sizeof(int8_t);
+        case Argument::INT16:
+            arg.int16_val = *(int16_t*)(payload + 1);
+            return 1 + sizeof(int16_t);
+        case Argument::INT32:
+            arg.int32_val = *(int32_t*)(payload + 1);
+            return 1 + sizeof(int32_t);
+        case Argument::UINT8:
+            arg.uint8_val = *(uint8_t*)(payload + 1);
+            return 1 + sizeof(uint8_t);
+        case Argument::UINT16:
+            arg.uint16_val = *(uint16_t*)(payload + 1);
+            return 1 + sizeof(uint16_t);
+        case Argument::UINT32:
+            arg.uint32_val = *(uint32_t*)(payload + 1);
+            return 1 + sizeof(uint32_t);
+        case Argument::FLOAT:
+            arg.float_val = *(float*)(payload + 1);
+            return 1 + sizeof(float);
+        case Argument::COLOR:
+            arg.color_val = *(Color*)(payload + 1);
+            return 1 + sizeof(Color);
+        case Argument::STRING: {
+            uint16_t str_len = *(uint16_t*)(payload + 1);
+            
+            // Allocate from arena with room for null terminator
+            char* str = (char*)arena_malloc(str_len + 1);
+            if (!str) {
+                BEC_E::send_log("Arena out of memory for string");
+                arg.str_val = nullptr;
+                return 1 + 2 + str_len; // still advance payload pointer to avoid stuck parsing
+            }
+            
+            // copy the string over
+            memcpy(str, payload + 3, str_len);
+            str[str_len] = '\0';
+            
+            // add the string to the argument
+            arg.str_val = str;
+            
+            return 1 + 2 + str_len;
+        }
+        default:
+            return 0;
+    }
+}
+
+uint8_t argument_size(uint8_t type){
+    switch (type){
+        case Argument::BOOL:   return sizeof(bool);
+        case Argument::INT8:   return sizeof(int8_t);
+        case Argument::INT16:  return sizeof(int16_t);
+        case Argument::INT32:  return sizeof(int32_t);
+        case Argument::UINT8:  return sizeof(uint8_t);
+        case Argument::UINT16: return sizeof(uint16_t);
+        case Argument::UINT32: return sizeof(uint32_t);
+        case Argument::FLOAT:  return sizeof(float);
+        case Argument::COLOR:  return sizeof(Color);
+        default:               return 0;
+    }
+}
+
+uint16_t write_argument(uint8_t* buffer, uint16_t size, uint8_t type, const ArgValue& arg){
+    // the reverse of parse_argument. Returns the bytes written, 0 if it doesn't fit
+    if (type == Argument::STRING){
+        uint16_t str_len = arg.str_val == nullptr ? 0 : strlen(arg.str_val);
+        if (1 + sizeof(uint16_t) + str_len > size) return 0;
+
+        buffer[0] = type;
+        memcpy(buffer + 1, &str_len, sizeof(uint16_t));
+        memcpy(buffer + 1 + sizeof(uint16_t), arg.str_val, str_len);
+
+        return 1 + sizeof(uint16_t) + str_len;
+    }
+
+    uint8_t arg_size = argument_size(type);
+    if (arg_size == 0 || 1 + arg_size > size) return 0;
+
+    // the values all start at the beginning of the union
+    buffer[0] = type;
+    memcpy(buffer + 1, &arg, arg_size);
+
+    return 1 + arg_size;
+}
@@ -0,0 +1,17 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "BEC_E_Device.h"
+
+// the bytes of a packet on the wire: the crc and the typed arguments. Nothing here needs the arduino core,
+// so the host tools build the same code
+
+// function prototypes for internal functions
+uint16_t calculate_crc16(const uint8_t* data, size_t length);
+bool validate_crc(uint8_t* buffer, PacketHeader header);
+bool validate_datagram(const uint8_t* buffer, int length);
+uint16_t parse_argument(ArgValue& arg, uint8_t* payload, uint16_t remaining);
+uint8_t argument_size(uint8_t type);
+uint16_t write_argument(uint8_t* buffer, uint16_t size, uint8_t type, const ArgValue& arg);
@@ -0,0 +1,166 @@
+#include <ESP8266WiFi.h>
+#include <ESP8266WebServer.h>
+
+#include "Portal.h"
+
+#include "debug.h"
+#include "portal_pages.h"
+#include "Network/Network.h"
+#include "Config/Config.h"
+
+bool portal_active;
+
+ESP8266WebServer server(80);
+
+// when to restart after new settings were saved, 0 if not saved yet
+unsigned long restart_at_ms;
+unsigned long last_wifi_retry_ms;
+
+void handle_root();
+void handle_config();
+void handle_submit();
+void send_page(const uint8_t* page, size_t length);
+size_t append_json_field(char* json, size_t offset, size_t size, const char* name, const char* value, int max_length);
+
+void portal_start(){
+    if (portal_active) return;
+
+    DBG_PRINTLN("running AP with name " DEVICE_NAME "_" DEVICE_ID ". Go to 192.168.0.1 to set up device");
+
+    const IPAddress local_ip(192, 168, 0, 1);     // ESP's own IP
+    const IPAddress gateway(192, 168, 0, 1);      // Gateway (same as IP for SoftAP)
+    const IPAddress subnet(255, 255, 255, 0);     // Subnet mask
+
+    // keep the station side up so the saved network can still be retried
+    WiFi.mode(WIFI_AP_STA);
+    WiFi.softAPConfig(local_ip, gateway, subnet);
+    WiFi.softAP(DEVICE_NAME "_" DEVICE_ID);
+
+    server.on("/", handle_root);
+    server.on("/config", handle_config);
+    server.on("/submit", handle_submit);
+    server.begin();
+
+    portal_active = true;
+    last_wifi_retry_ms = millis();
+}
+
+void portal_tick(){
+    if (!portal_active) return;
+
+    server.handleClient();
+
+    // give the browser time to receive the page before restarting
+    if (restart_at_ms != 0 && (long)(millis() - restart_at_ms) >= 0){
+        ESP.restart();
+    }
+
+    // keep trying the saved network in the background
+    if (ssid[0] != '\0' && WiFi.status() != WL_CONNECTED && millis() - last_wifi_retry_ms >= PORTAL_WIFI_RETRY_MS){
+        DBG_PRINTLN("retrying the saved network");
+        WiFi.begin(ssid, password);
+        last_wifi_retry_ms = millis();
+    }
+}
+
+void portal_stop(){
+    if (!portal_active || restart_at_ms != 0) return;
+
+    DBG_PRINTLN("stopping the AP");
+    server.stop();
+    WiFi.softAPdisconnect(true);
+    WiFi.mode(WIFI_STA);
+
+    portal_active = false;
+}
+
+void handle_root() {
+    send_page(index_html_gz, sizeof(index_html_gz));
+}
+
+void handle_config() {
+    // the saved values, filled into the page by its script
+    char json[3 * 32 + 6 * (SSID_SIZE + WIFI_PASSWORD_SIZE + SERVER_IP_SIZE)];
+    size_t offset = 0;
+
+    json[offset++] = '{';
+    offset = append_json_field(json, offset, sizeof(json), "ssid", ssid, SSID_SIZE - 1);
+    json[offset++] = ',';
+    offset = append_json_field(json, offset, sizeof(json), "pass", password, WIFI_PASSWORD_SIZE - 1);
+    json[offset++] = ',';
+    offset = append_json_field(json, offset, sizeof(json), "server_ip", server_ip, SERVER_IP_SIZE - 1);
+    json[offset++] = '}';
+    json[offset] = '\0';
+
+    server.send(200, "application/json", json);
+}
+
+void handle_submit() {
+    char ssid[SSID_SIZE];
+    char pass[WIFI_PASSWORD_SIZE];
+    char ip[SERVER_IP_SIZE];
+
+    // --- Copy SSID ---
+    if (server.hasArg("ssid")) {
+        strncpy(ssid, server.arg("ssid").c_str(), SSID_SIZE);
+        ssid[SSID_SIZE - 1] = '\0';
+    } else {
+        ssid[0] = '\0';
+    }
+
+    // --- Copy password ---
+    if (server.hasArg("pass")) {
+        strncpy(pass, server.arg("pass").c_str(), WIFI_PASSWORD_SIZE);
+        pass[WIFI_PASSWORD_SIZE - 1] = '\0';
+    } else {
+        pass[0] = '\0';
+    }
+
+    // --- Copy server IP ---
+    if (server.hasArg("server_ip")) {
+        strncpy(ip, server.arg("server_ip").c_str(), SERVER_IP_SIZE);
+        ip[SERVER_IP_SIZE - 1] = '\0';
+    } else {
+        ip[0] = '\0';
+    }
+
+    // --- Save credentials ---
+    save_credentials(ssid, pass, ip);
+
+    // --- Send response ---
+    send_page(saved_html_gz, sizeof(saved_html_gz));
+
+    // restart from portal_tick once the browser has had time to receive the page
+    restart_at_ms = millis() + PORTAL_RESTART_DELAY_MS;
+    if (restart_at_ms == 0) restart_at_ms = 1;
+}
+
+void send_page(const uint8_t* page, size_t length){
+    // the pages are stored compressed, the browser unpacks them
+    server.sendHeader(F("Content-Encoding"), F("gzip"));
+    server.send_P(200, PSTR("text/html"), (PGM_P)page, length);
+}
+
+size_t append_json_field(char* json, size_t offset, size_t size, const char* name, const char* value, int max_length){
+    offset += snprintf(json + offset, size - offset, "\"%s\":{\"value\":\"", name);
+
+    // escape the value. The buffer is sized for every character needing the long form
+    for (int i = 0; i < max_length && value[i] != '\0'; i++){
+        char c = value[i];
+
+        if (c == '"' || c == '\\'){
+            json[offset++] = '\\';
+            json[offset++] = c;
+        }
+        else if ((uint8_t)c < 0x20){
+            offset += snprintf(json + offset, size - offset, "\\u%04x", c);
+        }
+        else {
+            json[offset++] = c;
+        }
+    }
+
+    offset += snprintf(json + offset, size - offset, "\",\"max\":%d}", max_length);
+
+    return offset;
+}
@@ -0,0 +1,20 @@
+#pragma once
+
+#include "BEC_E_Device.h"
+
+// how often the saved network is retried while the portal is up
+#ifndef PORTAL_WIFI_RETRY_MS
+#define PORTAL_WIFI_RETRY_MS 30000
+#endif
+
+// time the browser gets to load the saved page before the restart
+#ifndef PORTAL_RESTART_DELAY_MS
+#define PORTAL_RESTART_DELAY_MS 1500
+#endif
+
+extern bool portal_active;
+
+// function prototypes for internal functions
+void portal_start();
+void portal_tick();
+void portal_stop();
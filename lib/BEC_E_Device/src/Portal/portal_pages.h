@@ -0,0 +1,70 @@
+#pragma once
+// generated by portal/build_pages.py from the pages in portal/. Don't edit by hand
+#include <Arduino.h>
+
+// index.html
+const uint8_t index_html_gz[] PROGMEM = {
+    0x1f, 0x8b, 0x08, 0x00, 0x00, 0x00, 0x00, 0x00, 0x02, 0x03, 0x75, 0x53, 0x6d, 0x6b, 0xdb, 0x30,
+    0x10, 0xfe, 0x9e, 0x5f, 0xe1, 0x79, 0x6c, 0xb5, 0x61, 0x8e, 0x9d, 0xb2, 0x6e, 0xc3, 0x6f, 0x1f,
+    0xd6, 0x76, 0x50, 0x18, 0x6b, 0x20, 0x85, 0x31, 0x4a, 0x19, 0xb2, 0x74, 0xb6, 0xb5, 0xc8, 0x92,
+    0x91, 0xe4, 0xa4, 0x9e, 0xc9, 0x7f, 0x9f, 0x64, 0x9b, 0x24, 0x2d, 0x0c, 0x83, 0xd1, 0x9d, 0xee,
+    0xb9, 0x7b, 0xee, 0x9e, 0x53, 0xfa, 0xe6, 0xe6, 0xfe, 0xfa, 0xe1, 0xd7, 0xfa, 0xd6, 0xa9, 0x75,
+    0xc3, 0xf2, 0x74, 0xfe, 0x03, 0x22, 0xf9, 0x22, 0x6d, 0x40, 0x23, 0x87, 0xa3, 0x06, 0x32, 0x77,
+    0x47, 0x61, 0xdf, 0x0a, 0xa9, 0x5d, 0x07, 0x0b, 0xae, 0x81, 0xeb, 0xcc, 0xdd, 0x53, 0xa2, 0xeb,
+    0x8c, 0xc0, 0x8e, 0x62, 0x08, 0x46, 0xe3, 0x83, 0x43, 0x39, 0xd5, 0x14, 0xb1, 0x40, 0x61, 0xc4,
+    0x20, 0x5b, 0xb9, 0x26, 0x89, 0xd2, 0x3d, 0x83, 0x7c, 0x51, 0x08, 0xd2, 0x0f, 0xa5, 0xc1, 0x06,
+    0x25, 0x6a, 0x28, 0xeb, 0x63, 0x85, 0xb8, 0x0a, 0x14, 0x48, 0x5a, 0x26, 0x05, 0xc2, 0xdb, 0x4a,
+    0x8a, 0x8e, 0x93, 0xf8, 0x6d, 0x79, 0x65, 0xbf, 0xa4, 0x41, 0xb2, 0xa2, 0x3c, 0x8e, 0x92, 0x16,
+    0x11, 0x42, 0x79, 0x15, 0x5f, 0x46, 0xed, 0x73, 0x72, 0x58, 0x94, 0x42, 0x36, 0x43, 0x83, 0x9e,
+    0xa7, 0x82, 0xf1, 0xc7, 0xc8, 0xba, 0xe7, 0x60, 0xd4, 0x69, 0xf1, 0x32, 0x57, 0x59, 0xbe, 0xc4,
+    0x17, 0x42, 0x12, 0x90, 0x81, 0x44, 0x84, 0x76, 0x2a, 0xfe, 0x32, 0x66, 0x64, 0xa8, 0x00, 0x36,
+    0x10, 0xaa, 0x5a, 0x86, 0xfa, 0xb8, 0x60, 0x02, 0x6f, 0xe7, 0x84, 0x81, 0x16, 0x6d, 0xbc, 0xba,
+    0x32, 0x51, 0x23, 0xef, 0x3d, 0xd0, 0xaa, 0xd6, 0x71, 0x21, 0x18, 0x31, 0x30, 0xca, 0xdb, 0x4e,
+    0x0f, 0x13, 0x8b, 0x55, 0x14, 0xbd, 0x3b, 0x16, 0x5a, 0x9d, 0x18, 0x8d, 0x09, 0x8e, 0x78, 0x45,
+    0xff, 0x42, 0xbc, 0xfa, 0x34, 0x16, 0x2d, 0x3a, 0xad, 0x05, 0x3f, 0x87, 0x9f, 0x21, 0x46, 0xaa,
+    0xc7, 0x74, 0x97, 0x2f, 0xf1, 0x96, 0xf4, 0x79, 0x8f, 0x51, 0xf4, 0xb9, 0x30, 0x6d, 0x62, 0xc1,
+    0x84, 0x9c, 0x3a, 0x9e, 0x9a, 0x8c, 0xb9, 0xe0, 0xf0, 0xaa, 0xe1, 0xa9, 0x76, 0x1a, 0x4e, 0x92,
+    0xa4, 0xe1, 0x28, 0x73, 0x6a, 0x95, 0x31, 0x3a, 0xd9, 0xc9, 0x3a, 0x08, 0x6b, 0x2a, 0x78, 0xe6,
+    0x86, 0xaa, 0x2b, 0x1a, 0x6a, 0xd4, 0x36, 0x2b, 0x50, 0x0b, 0x92, 0xb9, 0xeb, 0xfb, 0xcd, 0x83,
+    0x55, 0x73, 0x9c, 0x56, 0xfe, 0x93, 0x7e, 0xa3, 0xce, 0x66, 0x73, 0x77, 0x93, 0x86, 0x93, 0x63,
+    0x91, 0x8e, 0xf3, 0x98, 0x97, 0x45, 0x29, 0x4a, 0x4e, 0xc1, 0x6b, 0xa4, 0xd4, 0xde, 0xf0, 0x78,
+    0x1d, 0xab, 0xfb, 0xd6, 0xc4, 0xb6, 0xf3, 0xad, 0x3b, 0x63, 0xad, 0x7d, 0xc2, 0x6e, 0x40, 0xee,
+    0x40, 0x3a, 0x77, 0xeb, 0xff, 0x14, 0x1a, 0xaf, 0x7f, 0xd3, 0xd6, 0x22, 0xa6, 0x99, 0xce, 0x69,
+    0x67, 0xfe, 0xf9, 0x06, 0xed, 0xc0, 0x79, 0xef, 0x5c, 0x0b, 0xce, 0x01, 0xeb, 0x34, 0x9c, 0x82,
+    0x4c, 0x74, 0x68, 0xfb, 0xb5, 0xeb, 0x89, 0x25, 0x6d, 0x75, 0xbe, 0x28, 0x41, 0xe3, 0xda, 0xbb,
+    0x08, 0xcd, 0x7a, 0x97, 0xb4, 0xba, 0xf0, 0x97, 0xba, 0x06, 0xee, 0xc9, 0x2c, 0x97, 0xcb, 0x3f,
+    0x4a, 0x70, 0xcf, 0x9f, 0x3d, 0x38, 0xcb, 0xcd, 0x1a, 0x4b, 0xcf, 0xc4, 0x29, 0xed, 0x6c, 0xcd,
+    0xc6, 0x3b, 0xd8, 0x1f, 0x26, 0x0b, 0x32, 0x22, 0x70, 0xd7, 0x98, 0xd7, 0xb1, 0xac, 0x40, 0xdf,
+    0x32, 0xb0, 0x47, 0xf5, 0xb5, 0xff, 0x61, 0xc8, 0x7a, 0x5b, 0xff, 0x31, 0x7a, 0x4a, 0x68, 0xe9,
+    0x81, 0x3f, 0xc0, 0x72, 0x87, 0x58, 0x07, 0x19, 0x7e, 0xdc, 0x3e, 0x4d, 0xc7, 0x04, 0x96, 0x66,
+    0xab, 0xbf, 0x03, 0xaf, 0xcc, 0x9b, 0x1a, 0xdd, 0xc6, 0x4c, 0x0e, 0x87, 0x83, 0x9f, 0x58, 0xc1,
+    0x66, 0x92, 0x86, 0xbf, 0x15, 0xcb, 0x28, 0x67, 0x9f, 0xe9, 0xe2, 0x1f, 0x68, 0x9e, 0x58, 0x6c,
+    0xbd, 0x03, 0x00, 0x00,
+};
+
+// saved.html
+const uint8_t saved_html_gz[] PROGMEM = {
+    0x1f, 0x8b, 0x08, 0x00, 0x00, 0x00, 0x00, 0x00, 0x02, 0x03, 0x55, 0x51, 0xcb, 0x6e, 0xdb, 0x30,
+    0x10, 0xbc, 0xeb, 0x2b, 0x18, 0xf9, 0x5a, 0xd9, 0x96, 0x5b, 0x17, 0x01, 0xf5, 0xb8, 0xe4, 0x71,
+    0x4d, 0x80, 0x04, 0x08, 0x72, 0x5c, 0x93, 0x2b, 0x6b, 0x61, 0x8a, 0x14, 0xc8, 0xf5, 0xab, 0x46,
+    0xfe, 0xbd, 0xa4, 0x6c, 0x34, 0x28, 0x08, 0x90, 0xe0, 0xec, 0xcc, 0x72, 0x38, 0x5b, 0xdf, 0x3d,
+    0xbe, 0x3c, 0xbc, 0x7f, 0xbe, 0x3e, 0x89, 0x9e, 0x07, 0xd3, 0xd6, 0xb7, 0x1d, 0x41, 0xb7, 0x59,
+    0x3d, 0x20, 0x83, 0xb0, 0x30, 0x60, 0x93, 0x1f, 0x08, 0x8f, 0xa3, 0xf3, 0x9c, 0x0b, 0xe5, 0x2c,
+    0xa3, 0xe5, 0x26, 0x3f, 0x92, 0xe6, 0xbe, 0xd1, 0x78, 0x20, 0x85, 0xc5, 0x74, 0xf9, 0x21, 0xc8,
+    0x12, 0x13, 0x98, 0x22, 0x28, 0x30, 0xd8, 0x94, 0x79, 0x6c, 0x12, 0xf8, 0x6c, 0xb0, 0xcd, 0x36,
+    0x4e, 0x9f, 0x2f, 0x5d, 0xd4, 0x16, 0x1d, 0x0c, 0x64, 0xce, 0x32, 0x80, 0x0d, 0x45, 0x40, 0x4f,
+    0x5d, 0xb5, 0x01, 0xb5, 0xdb, 0x7a, 0xb7, 0xb7, 0x5a, 0xce, 0xba, 0x75, 0x5a, 0xd5, 0x00, 0x7e,
+    0x4b, 0x56, 0x2e, 0xab, 0x11, 0xb4, 0x26, 0xbb, 0x95, 0xab, 0xe5, 0x78, 0xaa, 0x18, 0x4f, 0x5c,
+    0x80, 0xa1, 0xad, 0x95, 0x2a, 0x7a, 0x40, 0x5f, 0x7d, 0x65, 0x73, 0x05, 0x5e, 0x5f, 0x06, 0x38,
+    0x5d, 0x3d, 0xc8, 0x5f, 0xcb, 0xc4, 0xbc, 0xe9, 0x61, 0xcf, 0xee, 0xff, 0xf6, 0x5d, 0xf7, 0xaf,
+    0xe5, 0xcf, 0x44, 0xdc, 0x38, 0xaf, 0xd1, 0x17, 0x1e, 0x34, 0xed, 0x83, 0xbc, 0x8f, 0xc8, 0x57,
+    0xd6, 0x97, 0x97, 0xab, 0xbe, 0x60, 0x37, 0x46, 0x0f, 0x93, 0xed, 0x40, 0x7f, 0x50, 0xae, 0x56,
+    0x13, 0x61, 0xbc, 0x7c, 0x43, 0xe5, 0xef, 0x08, 0x29, 0x67, 0x9c, 0x97, 0xb3, 0xf5, 0x7a, 0x1d,
+    0xab, 0xf5, 0xe2, 0xfa, 0xe7, 0x7a, 0x31, 0xe5, 0x58, 0xa7, 0xaf, 0xc7, 0x20, 0x34, 0x1d, 0x84,
+    0x32, 0x10, 0x42, 0x93, 0x27, 0xcb, 0x29, 0x9b, 0xbe, 0x6c, 0xdf, 0x90, 0x39, 0x9a, 0x09, 0xe2,
+    0x0d, 0x0e, 0xa8, 0xa3, 0xa4, 0x8c, 0xf8, 0xd8, 0xbe, 0xf7, 0x28, 0xae, 0xd1, 0x0a, 0x0a, 0xc2,
+    0x63, 0x60, 0xf0, 0x89, 0x37, 0xaf, 0x17, 0xe3, 0x44, 0x78, 0x35, 0x08, 0x01, 0x63, 0x25, 0xce,
+    0xc3, 0xa2, 0x62, 0xc1, 0x4e, 0x9c, 0xdd, 0xde, 0x0b, 0xeb, 0xfc, 0x00, 0x46, 0x7c, 0x50, 0xf1,
+    0x4c, 0xc2, 0x22, 0x1f, 0x9d, 0xdf, 0xdd, 0x54, 0x8b, 0x68, 0x21, 0x1d, 0x93, 0xa1, 0xf8, 0x54,
+    0x9a, 0x75, 0xf6, 0x17, 0xd2, 0x53, 0x33, 0xda, 0x02, 0x02, 0x00, 0x00,
+};
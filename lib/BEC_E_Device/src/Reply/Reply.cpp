@@ -0,0 +1,133 @@
+#include <Arduino.h>
+
+#include "Reply.h"
+
+#include "debug.h"
+#include "Network/Network.h"
+#include "Commands/Commands.h"
+#include "Local/Local.h"
+
+PendingReply pending_replies[MAX_PENDING_REPLIES];
+uint32_t reply_generation;
+
+// the command being handled right now
+uint32_t current_packet_id;
+ReplyPeer current_peer;
+bool in_command;
+bool current_answered;
+bool current_busy;
+reply_status current_status;
+
+namespace BEC_E {
+    bool reply(reply_status status, const ArgValue* results, const Argument::arg_type* types, uint8_t count){
+        if (!in_command || current_answered) return false;
+
+        current_answered = true;
+        current_status = status;
+        return send_reply(current_peer, current_packet_id, status, results, types, count);
+    }
+
+    uint32_t defer_reply(){
+        if (!in_command || current_answered) return 0;
+
+        for (int i = 0; i < MAX_PENDING_REPLIES; i++){
+            PendingReply& pending = pending_replies[i];
+            if (pending.token != 0) continue;
+
+            // the slot is in the low byte so complete_reply can find it, the rest stops an old token matching
+            reply_generation ++;
+            pending.token = (reply_generation << 8) | (i + 1);
+            pending.packet_id = current_packet_id;
+            pending.peer = current_peer;
+            pending.started_ms = millis();
+
+            current_answered = true;
+            current_status = REPLY_DEFERRED;
+            return pending.token;
+        }
+
+        // reply_end answers REPLY_BUSY
+        current_busy = true;
+        return 0;
+    }
+
+    bool complete_reply(uint32_t token, reply_status status, const ArgValue* results, const Argument::arg_type* types, uint8_t count){
+        uint8_t slot = token & 0xFF;
+        if (slot == 0 || slot > MAX_PENDING_REPLIES) return false;
+
+        PendingReply& pending = pending_replies[slot - 1];
+        if (pending.token != token) return false;
+
+        pending.token = 0;
+        return send_reply(pending.peer, pending.packet_id, status, results, types, count);
+    }
+} // BEC_E namespace
+
+void reply_begin(uint32_t packet_id, ReplyPeer peer){
+    current_packet_id = packet_id;
+    current_peer = peer;
+    in_command = true;
+    current_answered = false;
+    current_busy = false;
+}
+
+reply_status reply_end(bool handled){
+    // every command gets exactly one reply, so the server can match them up without waiting
+    if (!current_answered){
+        // the handler may have wanted to defer but there was no room
+        current_status = !handled ? REPLY_UNKNOWN_COMMAND : current_busy ? REPLY_BUSY : REPLY_OK;
+        send_reply(current_peer, current_packet_id, current_status, nullptr, nullptr, 0);
+    }
+
+    in_command = false;
+
+    return current_status;
+}
+
+bool reply_failed(){
+    // deferred commands are taken to have worked
+    return current_answered && current_status != REPLY_OK && current_status != REPLY_DEFERRED;
+}
+
+bool reply_from_server(){
+    return current_peer.address == 0;
+}
+
+void reply_tick(){
+    for (int i = 0; i < MAX_PENDING_REPLIES; i++){
+        PendingReply& pending = pending_replies[i];
+        if (pending.token == 0 || millis() - pending.started_ms < REPLY_TIMEOUT_MS) continue;
+
+        pending.token = 0;
+        send_reply(pending.peer, pending.packet_id, REPLY_TIMEOUT, nullptr, nullptr, 0);
+    }
+}
+
+bool send_reply(const ReplyPeer& peer, uint32_t packet_id, reply_status status, const ArgValue* results, const Argument::arg_type* types, uint8_t count){
+    // the packet id of the command, the status, then the results
+    ArgValue id, status_value;
+    id.uint32_val = packet_id;
+    status_value.uint8_val = status;
+
+    uint8_t buffer[REPLY_MAX_SIZE];
+    uint16_t length = 0;
+    length += write_argument(buffer + length, sizeof(buffer) - length, Argument::UINT32, id);
+    length += write_argument(buffer + length, sizeof(buffer) - length, Argument::UINT8, status_value);
+
+    for (uint8_t i = 0; i < count; i++){
+        uint16_t written = write_argument(buffer + length, sizeof(buffer) - length, types[i], results[i]);
+        if (written == 0){
+            BEC_E::send_log("Reply too large");
+            return send_reply(peer, packet_id, REPLY_ERROR, nullptr, nullptr, 0);
+        }
+
+        length += written;
+    }
+
+    PacketHeader header = BEC_E::build_packet_header(REPLY, 0, 1, length, 2 + count);
+
+    // local commands are answered straight back to whoever sent them
+    if (peer.address != 0) return local_send(peer, header, buffer);
+
+    return BEC_E::send_TCP(header, buffer);
+}
@@ -0,0 +1,43 @@
+#pragma once
+
+#include "BEC_E_Device.h"
+
+// commands that can be waiting to complete at once
+#ifndef MAX_PENDING_REPLIES
+#define MAX_PENDING_REPLIES 8
+#endif
+
+// a deferred command that hasn't completed after this long is answered with REPLY_TIMEOUT
+#ifndef REPLY_TIMEOUT_MS
+#define REPLY_TIMEOUT_MS 60000
+#endif
+
+// largest reply payload
+#ifndef REPLY_MAX_SIZE
+#define REPLY_MAX_SIZE 256
+#endif
+
+// returned by reply_end for a command that will be answered later
+#define REPLY_DEFERRED ((reply_status)0xFF)
+
+// where a command came from and its reply goes. An address of 0 is the server
+struct ReplyPeer {
+    uint32_t address;
+    uint16_t port;
+};
+
+// a command that returned before it was done
+struct PendingReply {
+    uint32_t token;         // handed to the handler, 0 when the slot is free
+    uint32_t packet_id;     // the packet the command came in
+    ReplyPeer peer;         // who sent it
+    unsigned long started_ms;
+};
+
+// function prototypes for internal functions
+void reply_begin(uint32_t packet_id, ReplyPeer peer);
+reply_status reply_end(bool handled);
+bool reply_failed();
+bool reply_from_server();
+void reply_tick();
+bool send_reply(const ReplyPeer& peer, uint32_t packet_id, reply_status status, const ArgValue* results, const Argument::arg_type* types, uint8_t count);
@@ -0,0 +1,143 @@
+#include <Arduino.h>
+
+#include "Reporting.h"
+
+#include "debug.h"
+#include "Network/Network.h"
+#include "Connection/Connection.h"
+#include "Sampling/Sampling.h"
+#include "Commands/Commands.h"
+
+Subscription subscriptions[MAX_SUBSCRIPTIONS];
+uint8_t subscription_count;
+
+// what was last sent for each subscription
+struct ReportState {
+    const SampleChannel* channel;
+    float last_value;
+    unsigned long last_report_ms;
+    unsigned long last_read_us;
+    bool reported;
+};
+
+ReportState report_states[MAX_SUBSCRIPTIONS];
+
+void reset_report_state(uint8_t index);
+void save_subscriptions();
+void send_report(const SampleChannel& channel, ArgValue value);
+
+void reporting_begin(){
+    int16_t length = config_get(CONFIG_SUBSCRIPTIONS, subscriptions, sizeof(subscriptions));
+    subscription_count = length > 0 ? min<int16_t>(length, sizeof(subscriptions)) / sizeof(Subscription) : 0;
+
+    for (uint8_t i = 0; i < subscription_count; i++){
+        reset_report_state(i);
+    }
+}
+
+void reporting_tick(){
+    // nothing can be sent, and skipping keeps the last report as the reference for when we are back
+    if (tcp_state != CONNECTION_CONNECTED) return;
+
+    unsigned long now_ms = millis();
+    unsigned long now_us = micros();
+
+    for (uint8_t i = 0; i < subscription_count; i++){
+        const Subscription& subscription = subscriptions[i];
+        ReportState& state = report_states[i];
+
+        // the channel might be registered after the subscriptions were loaded
+        if (state.channel == nullptr){
+            state.channel = find_sample_channel(subscription.channel);
+            if (state.channel == nullptr) continue;
+        }
+
+        unsigned long since_report = now_ms - state.last_report_ms;
+        if (state.reported && since_report < subscription.min_interval_ms) continue;
+
+        // don't read the sensor faster than the channel allows
+        if (state.reported && now_us - state.last_read_us < state.channel->period_us) continue;
+        state.last_read_us = now_us;
+
+        ArgValue value = state.channel->read_sample();
+        float current = sample_to_float(*state.channel, value);
+
+        bool changed = fabsf(current - state.last_value) >= subscription.deadband;
+        bool due = subscription.max_interval_ms > 0 && since_report >= subscription.max_interval_ms;
+        if (state.reported && !changed && !due) continue;
+
+        send_report(*state.channel, value);
+
+        state.last_value = current;
+        state.last_report_ms = now_ms;
+        state.reported = true;
+    }
+}
+
+void handle_subscribe(ArgValue args[], uint8_t arg_number){
+    // channel, min interval, max interval, deadband. Both intervals 0 removes the subscription
+    const Argument::arg_type subscription_types[] = {Argument::UINT16, Argument::UINT32, Argument::UINT32, Argument::FLOAT};
+    if (arg_number != 4 || !arguments_match(subscription_types, 4)){
+        BEC_E::reply(REPLY_ERROR);
+        return;
+    }
+
+    Subscription subscription = {args[0].uint16_val, args[1].uint32_val, args[2].uint32_val, args[3].float_val};
+    bool remove = subscription.min_interval_ms == 0 && subscription.max_interval_ms == 0;
+
+    uint8_t index = 0;
+    while (index < subscription_count && subscriptions[index].channel != subscription.channel) index++;
+
+    if (remove){
+        if (index == subscription_count) return;
+
+        // keep the list packed
+        subscription_count --;
+        subscriptions[index] = subscriptions[subscription_count];
+        report_states[index] = report_states[subscription_count];
+    }
+    else {
+        if (index == MAX_SUBSCRIPTIONS){
+            BEC_E::reply(REPLY_ERROR);
+            return;
+        }
+
+        if (index == subscription_count) subscription_count ++;
+        subscriptions[index] = subscription;
+        reset_report_state(index);
+    }
+
+    save_subscriptions();
+}
+
+void reset_report_state(uint8_t index){
+    // the first tick after this always reports
+    report_states[index] = {find_sample_channel(subscriptions[index].channel), 0, 0, 0, false};
+}
+
+void save_subscriptions(){
+    if (subscription_count == 0) config_erase(CONFIG_SUBSCRIPTIONS);
+    else config_set(CONFIG_SUBSCRIPTIONS, subscriptions, subscription_count * sizeof(Subscription));
+
+    config_commit();
+}
+
+void send_report(const SampleChannel& channel, ArgValue value){
+    // the channel, the value as its own type and the server time it was read at
+    int64_t server_us = BEC_E::server_time_us();
+
+    ArgValue channel_id, seconds, microseconds;
+    channel_id.uint16_val = channel.id;
+    seconds.uint32_val = server_us / 1000000;
+    microseconds.uint32_val = server_us % 1000000;
+
+    uint8_t buffer[3 * (1 + sizeof(uint32_t)) + 1 + sizeof(uint16_t)];
+    uint16_t length = 0;
+    length += write_argument(buffer + length, sizeof(buffer) - length, Argument::UINT16, channel_id);
+    length += write_argument(buffer + length, sizeof(buffer) - length, channel.type, value);
+    length += write_argument(buffer + length, sizeof(buffer) - length, Argument::UINT32, seconds);
+    length += write_argument(buffer + length, sizeof(buffer) - length, Argument::UINT32, microseconds);
+
+    PacketHeader header = BEC_E::build_packet_header(REPORT, 0, 1, length, 4);
+    BEC_E::send_TCP(header, buffer, SEND_DROP);
+}
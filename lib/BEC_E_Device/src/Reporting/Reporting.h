@@ -0,0 +1,24 @@
+#pragma once
+
+#include "BEC_E_Device.h"
+#include "Config/Config.h"
+
+// subscriptions the server can set up. They are saved in one config value
+#ifndef MAX_SUBSCRIPTIONS
+#define MAX_SUBSCRIPTIONS 4
+#endif
+
+// what the server asked to be told about a channel. Packed because it is saved as is
+struct Subscription {
+    uint16_t channel;          // the sample channel id
+    uint32_t min_interval_ms;  // never report more often than this
+    uint32_t max_interval_ms;  // report at least this often even if nothing changed
+    float deadband;            // report when the value has moved at least this far from the last report
+} __attribute__((packed));
+
+static_assert(MAX_SUBSCRIPTIONS * sizeof(Subscription) <= CONFIG_MAX_VALUE, "MAX_SUBSCRIPTIONS don't fit in a config value");
+
+// function prototypes for internal functions
+void reporting_begin();
+void reporting_tick();
+void handle_subscribe(ArgValue *, uint8_t);
@@ -0,0 +1,183 @@
+#include <Arduino.h>
+
+#include "Sampling.h"
+
+#include "debug.h"
+#include "Network/Network.h"
+#include "Connection/Connection.h"
+#include "Encoding/Encoding.h"
+
+// a decimated record is 3 values of at most MAX_VARINT_SIZE bytes each
+static_assert(SAMPLE_PACKET_SIZE >= sizeof(SampleBatchHeader) + 3 * MAX_VARINT_SIZE, "SAMPLE_PACKET_SIZE can't fit a single record");
+
+ChannelState sample_channels[MAX_SAMPLE_CHANNELS];
+uint8_t sample_channel_count;
+
+int32_t sample_to_int(const SampleChannel& channel, ArgValue value);
+void store_sample(ChannelState& state, int32_t value, uint64_t time_us);
+void push_record(ChannelState& state, const int32_t* values, uint64_t time_us);
+void flush_channel(ChannelState& state);
+void restart_channel(ChannelState& state, uint64_t now_us);
+uint8_t record_width(const ChannelState& state);
+uint32_t record_period_us(const ChannelState& state);
+
+namespace BEC_E {
+    bool register_sample_channel(const SampleChannel& channel){
+        if (sample_channel_count >= MAX_SAMPLE_CHANNELS || channel.read_sample == nullptr || channel.period_us == 0) return false;
+        if (channel.mode == SAMPLE_DECIMATE && channel.decimation == 0) return false;
+
+        ChannelState& state = sample_channels[sample_channel_count++];
+        state.channel = channel;
+        restart_channel(state, micros64());
+
+        return true;
+    }
+} // BEC_E namespace
+
+void sampling_tick(){
+    uint64_t now = micros64();
+
+    for (int i = 0; i < sample_channel_count; i++){
+        ChannelState& state = sample_channels[i];
+        if (state.channel.mode == SAMPLE_ON_CHANGE) continue;
+
+        // the loop was held up too long to fill the gap, send what we have and start again from now
+        if (now > state.next_sample_us + (uint64_t)SAMPLE_MAX_CATCH_UP * state.channel.period_us){
+            flush_channel(state);
+            restart_channel(state, now);
+        }
+
+        // take every sample that is due. They are given the time they were due so the rate stays fixed
+        while (now >= state.next_sample_us){
+            store_sample(state, sample_to_int(state.channel, state.channel.read_sample()), state.next_sample_us);
+            state.next_sample_us += state.channel.period_us;
+        }
+
+        // send once the ring is three quarters full or the oldest record has waited long enough
+        bool full = state.used >= SAMPLE_RING_SIZE * 3 / 4;
+        bool old = state.used > 0 && now - state.base_us >= (uint64_t)SAMPLE_FLUSH_INTERVAL_MS * 1000;
+        if (full || old) flush_channel(state);
+    }
+}
+
+const SampleChannel* find_sample_channel(uint16_t id){
+    for (int i = 0; i < sample_channel_count; i++){
+        if (sample_channels[i].channel.id == id) return &sample_channels[i].channel;
+    }
+
+    return nullptr;
+}
+
+float sample_to_float(const SampleChannel& channel, ArgValue value){
+    switch (channel.type){
+        case Argument::FLOAT:  return value.float_val;
+        case Argument::UINT32: return value.uint32_val;
+        default:               return sample_to_int(channel, value);
+    }
+}
+
+int32_t sample_to_int(const SampleChannel& channel, ArgValue value){
+    switch (channel.type){
+        case Argument::BOOL:   return value.bool_val;
+        case Argument::INT8:   return value.int8_val;
+        case Argument::INT16:  return value.int16_val;
+        case Argument::INT32:  return value.int32_val;
+        case Argument::UINT8:  return value.uint8_val;
+        case Argument::UINT16: return value.uint16_val;
+        case Argument::UINT32: return (int32_t)value.uint32_val;
+        case Argument::FLOAT:  return lroundf(value.float_val * channel.scale);
+        default:               return 0;
+    }
+}
+
+void store_sample(ChannelState& state, int32_t value, uint64_t time_us){
+    if (state.channel.mode == SAMPLE_RAW){
+        push_record(state, &value, time_us);
+        return;
+    }
+
+    // fold the sample into the window until it has decimation samples
+    if (state.window_count == 0){
+        state.window_min = value;
+        state.window_max = value;
+        state.window_sum = 0;
+        state.window_start_us = time_us;
+    }
+
+    state.window_min = min(state.window_min, value);
+    state.window_max = max(state.window_max, value);
+    state.window_sum += value;
+    state.window_count ++;
+
+    if (state.window_count < state.channel.decimation) return;
+
+    int32_t record[3] = {state.window_min, state.window_max, (int32_t)(state.window_sum / state.window_count)};
+    push_record(state, record, state.window_start_us);
+    state.window_count = 0;
+}
+
+void push_record(ChannelState& state, const int32_t* values, uint64_t time_us){
+    uint8_t width = record_width(state);
+
+    // full while the server is unreachable. Drop the oldest record, the next one becomes the base
+    if (state.used + width > SAMPLE_RING_SIZE){
+        memmove(state.ring, state.ring + width, (state.used - width) * sizeof(int32_t));
+        state.used -= width;
+        state.base_us += record_period_us(state);
+        state.dropped ++;
+    }
+
+    if (state.used == 0) state.base_us = time_us;
+
+    memcpy(state.ring + state.used, values, width * sizeof(int32_t));
+    state.used += width;
+}
+
+void flush_channel(ChannelState& state){
+    // the ring is the buffer while disconnected
+    if (state.used == 0 || tcp_state != CONNECTION_CONNECTED) return;
+
+    uint8_t width = record_width(state);
+    uint8_t buffer[SAMPLE_PACKET_SIZE];
+
+    while (state.used > 0){
+        uint16_t records;
+        size_t length = encode_deltas(state.ring, state.used / width, width, buffer + sizeof(SampleBatchHeader),
+            sizeof(buffer) - sizeof(SampleBatchHeader), &records);
+
+        // nothing fitted, sending again would never get any further
+        if (records == 0) return;
+
+        SampleBatchHeader batch_header = {state.channel.id, records, state.channel.mode, state.channel.type, state.channel.scale,
+            record_period_us(state), state.base_us, BEC_E::device_to_server_us(state.base_us), state.dropped};
+        memcpy(buffer, &batch_header, sizeof(batch_header));
+
+        // raw binary like the frame stream, so no typed arguments
+        PacketHeader header = BEC_E::build_packet_header(SAMPLE_BATCH, 0, 1, sizeof(batch_header) + length, 0);
+        if (!BEC_E::send_TCP(header, buffer, SEND_DROP)) return;
+
+        // remove what was sent, the rest starts a new batch
+        uint16_t sent = records * width;
+        memmove(state.ring, state.ring + sent, (state.used - sent) * sizeof(int32_t));
+        state.used -= sent;
+        state.base_us += (uint64_t)records * record_period_us(state);
+        state.dropped = 0;
+    }
+}
+
+void restart_channel(ChannelState& state, uint64_t now_us){
+    // anything left couldn't be sent and is no longer on the fixed timeline
+    if (state.used > 0) state.dropped += state.used / record_width(state);
+
+    state.used = 0;
+    state.window_count = 0;
+    state.next_sample_us = now_us;
+}
+
+uint8_t record_width(const ChannelState& state){
+    return state.channel.mode == SAMPLE_DECIMATE ? 3 : 1;
+}
+
+uint32_t record_period_us(const ChannelState& state){
+    return state.channel.mode == SAMPLE_DECIMATE ? state.channel.period_us * state.channel.decimation : state.channel.period_us;
+}
@@ -0,0 +1,63 @@
+#pragma once
+
+#include "BEC_E_Device.h"
+
+#ifndef MAX_SAMPLE_CHANNELS
+#define MAX_SAMPLE_CHANNELS 4
+#endif
+
+// values kept per channel between flushes. A decimated record takes 3
+#ifndef SAMPLE_RING_SIZE
+#define SAMPLE_RING_SIZE 96
+#endif
+
+// longest a sample waits before it is sent
+#ifndef SAMPLE_FLUSH_INTERVAL_MS
+#define SAMPLE_FLUSH_INTERVAL_MS 1000
+#endif
+
+// largest SAMPLE_BATCH payload
+#ifndef SAMPLE_PACKET_SIZE
+#define SAMPLE_PACKET_SIZE 512
+#endif
+
+// samples a channel may fall behind before the missed ones are skipped and a new batch started
+#ifndef SAMPLE_MAX_CATCH_UP
+#define SAMPLE_MAX_CATCH_UP 4
+#endif
+
+// sent in front of the records of a SAMPLE_BATCH packet. The records are delta, zigzag and varint encoded
+// (see encode_deltas). Record n was taken at base + n * record_period_us
+struct SampleBatchHeader {
+    uint16_t channel;          // the channel id
+    uint16_t count;            // records in the batch
+    uint8_t mode;              // sample_mode, SAMPLE_DECIMATE records are min, max, mean
+    uint8_t type;              // Argument::arg_type of the samples
+    float scale;               // float samples were sent as round(value * scale)
+    uint32_t record_period_us; // time between records
+    uint64_t base_device_us;   // device time of the first record
+    int64_t base_server_us;    // the same moment on the server clock, 0 if not synced yet
+    uint32_t dropped;          // records lost since the last batch because the ring was full
+} __attribute__((packed));
+
+// a registered channel and its ring
+struct ChannelState {
+    SampleChannel channel;
+    int32_t ring[SAMPLE_RING_SIZE];
+    uint16_t used;             // values in the ring
+    uint64_t base_us;          // time of the first record in the ring
+    uint64_t next_sample_us;   // when the next sample is due
+    uint32_t dropped;          // records lost since the last batch
+
+    // the decimation window being filled
+    int32_t window_min;
+    int32_t window_max;
+    int64_t window_sum;
+    uint16_t window_count;
+    uint64_t window_start_us;
+};
+
+// function prototypes for internal functions
+void sampling_tick();
+const SampleChannel* find_sample_channel(uint16_t id);
+float sample_to_float(const SampleChannel& channel, ArgValue value);
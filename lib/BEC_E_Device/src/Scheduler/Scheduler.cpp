@@ -0,0 +1,32 @@
+#include <Arduino.h>
+
+#include "Scheduler.h"
+
+ScheduledTask scheduled_tasks[MAX_SCHEDULED_TASKS];
+
+namespace BEC_E {
+    bool schedule(scheduled_function function, uint32_t token, void* context, uint32_t interval_ms){
+        if (function == nullptr) return false;
+
+        for (int i = 0; i < MAX_SCHEDULED_TASKS; i++){
+            if (scheduled_tasks[i].function != nullptr) continue;
+
+            scheduled_tasks[i] = {function, token, context, interval_ms, millis()};
+            return true;
+        }
+
+        return false;
+    }
+} // BEC_E namespace
+
+void scheduler_tick(){
+    for (int i = 0; i < MAX_SCHEDULED_TASKS; i++){
+        ScheduledTask& task = scheduled_tasks[i];
+        if (task.function == nullptr || millis() - task.last_run_ms < task.interval_ms) continue;
+
+        task.last_run_ms = millis();
+        if (task.function(task.token, task.context)){
+            task.function = nullptr;
+        }
+    }
+}
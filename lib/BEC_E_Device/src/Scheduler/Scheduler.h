@@ -0,0 +1,19 @@
+#pragma once
+
+#include "BEC_E_Device.h"
+
+#ifndef MAX_SCHEDULED_TASKS
+#define MAX_SCHEDULED_TASKS 8
+#endif
+
+// work run from the main loop until its function returns true
+struct ScheduledTask {
+    scheduled_function function;  // nullptr when the slot is free
+    uint32_t token;               // passed back to the function, normally from BEC_E::defer_reply
+    void* context;                // passed back to the function
+    uint32_t interval_ms;         // time between runs, 0 for every loop
+    unsigned long last_run_ms;
+};
+
+// function prototypes for internal functions
+void scheduler_tick();
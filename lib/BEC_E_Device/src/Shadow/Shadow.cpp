@@ -0,0 +1,158 @@
+#include <Arduino.h>
+
+#include "Shadow.h"
+
+#include "debug.h"
+#include "Network/Network.h"
+#include "Connection/Connection.h"
+#include "Commands/Commands.h"
+
+ShadowField shadow_fields[MAX_SHADOW_FIELDS];
+uint8_t shadow_field_count;
+
+// bumped on every change. Starts again from 0 at boot, the epoch tells the server it did
+uint32_t shadow_version;
+uint32_t shadow_epoch;
+
+// fields the server hasn't acknowledged, one bit per field
+uint32_t shadow_dirty;
+
+// the last version the server said it has, and the last version sent on this connection
+uint32_t acked_version;
+uint32_t sent_version;
+
+bool sync_requested;
+bool was_connected;
+
+ShadowField* find_shadow_field(uint16_t command_id);
+void send_state_delta();
+
+namespace BEC_E {
+    bool set_state(uint16_t command_id, Argument::arg_type type, ArgValue value){
+        if (type == Argument::STRING) return false;
+
+        // changed on the device, so the server has to be told
+        shadow_update(command_id, type, value, false);
+        return find_shadow_field(command_id) != nullptr;
+    }
+} // BEC_E namespace
+
+void shadow_tick(){
+    // lets the server tell a restart apart from a connection drop
+    if (shadow_epoch == 0) shadow_epoch = ESP.random() | 1;
+
+    bool connected = tcp_state == CONNECTION_CONNECTED;
+
+    // send everything the server hadn't acknowledged before the connection dropped
+    if (connected && !was_connected) sent_version = acked_version;
+    was_connected = connected;
+
+    if (!connected) return;
+    if (!sync_requested && sent_version >= shadow_version) return;
+
+    send_state_delta();
+}
+
+bool shadow_tracks(command_type type){
+    return type == SWITCH || type == SLIDER_UINT8 || type == COLOR || type == DROPDOWN;
+}
+
+void shadow_update(uint16_t command_id, uint8_t type, const ArgValue& value, bool server_knows){
+    // strings only live as long as the packet they came in
+    if (type == Argument::STRING) return;
+
+    ShadowField* field = find_shadow_field(command_id);
+
+    if (field == nullptr){
+        if (shadow_field_count == MAX_SHADOW_FIELDS){
+            BEC_E::send_log("No room to shadow another command");
+            return;
+        }
+
+        field = &shadow_fields[shadow_field_count++];
+        field->command_id = command_id;
+    }
+    else if (field->type == type && memcmp(&field->value, &value, argument_size(type)) == 0){
+        return;
+    }
+
+    field->type = type;
+    field->value = value;
+    field->version = ++shadow_version;
+
+    // the server sent this value itself, so only a restart means it needs it again
+    uint32_t bit = 1UL << (field - shadow_fields);
+    if (server_knows) shadow_dirty &= ~bit;
+    else shadow_dirty |= bit;
+}
+
+void handle_sync_state(ArgValue args[], uint8_t arg_number){
+    // the epoch and version the server last received, or nothing for the whole shadow
+    const Argument::arg_type version_type = Argument::UINT32;
+    if ((arg_number != 0 && arg_number != 2) || !arguments_match(&version_type, 1)){
+        BEC_E::reply(REPLY_ERROR);
+        return;
+    }
+
+    uint32_t epoch = arg_number == 2 ? args[0].uint32_val : 0;
+    uint32_t version = arg_number == 2 ? args[1].uint32_val : 0;
+
+    if (epoch != shadow_epoch || version > shadow_version){
+        version = 0;
+        shadow_dirty = shadow_field_count == 32 ? 0xFFFFFFFF : (1UL << shadow_field_count) - 1;
+    }
+
+    // acknowledged fields don't need sending again
+    for (uint8_t i = 0; i < shadow_field_count; i++){
+        if (shadow_fields[i].version <= version) shadow_dirty &= ~(1UL << i);
+    }
+
+    acked_version = version;
+    sent_version = version;
+    sync_requested = true;
+}
+
+ShadowField* find_shadow_field(uint16_t command_id){
+    for (uint8_t i = 0; i < shadow_field_count; i++){
+        if (shadow_fields[i].command_id == command_id) return &shadow_fields[i];
+    }
+
+    return nullptr;
+}
+
+void send_state_delta(){
+    // the epoch and version, then the command id and value of every changed field
+    uint8_t buffer[2 * (1 + sizeof(uint32_t)) + MAX_SHADOW_FIELDS * (1 + sizeof(uint16_t) + 1 + sizeof(ArgValue))];
+    uint16_t length = 0;
+    uint8_t arg_number = 2;
+
+    ArgValue epoch, version;
+    epoch.uint32_val = shadow_epoch;
+    version.uint32_val = shadow_version;
+    length += write_argument(buffer + length, sizeof(buffer) - length, Argument::UINT32, epoch);
+    length += write_argument(buffer + length, sizeof(buffer) - length, Argument::UINT32, version);
+
+    for (uint8_t i = 0; i < shadow_field_count; i++){
+        const ShadowField& field = shadow_fields[i];
+        if (!(shadow_dirty & (1UL << i)) || field.version <= sent_version) continue;
+
+        ArgValue id;
+        id.uint16_val = field.command_id;
+        length += write_argument(buffer + length, sizeof(buffer) - length, Argument::UINT16, id);
+        length += write_argument(buffer + length, sizeof(buffer) - length, field.type, field.value);
+        arg_number += 2;
+    }
+
+    // nothing the server doesn't know, unless it asked
+    if (arg_number == 2 && !sync_requested){
+        sent_version = shadow_version;
+        return;
+    }
+
+    // a dropped delta is built again on the next tick
+    PacketHeader header = BEC_E::build_packet_header(STATE_SYNC, 0, 1, length, arg_number);
+    if (!BEC_E::send_TCP(header, buffer, SEND_DROP)) return;
+
+    sent_version = shadow_version;
+    sync_requested = false;
+}
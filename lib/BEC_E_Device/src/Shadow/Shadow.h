@@ -0,0 +1,24 @@
+#pragma once
+
+#include "BEC_E_Device.h"
+
+// values of stateful commands kept for syncing the server
+#ifndef MAX_SHADOW_FIELDS
+#define MAX_SHADOW_FIELDS 16
+#endif
+
+static_assert(MAX_SHADOW_FIELDS <= 32, "the dirty bitmap only has room for 32 fields");
+
+// the last value of a SWITCH, SLIDER_UINT8, COLOR or DROPDOWN command
+struct ShadowField {
+    uint16_t command_id;
+    uint8_t type;       // the Argument::arg_type of the value
+    ArgValue value;
+    uint32_t version;   // shadow version when the value last changed
+};
+
+// function prototypes for internal functions
+void shadow_tick();
+bool shadow_tracks(command_type type);
+void shadow_update(uint16_t command_id, uint8_t type, const ArgValue& value, bool server_knows);
+void handle_sync_state(ArgValue *, uint8_t);
@@ -0,0 +1,119 @@
+#include <Arduino.h>
+
+#include "Tasks.h"
+
+#include "debug.h"
+#include "Network/Network.h"
+#include "Commands/Commands.h"
+#include "Packet/Packet.h"
+#include "Packet/PacketParser.h"
+#include "Events/Events.h"
+#include "Areana/Arena.h"
+#include "Connection/Connection.h"
+#include "Portal/Portal.h"
+#include "OTA/OTA.h"
+#include "FrameStream/FrameStream.h"
+#include "Trace/Trace.h"
+#include "Clock/Clock.h"
+#include "Sampling/Sampling.h"
+#include "Reporting/Reporting.h"
+#include "Reply/Reply.h"
+#include "Scheduler/Scheduler.h"
+#include "Local/Local.h"
+#include "Discovery/Discovery.h"
+#include "Shadow/Shadow.h"
+#include "Capture/Capture.h"
+
+// packets from the server are built up here as they arrive
+uint8_t receive_buffer[RECEIVE_BUFFER_SIZE];
+PacketParser parser = {receive_buffer, sizeof(receive_buffer), 0, 0, PARSER_RECEIVING};
+
+void receive_packet();
+void run_loop_functions();
+
+void network_step(){
+    portal_tick();
+    discovery_tick();
+    connection_tick();
+    ota_tick();
+
+    receive_packet();
+}
+
+void application_step(){
+    local_tick();
+    clock_tick();
+    sampling_tick();
+    reporting_tick();
+    shadow_tick();
+    scheduler_tick();
+    reply_tick();
+    frame_stream_tick();
+
+    run_loop_functions();
+}
+
+void receive_packet(){
+    // only what has already arrived. A packet split across reads is finished on a later call
+    for (int packets = 0; packets < RECEIVE_PACKETS_PER_STEP; ){
+        uint16_t wanted;
+        uint8_t* next = parser_next(parser, &wanted);
+
+        uint16_t received = events_read(next, wanted);
+        if (received == 0) return;
+
+        parser_state state = parser_received(parser, received);
+        if (state == PARSER_RECEIVING) continue;
+        packets ++;
+
+        // the bytes as they came, so a bad packet can be replayed too
+        if (state == PARSER_READY) capture_record(CAPTURE_RX, receive_buffer, parser.length);
+
+        PacketHeader header;
+        memcpy(&header, receive_buffer, sizeof(PacketHeader));
+        TRACE(TRACE_LEVEL_INFO, TRACE_PACKET_HEADER, header.type, header.packet_id);
+
+        if (state == PARSER_TOO_LARGE){
+            // asking for it again would only get the same packet
+            BEC_E::send_log("Packet too large");
+            continue;
+        }
+
+        TRACE(TRACE_LEVEL_VERBOSE, TRACE_PACKET_RECEIVED, header.payload_len, header.argument_number);
+
+        // check the crc
+        if (!validate_crc(receive_buffer, header)){
+            TRACE(TRACE_LEVEL_ERROR, TRACE_PACKET_BAD_CRC, header.type, header.packet_id);
+            handle_bad_packet(header);
+            BEC_E::send_log("CRC mismatch!");
+            continue;
+        }
+
+        handle_packet(receive_buffer, {0, 0});
+        arena_free();
+    }
+}
+
+void receive_reset(){
+    // a packet cut off by the old connection won't be finished by the new one
+    parser_reset(parser);
+}
+
+void handle_received(){
+    receive_packet();
+}
+
+reply_status handle_packet(uint8_t* buffer, ReplyPeer from){
+    PacketHeader header;
+    memcpy(&header, buffer, sizeof(PacketHeader));
+
+    // handle the command. It is answered with its packet id when it is done
+    reply_begin(header.packet_id, from);
+    bool handled = handle_command(header, buffer);
+    if (!handled){
+        TRACE(TRACE_LEVEL_ERROR, TRACE_COMMAND_UNKNOWN, header.type, header.packet_id);
+        BEC_E::send_log("Unknown command");
+    }
+
+    return reply_end(handled);
+}
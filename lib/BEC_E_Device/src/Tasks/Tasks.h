@@ -0,0 +1,21 @@
+#pragma once
+
+#include "BEC_E_Device.h"
+#include "Reply/Reply.h"
+
+// largest packet from the server, with its crc. Bigger ones are skipped
+#ifndef RECEIVE_BUFFER_SIZE
+#define RECEIVE_BUFFER_SIZE 512
+#endif
+
+// most packets handled each time the connection is checked, so a flood can't starve the loop functions
+#ifndef RECEIVE_PACKETS_PER_STEP
+#define RECEIVE_PACKETS_PER_STEP 4
+#endif
+
+// function prototypes for internal functions
+void network_step();
+void application_step();
+reply_status handle_packet(uint8_t* buffer, ReplyPeer from);
+void handle_received();
+void receive_reset();
@@ -0,0 +1,56 @@
+#include <Arduino.h>
+
+#include "Telemetry.h"
+
+#include "Network/Network.h"
+#include "Encoding/Encoding.h"
+
+namespace BEC_E {
+    void begin_batch(TelemetryBatch& batch, uint16_t channel){
+        batch.channel = channel;
+        batch.count = 0;
+        batch.length = 0;
+    }
+
+    bool add_to_batch(TelemetryBatch& batch, float value){
+        return add_to_batch(batch, micros64(), value);
+    }
+
+    bool add_to_batch(TelemetryBatch& batch, uint64_t timestamp_us, float value){
+        // the deltas can't go backwards
+        if (batch.count > 0 && timestamp_us < batch.last_us) return false;
+
+        uint8_t record[MAX_VARINT_SIZE + sizeof(float)];
+        uint8_t length = write_varint(record, batch.count == 0 ? 0 : (uint32_t)min<uint64_t>(timestamp_us - batch.last_us, UINT32_MAX));
+        memcpy(record + length, &value, sizeof(value));
+        length += sizeof(value);
+
+        if (batch.length + length > TELEMETRY_BATCH_SIZE) return false;
+
+        if (batch.count == 0) batch.base_us = timestamp_us;
+        memcpy(batch.data + batch.length, record, length);
+        batch.length += length;
+        batch.last_us = timestamp_us;
+        batch.count ++;
+
+        return true;
+    }
+
+    bool send_batch(TelemetryBatch& batch, send_policy policy){
+        if (batch.count == 0) return true;
+
+        TelemetryBatchHeader batch_header = {batch.channel, batch.count, TELEMETRY_FLOAT, batch.base_us, device_to_server_us(batch.base_us)};
+
+        uint8_t buffer[sizeof(TelemetryBatchHeader) + TELEMETRY_BATCH_SIZE];
+        memcpy(buffer, &batch_header, sizeof(batch_header));
+        memcpy(buffer + sizeof(batch_header), batch.data, batch.length);
+
+        // raw binary like the frame stream, so no typed arguments
+        PacketHeader header = build_packet_header(TELEMETRY_BATCH, 0, 1, sizeof(batch_header) + batch.length, 0);
+        bool sent = send_TCP(header, buffer, policy);
+
+        begin_batch(batch, batch.channel);
+
+        return sent;
+    }
+} // BEC_E namespace
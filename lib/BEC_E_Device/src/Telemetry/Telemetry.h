@@ -0,0 +1,18 @@
+#pragma once
+
+#include "BEC_E_Device.h"
+
+// how the values of a batch are stored
+enum telemetry_encoding : uint8_t {
+    TELEMETRY_FLOAT = 0, // a 4 byte float per record
+};
+
+// sent in front of the records of a TELEMETRY_BATCH packet. Each record is a varint of the microseconds since
+// the previous one (the first since base_device_us) followed by its value
+struct TelemetryBatchHeader {
+    uint16_t channel;        // which series the records belong to
+    uint16_t count;          // records in the batch
+    uint8_t encoding;        // telemetry_encoding of the values
+    uint64_t base_device_us; // device time of the first record
+    int64_t base_server_us;  // the same moment on the server clock in microseconds since the epoch, 0 if not synced yet
+} __attribute__((packed));
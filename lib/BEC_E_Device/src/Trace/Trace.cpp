@@ -0,0 +1,61 @@
+#include <Arduino.h>
+
+#include "Trace.h"
+
+#include "Network/Network.h"
+
+static_assert((TRACE_RING_SIZE & (TRACE_RING_SIZE - 1)) == 0, "TRACE_RING_SIZE must be a power of two");
+
+#if TRACE_LEVEL > TRACE_LEVEL_OFF
+TraceEvent trace_ring[TRACE_RING_SIZE];
+
+// total events recorded, the next one goes at trace_head % TRACE_RING_SIZE
+uint32_t trace_head;
+
+// stops the dump overwriting the events it is sending
+bool trace_paused;
+#endif
+
+void trace_record(uint16_t event, uint8_t phase, uint32_t arg0, uint32_t arg1){
+#if TRACE_LEVEL > TRACE_LEVEL_OFF
+    if (trace_paused) return;
+
+    TraceEvent& slot = trace_ring[trace_head++ & (TRACE_RING_SIZE - 1)];
+    slot.timestamp_us = micros();
+    slot.event = event;
+    slot.phase = phase;
+    slot.arg0 = arg0;
+    slot.arg1 = arg1;
+#endif
+}
+
+void trace_dump(){
+#if TRACE_LEVEL > TRACE_LEVEL_OFF
+    trace_paused = true;
+
+    uint32_t total = trace_head;
+    uint32_t first = total > TRACE_RING_SIZE ? total - TRACE_RING_SIZE : 0;
+    uint32_t now = micros();
+
+    // send the ring oldest first, a packet at a time
+    uint8_t buffer[sizeof(TraceDumpHeader) + TRACE_EVENTS_PER_PACKET * sizeof(TraceEvent)];
+    for (uint32_t index = first; index < total; index += TRACE_EVENTS_PER_PACKET){
+        uint16_t count = min<uint32_t>(TRACE_EVENTS_PER_PACKET, total - index);
+
+        TraceDumpHeader dump = {now, index, total, count};
+        memcpy(buffer, &dump, sizeof(dump));
+        for (uint16_t i = 0; i < count; i++){
+            memcpy(buffer + sizeof(dump) + i * sizeof(TraceEvent), &trace_ring[(index + i) & (TRACE_RING_SIZE - 1)], sizeof(TraceEvent));
+        }
+
+        uint16_t length = sizeof(dump) + count * sizeof(TraceEvent);
+        PacketHeader header = BEC_E::build_packet_header(TRACE_DUMP, (index - first) / TRACE_EVENTS_PER_PACKET,
+            (total - first + TRACE_EVENTS_PER_PACKET - 1) / TRACE_EVENTS_PER_PACKET, length, 0);
+        BEC_E::send_TCP(header, buffer);
+    }
+
+    trace_paused = false;
+#else
+    BEC_E::send_log("Tracing is compiled out, build with TRACE_LEVEL above 0");
+#endif
+}
@@ -0,0 +1,101 @@
+#pragma once
+
+#include <stdint.h>
+
+#include "BEC_E_Device.h"
+
+// trace levels. Events above TRACE_LEVEL are compiled out
+#define TRACE_LEVEL_OFF     0
+#define TRACE_LEVEL_ERROR   1
+#define TRACE_LEVEL_INFO    2
+#define TRACE_LEVEL_VERBOSE 3
+
+#ifndef TRACE_LEVEL
+#ifdef BEC_E_DEBUG
+#define TRACE_LEVEL TRACE_LEVEL_INFO
+#else
+#define TRACE_LEVEL TRACE_LEVEL_OFF
+#endif
+#endif
+
+// bit mask of the trace_category values to record
+#ifndef TRACE_CATEGORIES
+#define TRACE_CATEGORIES 0xFF
+#endif
+
+// events kept in RAM. Must be a power of two
+#ifndef TRACE_RING_SIZE
+#define TRACE_RING_SIZE 128
+#endif
+
+// events sent per TRACE_DUMP packet
+#ifndef TRACE_EVENTS_PER_PACKET
+#define TRACE_EVENTS_PER_PACKET 32
+#endif
+
+// what part of the library an event comes from
+enum trace_category : uint8_t {
+    TRACE_CATEGORY_PACKET     = 0, // packets being received and sent
+    TRACE_CATEGORY_COMMAND    = 1, // commands being dispatched
+    TRACE_CATEGORY_CONNECTION = 2, // the server connection
+    TRACE_CATEGORY_USER       = 7, // free for the application
+};
+
+// whether an event is a point in time or starts or ends a span
+enum trace_phase : uint8_t {
+    TRACE_INSTANT = 0,
+    TRACE_BEGIN   = 1,
+    TRACE_END     = 2,
+};
+
+// the category is kept in the top byte of the event id
+#define TRACE_EVENT_ID(category, number) (((category) << 8) | (number))
+#define TRACE_EVENT_CATEGORY(event) ((event) >> 8)
+
+// the events recorded by the library, with what their arguments hold
+enum trace_event : uint16_t {
+    TRACE_PACKET_HEADER    = TRACE_EVENT_ID(TRACE_CATEGORY_PACKET, 0),      // header read. type, packet id
+    TRACE_PACKET_RECEIVED  = TRACE_EVENT_ID(TRACE_CATEGORY_PACKET, 1),      // rest of the packet read. payload length, argument number
+    TRACE_PACKET_BAD_CRC   = TRACE_EVENT_ID(TRACE_CATEGORY_PACKET, 2),      // crc mismatch. type, packet id
+    TRACE_PACKET_SENT      = TRACE_EVENT_ID(TRACE_CATEGORY_PACKET, 3),      // frame written to the server. length, 0
+    TRACE_PACKET_QUEUED    = TRACE_EVENT_ID(TRACE_CATEGORY_PACKET, 4),      // frame kept for later. length, send policy
+    TRACE_COMMAND          = TRACE_EVENT_ID(TRACE_CATEGORY_COMMAND, 0),     // span of a command running. command id, argument number
+    TRACE_COMMAND_UNKNOWN  = TRACE_EVENT_ID(TRACE_CATEGORY_COMMAND, 1),     // no command matched. type, packet id
+    TRACE_CONNECTED        = TRACE_EVENT_ID(TRACE_CATEGORY_CONNECTION, 0),  // connected to the server. 0, 0
+    TRACE_DISCONNECTED     = TRACE_EVENT_ID(TRACE_CATEGORY_CONNECTION, 1),  // connection lost. 0, 0
+    TRACE_CONNECT_FAILED   = TRACE_EVENT_ID(TRACE_CATEGORY_CONNECTION, 2),  // attempt failed. failed attempts, next backoff in ms
+    TRACE_CONNECT_RACE     = TRACE_EVENT_ID(TRACE_CATEGORY_CONNECTION, 3),  // attempts on the servers finished. index of the server that won or 0xFF, ms it took
+};
+
+// one recorded event. Packed so a dump can be sent as is
+struct TraceEvent {
+    uint32_t timestamp_us; // micros() when it was recorded
+    uint16_t event;        // trace_event, or a TRACE_CATEGORY_USER id
+    uint8_t phase;         // trace_phase
+    uint8_t reserved;
+    uint32_t arg0;
+    uint32_t arg1;
+} __attribute__((packed));
+
+// sent in front of the events of each TRACE_DUMP packet
+struct TraceDumpHeader {
+    uint32_t now_us;       // micros() when the dump started
+    uint32_t first_index;  // index of the first event in this packet since boot
+    uint32_t total_events; // events recorded since boot. Anything before total_events - TRACE_RING_SIZE was overwritten
+    uint16_t event_count;  // events in this packet
+} __attribute__((packed));
+
+// records an event if its level and category are enabled. Both are constants so disabled events cost nothing
+#define TRACE_AT(level, phase, event, arg0, arg1) \
+    do { \
+        if ((level) <= TRACE_LEVEL && (TRACE_CATEGORIES & (1u << TRACE_EVENT_CATEGORY(event)))) \
+            trace_record((event), (phase), (arg0), (arg1)); \
+    } while (0)
+
+#define TRACE(level, event, arg0, arg1)       TRACE_AT(level, TRACE_INSTANT, event, arg0, arg1)
+#define TRACE_BEGIN(level, event, arg0, arg1) TRACE_AT(level, TRACE_BEGIN, event, arg0, arg1)
+#define TRACE_END(level, event, arg0, arg1)   TRACE_AT(level, TRACE_END, event, arg0, arg1)
+
+// function prototypes for internal functions
+void trace_record(uint16_t event, uint8_t phase, uint32_t arg0, uint32_t arg1);
+void trace_dump();
@@ -0,0 +1,58 @@
+#pragma once
+
+// the device packet framing, shared by the host tools
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "BEC_E_Device.h"
+
+namespace bece {
+    // message types sent by the library, matching default_message_type in Network/Network.h
+    enum message_type : uint16_t {
+        LOG_MESSAGE     = 65535,
+        SEND_COMMAND    = 65534,
+        SEND_NAME       = 65533,
+        ESTABLISH_UDP   = 65532,
+        RESEND          = 65531,
+        OTA_PROGRESS    = 65530,
+        FRAME_FRAGMENT  = 65529,
+        TRACE_DUMP      = 65528,
+        CLOCK_REQUEST   = 65527,
+        TELEMETRY_BATCH = 65526,
+        SAMPLE_BATCH    = 65525,
+        REPORT          = 65524,
+        REPLY           = 65523,
+        LOCAL_COMMAND   = 65522,
+        DISCOVERY_QUERY = 65521,
+        DISCOVERY_REPLY = 65520,
+        STATE_SYNC      = 65519,
+        CAPTURE_DUMP    = 65518,
+    };
+
+    // same crc as calculate_crc16 on the device
+    inline uint16_t crc16(const uint8_t* data, size_t length){
+        uint16_t crc = 0xFFFF;
+        for (size_t i = 0; i < length; i++){
+            crc ^= (uint16_t)data[i] << 8;
+            for (int j = 0; j < 8; j++){
+                crc = (crc & 0x8000) ? (crc << 1) ^ 0x1021 : crc << 1;
+            }
+        }
+        return crc;
+    }
+
+    // checks the magic, length and crc of a whole frame (header, payload, crc)
+    inline bool valid_frame(const uint8_t* frame, size_t length){
+        if (length < sizeof(PacketHeader) + sizeof(uint16_t)) return false;
+
+        const PacketHeader* header = (const PacketHeader*)frame;
+        if (header->magic != MAGIC) return false;
+        if (sizeof(PacketHeader) + header->payload_len + sizeof(uint16_t) != length) return false;
+
+        uint16_t crc;
+        memcpy(&crc, frame + length - sizeof(crc), sizeof(crc));
+        return crc16(frame, length - sizeof(crc)) == crc;
+    }
+}
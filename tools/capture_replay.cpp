@@ -0,0 +1,331 @@
+// replays a capture from a device's "Send Capture" command through the receive path built for the host: the packet
+// parser, validate_crc and parse_argument are the device's own code. Reports throughput and the time spent in each stage.
+// Command handlers belong to the firmware, so dispatch only looks the command up like handle_command does.
+//
+// usage: capture_replay [-r] [-n repeats] [-c chunk] [-o capture.cap] input
+//        input is the raw bytes from the device's TCP stream, or a capture saved with -o
+//        -r  replay at the original speed instead of as fast as possible
+//        -n  replay this many times, for steadier numbers (fast replays only)
+//        -c  bytes handed to the parser per read, as if the packet arrived in pieces (default the whole packet)
+//        -o  save the capture on its own, for keeping as a regression corpus
+
+#include <unistd.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <thread>
+#include <vector>
+
+#include "bece_protocol.h"
+#include "Areana/Arena.h"
+#include "Capture/Capture.h"
+#include "Packet/PacketParser.h"
+#include "Packet/Wire.h"
+#include "Tasks/Tasks.h"
+
+// written at the start of a saved capture, followed by the records as they were in the ring
+const char CAPTURE_FILE_MAGIC[8] = "BECECAP";
+
+struct Record {
+    uint64_t timestamp_us;  // micros() with the wraps taken out
+    uint8_t direction;
+    std::vector<uint8_t> frame;
+};
+
+// the stages timed for every received frame
+enum stage { STAGE_RECEIVE, STAGE_CRC, STAGE_ARGUMENTS, STAGE_DISPATCH, STAGE_COUNT };
+const char* stage_names[STAGE_COUNT] = {"receive", "crc", "arguments", "dispatch"};
+
+int log_messages;
+
+// parse_argument logs through the device's send_log
+namespace BEC_E {
+    void send_log(const char*){
+        log_messages ++;
+    }
+}
+
+int64_t now_ns(){
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+std::vector<uint8_t> read_file(const char* path){
+    std::vector<uint8_t> data;
+    FILE* file = fopen(path, "rb");
+    if (file == nullptr){
+        perror(path);
+        exit(1);
+    }
+
+    uint8_t chunk[4096];
+    size_t read;
+    while ((read = fread(chunk, 1, sizeof(chunk), file)) > 0) data.insert(data.end(), chunk, chunk + read);
+    fclose(file);
+    return data;
+}
+
+// the ring bytes from the CAPTURE_DUMP packets in a stream. Anything else is skipped
+std::vector<uint8_t> ring_from_stream(const std::vector<uint8_t>& data, uint32_t* dropped){
+    std::vector<uint8_t> ring;
+    std::vector<bool> filled;
+
+    for (size_t offset = 0; offset + sizeof(PacketHeader) + sizeof(uint16_t) <= data.size();){
+        PacketHeader header;
+        memcpy(&header, data.data() + offset, sizeof(header));
+        size_t length = sizeof(PacketHeader) + header.payload_len + sizeof(uint16_t);
+
+        if (offset + length > data.size() || !bece::valid_frame(data.data() + offset, length)){
+            offset ++;
+            continue;
+        }
+
+        const uint8_t* payload = data.data() + offset + sizeof(PacketHeader);
+        offset += length;
+
+        if (header.type != bece::CAPTURE_DUMP || header.payload_len < sizeof(CaptureDumpHeader)) continue;
+
+        CaptureDumpHeader dump;
+        memcpy(&dump, payload, sizeof(dump));
+        if (sizeof(dump) + dump.length > header.payload_len || dump.offset + dump.length > dump.total_bytes) continue;
+
+        // a newer dump replaces an older one in the same stream
+        if (ring.size() != dump.total_bytes || dump.offset == 0){
+            ring.assign(dump.total_bytes, 0);
+            filled.assign(dump.total_bytes, false);
+        }
+
+        memcpy(ring.data() + dump.offset, payload + sizeof(dump), dump.length);
+        std::fill(filled.begin() + dump.offset, filled.begin() + dump.offset + dump.length, true);
+        *dropped = dump.dropped;
+    }
+
+    // a lost packet leaves a hole, stop at it rather than read records out of the middle of frames
+    size_t whole = std::find(filled.begin(), filled.end(), false) - filled.begin();
+    if (whole < ring.size()) fprintf(stderr, "dump incomplete, only the first %zu of %zu bytes are used\n", whole, ring.size());
+    ring.resize(whole);
+    return ring;
+}
+
+std::vector<Record> records_from_ring(const std::vector<uint8_t>& ring){
+    std::vector<Record> records;
+    uint64_t wraps = 0;
+    uint32_t last_us = 0;
+
+    for (size_t offset = 0; offset + sizeof(CaptureRecord) <= ring.size();){
+        CaptureRecord header;
+        memcpy(&header, ring.data() + offset, sizeof(header));
+        offset += sizeof(header);
+        if (offset + header.length > ring.size()) break;
+
+        // micros() wraps every 71 minutes, keep the times increasing
+        if (!records.empty() && header.timestamp_us < last_us && last_us - header.timestamp_us > 0x80000000u) wraps ++;
+        last_us = header.timestamp_us;
+
+        Record record = {wraps * 0x100000000ULL + header.timestamp_us, header.direction,
+            std::vector<uint8_t>(ring.begin() + offset, ring.begin() + offset + header.length)};
+        records.push_back(record);
+        offset += header.length;
+    }
+
+    return records;
+}
+
+struct Replay {
+    std::vector<int64_t> stage_ns[STAGE_COUNT];
+    std::vector<int64_t> late_ns;
+    size_t frames = 0;
+    size_t bytes = 0;
+    size_t bad_crc = 0;
+    size_t bad_arguments = 0;
+    size_t skipped = 0;
+    int64_t total_ns = 0;
+};
+
+// command ids seen so far, searched in order like the command tables
+std::vector<uint16_t> known_ids;
+
+uint16_t dispatch(uint16_t id){
+    for (size_t i = 0; i < known_ids.size(); i++){
+        if (known_ids[i] == id) return i;
+    }
+
+    known_ids.push_back(id);
+    return known_ids.size() - 1;
+}
+
+// one received frame through each stage, as receive_packet and check_command do
+void replay_frame(const Record& record, uint16_t chunk, Replay& replay){
+    static uint8_t buffer[RECEIVE_BUFFER_SIZE];
+    PacketParser parser = {buffer, sizeof(buffer), 0, 0, PARSER_RECEIVING};
+
+    // receive: the parser takes the bytes a read at a time
+    int64_t start = now_ns();
+    parser_state state = PARSER_RECEIVING;
+    for (size_t offset = 0; offset < record.frame.size() && state == PARSER_RECEIVING;){
+        uint16_t wanted;
+        uint8_t* next = parser_next(parser, &wanted);
+
+        uint16_t count = std::min<size_t>({(size_t)wanted, (size_t)chunk, record.frame.size() - offset});
+        memcpy(next, record.frame.data() + offset, count);
+        offset += count;
+        state = parser_received(parser, count);
+    }
+    int64_t received = now_ns();
+
+    if (state != PARSER_READY){
+        replay.skipped ++;
+        return;
+    }
+
+    PacketHeader header;
+    memcpy(&header, buffer, sizeof(header));
+    bool crc_ok = validate_crc(buffer, header);
+    int64_t checked = now_ns();
+
+    if (!crc_ok){
+        replay.bad_crc ++;
+        return;
+    }
+
+    // the payload ends with the crc, like check_command on the device
+    ArgValue* args = (ArgValue*)arena_malloc(header.argument_number * sizeof(ArgValue));
+    uint8_t* payload = buffer + sizeof(PacketHeader);
+    uint16_t remaining = header.payload_len >= sizeof(uint16_t) ? header.payload_len - sizeof(uint16_t) : 0;
+    for (int i = 0; args != nullptr && i < header.argument_number; i++){
+        uint16_t used = parse_argument(args[i], payload, remaining);
+        if (used == 0){
+            replay.bad_arguments ++;
+            arena_free();
+            return;
+        }
+
+        payload += used;
+        remaining -= used;
+    }
+    int64_t parsed = now_ns();
+
+    volatile uint16_t found = dispatch(header.type);
+    (void)found;
+    arena_free();
+    int64_t dispatched = now_ns();
+
+    replay.stage_ns[STAGE_RECEIVE].push_back(received - start);
+    replay.stage_ns[STAGE_CRC].push_back(checked - received);
+    replay.stage_ns[STAGE_ARGUMENTS].push_back(parsed - checked);
+    replay.stage_ns[STAGE_DISPATCH].push_back(dispatched - parsed);
+    replay.frames ++;
+    replay.bytes += record.frame.size();
+}
+
+void replay_records(const std::vector<Record>& records, bool realtime, int repeats, uint16_t chunk, Replay& replay){
+    int64_t begin = now_ns();
+
+    for (int repeat = 0; repeat < repeats; repeat++){
+        int64_t pass_begin = now_ns();
+        for (const Record& record : records){
+            if (record.direction != CAPTURE_RX) continue;
+
+            if (realtime){
+                // wait until the frame arrived in the capture
+                int64_t due = pass_begin + (int64_t)(record.timestamp_us - records.front().timestamp_us) * 1000;
+                int64_t wait = due - now_ns();
+                if (wait > 0) std::this_thread::sleep_for(std::chrono::nanoseconds(wait));
+                replay.late_ns.push_back(std::max<int64_t>(0, now_ns() - due));
+            }
+
+            replay_frame(record, chunk, replay);
+        }
+    }
+
+    replay.total_ns = now_ns() - begin;
+}
+
+void print_stage(const char* name, std::vector<int64_t>& times){
+    if (times.empty()) return;
+
+    std::sort(times.begin(), times.end());
+    int64_t sum = 0;
+    for (int64_t time : times) sum += time;
+    printf("  %-10s mean %8.0fns  p50 %8lldns  p99 %8lldns\n", name, (double)sum / times.size(),
+        (long long)times[times.size() / 2], (long long)times[times.size() * 99 / 100]);
+}
+
+int main(int argc, char** argv){
+    bool realtime = false;
+    int repeats = 1;
+    uint16_t chunk = 0xFFFF;
+    const char* output = nullptr;
+
+    int option;
+    while ((option = getopt(argc, argv, "rn:c:o:")) != -1){
+        switch (option){
+            case 'r': realtime = true; break;
+            case 'n': repeats = std::max(1, atoi(optarg)); break;
+            case 'c': chunk = std::max(1, atoi(optarg)); break;
+            case 'o': output = optarg; break;
+            default:
+                fprintf(stderr, "usage: %s [-r] [-n repeats] [-c chunk] [-o capture.cap] input\n", argv[0]);
+                return 1;
+        }
+    }
+
+    if (optind >= argc){
+        fprintf(stderr, "usage: %s [-r] [-n repeats] [-c chunk] [-o capture.cap] input\n", argv[0]);
+        return 1;
+    }
+
+    std::vector<uint8_t> data = read_file(argv[optind]);
+
+    // a saved capture, or the stream the dump came in
+    std::vector<uint8_t> ring;
+    uint32_t dropped = 0;
+    if (data.size() >= sizeof(CAPTURE_FILE_MAGIC) && memcmp(data.data(), CAPTURE_FILE_MAGIC, sizeof(CAPTURE_FILE_MAGIC)) == 0){
+        ring.assign(data.begin() + sizeof(CAPTURE_FILE_MAGIC), data.end());
+    }
+    else {
+        ring = ring_from_stream(data, &dropped);
+    }
+
+    std::vector<Record> records = records_from_ring(ring);
+    if (records.empty()){
+        fprintf(stderr, "no capture records found\n");
+        return 1;
+    }
+
+    if (output != nullptr){
+        FILE* file = fopen(output, "wb");
+        if (file == nullptr){
+            perror(output);
+            return 1;
+        }
+        fwrite(CAPTURE_FILE_MAGIC, 1, sizeof(CAPTURE_FILE_MAGIC), file);
+        fwrite(ring.data(), 1, ring.size(), file);
+        fclose(file);
+    }
+
+    size_t received = std::count_if(records.begin(), records.end(), [](const Record& record){ return record.direction == CAPTURE_RX; });
+    double span_ms = (records.back().timestamp_us - records.front().timestamp_us) / 1e3;
+    printf("%zu records over %.1fms: %zu received, %zu sent", records.size(), span_ms, received, records.size() - received);
+    if (dropped > 0) printf(", %u dropped on the device before the dump", dropped);
+    printf("\n");
+
+    Replay replay;
+    replay_records(records, realtime, realtime ? 1 : repeats, chunk, replay);
+
+    printf("replayed %zu frames (%zu bad crc, %zu bad arguments, %zu not whole packets) in %.2fms: %.0f frames/s, %.2f MB/s\n",
+        replay.frames, replay.bad_crc, replay.bad_arguments, replay.skipped, replay.total_ns / 1e6,
+        replay.frames * 1e9 / std::max<int64_t>(1, replay.total_ns), replay.bytes * 1e3 / std::max<int64_t>(1, replay.total_ns));
+
+    for (int i = 0; i < STAGE_COUNT; i++) print_stage(stage_names[i], replay.stage_ns[i]);
+
+    if (realtime && !replay.late_ns.empty()){
+        std::sort(replay.late_ns.begin(), replay.late_ns.end());
+        printf("  behind the capture p99 %.3fms\n", replay.late_ns[replay.late_ns.size() * 99 / 100] / 1e6);
+    }
+
+    if (log_messages > 0) printf("%d log messages from parse_argument\n", log_messages);
+
+    return 0;
+}
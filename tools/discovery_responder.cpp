@@ -0,0 +1,90 @@
+// answers the discovery queries devices broadcast at boot, standing in for the server.
+// Each query is printed with the name of the device that sent it
+//
+// usage: discovery_responder [tcp port] [udp port]   the ports handed to devices, default 15000 and 15001.
+//                                                    Devices connect to the address the answer comes from
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+#include "bece_protocol.h"
+#include "Discovery/Discovery.h"
+
+std::vector<uint8_t> build_reply(uint32_t packet_id, uint16_t tcp_port, uint16_t udp_port){
+    uint8_t payload[2 * (1 + sizeof(uint16_t))] = {Argument::UINT16};
+    memcpy(payload + 1, &tcp_port, sizeof(tcp_port));
+    payload[1 + sizeof(uint16_t)] = Argument::UINT16;
+    memcpy(payload + 2 + sizeof(uint16_t), &udp_port, sizeof(udp_port));
+
+    PacketHeader header = {MAGIC, COMMAND_SET, bece::DISCOVERY_REPLY, packet_id, 0, 1, sizeof(payload), 2};
+    std::vector<uint8_t> frame(sizeof(header) + sizeof(payload) + sizeof(uint16_t));
+    memcpy(frame.data(), &header, sizeof(header));
+    memcpy(frame.data() + sizeof(header), payload, sizeof(payload));
+
+    uint16_t crc = bece::crc16(frame.data(), sizeof(header) + sizeof(payload));
+    memcpy(frame.data() + sizeof(header) + sizeof(payload), &crc, sizeof(crc));
+    return frame;
+}
+
+// the device name from the query's STRING argument
+bool query_name(const uint8_t* frame, size_t length, char* name, size_t size){
+    const PacketHeader* header = (const PacketHeader*)frame;
+    if (!bece::valid_frame(frame, length) || header->type != bece::DISCOVERY_QUERY) return false;
+
+    const uint8_t* payload = frame + sizeof(PacketHeader);
+    uint16_t name_length;
+    if (header->payload_len < 1 + sizeof(name_length) || payload[0] != Argument::STRING) return false;
+    memcpy(&name_length, payload + 1, sizeof(name_length));
+    if (1 + sizeof(name_length) + name_length > header->payload_len) return false;
+
+    size_t copied = name_length < size - 1 ? name_length : size - 1;
+    memcpy(name, payload + 1 + sizeof(name_length), copied);
+    name[copied] = '\0';
+    return true;
+}
+
+int main(int argc, char** argv){
+    uint16_t tcp_port = argc > 1 ? atoi(argv[1]) : 15000;
+    uint16_t udp_port = argc > 2 ? atoi(argv[2]) : 15001;
+
+    int sock = socket(AF_INET, SOCK_DGRAM, 0);
+    int one = 1;
+    setsockopt(sock, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+
+    sockaddr_in address = {};
+    address.sin_family = AF_INET;
+    address.sin_port = htons(DISCOVERY_PORT);
+    address.sin_addr.s_addr = htonl(INADDR_ANY);
+    if (bind(sock, (sockaddr*)&address, sizeof(address)) != 0){
+        perror("bind");
+        return 1;
+    }
+
+    printf("answering discovery on port %d with tcp %d, udp %d\n", DISCOVERY_PORT, tcp_port, udp_port);
+
+    uint8_t datagram[2048];
+    while (true){
+        sockaddr_in from;
+        socklen_t from_length = sizeof(from);
+        ssize_t length = recvfrom(sock, datagram, sizeof(datagram), 0, (sockaddr*)&from, &from_length);
+        if (length <= 0) continue;
+
+        char name[64];
+        if (!query_name(datagram, length, name, sizeof(name))) continue;
+
+        // answer to where the query came from, the device listens there
+        std::vector<uint8_t> reply = build_reply(((const PacketHeader*)datagram)->packet_id, tcp_port, udp_port);
+        sendto(sock, reply.data(), reply.size(), 0, (sockaddr*)&from, from_length);
+
+        char from_ip[INET_ADDRSTRLEN];
+        inet_ntop(AF_INET, &from.sin_addr, from_ip, sizeof(from_ip));
+        printf("%s asked from %s\n", name, from_ip);
+        fflush(stdout);
+    }
+}
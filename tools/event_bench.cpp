@@ -0,0 +1,264 @@
+// runs the device's receive path (PacketParser fed from an EventSource) against a simulated server on loopback.
+// Checks packets split at random points and surrounded by junk all come through, then compares how long commands
+// wait behind busy loop functions and how much CPU an idle device burns polling against sleeping in wait
+//
+// usage: event_bench
+
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <thread>
+#include <vector>
+
+#include "bece_protocol.h"
+#include "Packet/PacketParser.h"
+#include "Events/Events.h"
+
+const int LOOP_FUNCTIONS = 4;
+const int LOOP_FUNCTION_US = 5000;
+const int COMMANDS = 200;
+const int IDLE_MS = 2000;
+
+// the device end of the socket pair, read by the event source
+int device_sock;
+
+// stands in for the one Events.cpp keeps, which reads the server connection
+EventSource source;
+
+int64_t now_ns(){
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+uint16_t socket_read(uint8_t* buffer, uint16_t size){
+    ssize_t received = recv(device_sock, buffer, size, MSG_DONTWAIT);
+    return received > 0 ? received : 0;
+}
+
+bool socket_wait(uint32_t timeout_ms){
+    pollfd fd = {device_sock, POLLIN, 0};
+    return poll(&fd, 1, timeout_ms) > 0;
+}
+
+// checks the socket without sleeping, like looping on available()
+bool socket_spin(uint32_t timeout_ms){
+    int64_t end = now_ns() + timeout_ms * 1000000LL;
+    pollfd fd = {device_sock, POLLIN, 0};
+    while (now_ns() < end){
+        if (poll(&fd, 1, 0) > 0) return true;
+    }
+    return false;
+}
+
+// a packet as the server sends it, the payload length counts the crc. The payload carries the send time
+std::vector<uint8_t> server_packet(uint32_t packet_id, uint16_t payload_size){
+    payload_size = std::max<uint16_t>(payload_size, sizeof(int64_t));
+    PacketHeader header = {MAGIC, COMMAND_SET, 1, packet_id, 0, 1, (uint16_t)(payload_size + sizeof(uint16_t)), 0};
+
+    std::vector<uint8_t> frame(sizeof(header) + payload_size + sizeof(uint16_t));
+    memcpy(frame.data(), &header, sizeof(header));
+    for (uint16_t i = 0; i < payload_size; i++) frame[sizeof(header) + i] = packet_id + i;
+
+    int64_t sent = now_ns();
+    memcpy(frame.data() + sizeof(header), &sent, sizeof(sent));
+
+    uint16_t crc = bece::crc16(frame.data(), sizeof(header) + payload_size);
+    memcpy(frame.data() + sizeof(header) + payload_size, &crc, sizeof(crc));
+    return frame;
+}
+
+// same check as validate_crc on the device
+bool server_crc_ok(const uint8_t* frame){
+    PacketHeader header;
+    memcpy(&header, frame, sizeof(header));
+
+    uint16_t crc;
+    memcpy(&crc, frame + sizeof(header) + header.payload_len - sizeof(uint16_t), sizeof(crc));
+    return crc == bece::crc16(frame, sizeof(header) + header.payload_len - sizeof(uint16_t));
+}
+
+// reads what has arrived, returns true with a whole packet in the buffer
+bool receive(PacketParser& parser){
+    while (true){
+        uint16_t wanted;
+        uint8_t* next = parser_next(parser, &wanted);
+
+        uint16_t received = source.read(next, wanted);
+        if (received == 0) return false;
+
+        parser_state state = parser_received(parser, received);
+        if (state == PARSER_READY) return true;
+        if (state == PARSER_TOO_LARGE) return false;
+    }
+}
+
+void spin_us(int us){
+    int64_t end = now_ns() + us * 1000LL;
+    while (now_ns() < end){}
+}
+
+int64_t cpu_us(){
+    rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return (usage.ru_utime.tv_sec + usage.ru_stime.tv_sec) * 1000000LL + usage.ru_utime.tv_usec + usage.ru_stime.tv_usec;
+}
+
+void print_latency(const char* name, std::vector<int64_t>& latency){
+    std::sort(latency.begin(), latency.end());
+    printf("%-28s p50 %8.2fms  p99 %8.2fms  max %8.2fms\n", name,
+        latency[latency.size() / 2] / 1e6, latency[latency.size() * 99 / 100] / 1e6, latency.back() / 1e6);
+}
+
+// random sized packets split into random sized writes, with junk between some of them and one too big for the buffer
+bool check_parser(int server_sock){
+    std::mt19937 rng(1);
+    std::vector<uint8_t> stream;
+    std::vector<uint32_t> expected;
+
+    for (uint32_t id = 0; id < 2000; id++){
+        if (id % 97 == 0){
+            // junk the parser has to skip to find the next header
+            for (int i = 0; i < 7; i++) stream.push_back(rng());
+        }
+
+        uint16_t size = id == 500 ? 2000 : rng() % 400;
+        std::vector<uint8_t> frame = server_packet(id, size);
+        stream.insert(stream.end(), frame.begin(), frame.end());
+        if (id != 500) expected.push_back(id);
+    }
+
+    std::thread server([&]{
+        for (size_t sent = 0; sent < stream.size(); ){
+            size_t chunk = std::min<size_t>(1 + rng() % 300, stream.size() - sent);
+            send(server_sock, stream.data() + sent, chunk, 0);
+            sent += chunk;
+        }
+    });
+
+    uint8_t buffer[512];
+    PacketParser parser = {buffer, sizeof(buffer), 0, 0, PARSER_RECEIVING};
+
+    std::vector<uint32_t> received;
+    int bad_crc = 0;
+    int64_t end = now_ns() + 5000000000LL;
+    while (received.size() < expected.size() && now_ns() < end){
+        if (!receive(parser)){
+            source.wait(10);
+            continue;
+        }
+
+        PacketHeader header;
+        memcpy(&header, buffer, sizeof(header));
+        if (!server_crc_ok(buffer)) bad_crc ++;
+        else received.push_back(header.packet_id);
+    }
+    server.join();
+
+    bool ok = received == expected && bad_crc == 0;
+    printf("parser: %zu of %zu packets in order, %d bad crc, oversized packet skipped: %s\n",
+        received.size(), expected.size(), bad_crc, ok ? "ok" : "FAILED");
+    return ok;
+}
+
+// sends commands at random times and measures how long each waits before the device handles it
+void command_latency(int server_sock, bool between_functions){
+    uint8_t buffer[512];
+    PacketParser parser = {buffer, sizeof(buffer), 0, 0, PARSER_RECEIVING};
+
+    std::atomic<bool> done(false);
+    std::thread server([&]{
+        std::mt19937 rng(2);
+        for (uint32_t id = 0; id < COMMANDS; id++){
+            usleep(rng() % (LOOP_FUNCTIONS * LOOP_FUNCTION_US));
+            std::vector<uint8_t> frame = server_packet(id, 16);
+            send(server_sock, frame.data(), frame.size(), 0);
+        }
+        done = true;
+    });
+
+    std::vector<int64_t> latency;
+    auto handle = [&]{
+        while (receive(parser)){
+            int64_t sent;
+            memcpy(&sent, buffer + sizeof(PacketHeader), sizeof(sent));
+            latency.push_back(now_ns() - sent);
+        }
+    };
+
+    while (!done || latency.size() < COMMANDS){
+        // the old loop checked once, then ran every loop function
+        handle();
+        for (int i = 0; i < LOOP_FUNCTIONS; i++){
+            spin_us(LOOP_FUNCTION_US);
+            if (between_functions) handle();
+        }
+    }
+    server.join();
+
+    print_latency(between_functions ? "between loop functions" : "once per loop", latency);
+}
+
+// an idle device: no loop functions, just waiting for the server
+void idle_cpu(int server_sock, const EventSource& idle_source, const char* name){
+    source = idle_source;
+
+    uint8_t buffer[512];
+    PacketParser parser = {buffer, sizeof(buffer), 0, 0, PARSER_RECEIVING};
+
+    std::thread server([&]{
+        for (int i = 0; i < IDLE_MS / 100; i++){
+            usleep(100000);
+            std::vector<uint8_t> frame = server_packet(i, 16);
+            send(server_sock, frame.data(), frame.size(), 0);
+        }
+    });
+
+    std::vector<int64_t> latency;
+    int64_t cpu_start = cpu_us();
+    int64_t wall_start = now_ns();
+    while (latency.size() < IDLE_MS / 100){
+        source.wait(5);
+        while (receive(parser)){
+            int64_t sent;
+            memcpy(&sent, buffer + sizeof(PacketHeader), sizeof(sent));
+            latency.push_back(now_ns() - sent);
+        }
+    }
+    double cpu = (cpu_us() - cpu_start) * 1e3 / (now_ns() - wall_start);
+    server.join();
+
+    printf("%-28s %5.1f%% cpu  ", name, cpu * 100);
+    std::sort(latency.begin(), latency.end());
+    printf("command p50 %6.3fms  max %6.3fms\n", latency[latency.size() / 2] / 1e6, latency.back() / 1e6);
+}
+
+int main(){
+    int socks[2];
+    if (socketpair(AF_UNIX, SOCK_STREAM, 0, socks) != 0){
+        perror("socketpair");
+        return 1;
+    }
+    device_sock = socks[0];
+    int server_sock = socks[1];
+
+    source = {socket_read, socket_wait};
+    bool ok = check_parser(server_sock);
+
+    printf("\ncommand latency with %d loop functions of %dms each\n", LOOP_FUNCTIONS, LOOP_FUNCTION_US / 1000);
+    command_latency(server_sock, false);
+    command_latency(server_sock, true);
+
+    printf("\nidle device for %dms\n", IDLE_MS);
+    idle_cpu(server_sock, {socket_read, socket_spin}, "polling");
+    idle_cpu(server_sock, {socket_read, socket_wait}, "waiting for data");
+
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,220 @@
+// measures how long a device takes to reach a server when some of its servers are down, using the device's
+// ConnectionRace against stand-in servers on loopback. A stand-in is up, refuses connections, or drops them
+// like a crashed host. Also measures how long after the primary comes back the device moves over to it
+//
+// usage: failover_bench
+
+// the device checks every 30s, which would make this slow
+#define PRIMARY_CHECK_MS 500
+
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <random>
+#include <vector>
+
+#include "Connection/ConnectionRace.h"
+
+const uint16_t FIRST_PORT = 26000;
+const int TRIALS = 10;
+
+enum stand_in_mode { UP, REFUSED, DROPPED };
+
+// a stand-in server. Its kernel finishes handshakes for it, so nothing needs to accept
+struct StandIn {
+    uint16_t port;
+    int listener = -1;
+    std::vector<int> fillers;
+};
+
+int64_t now_ms(){
+    return std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+sockaddr_in loopback(uint16_t port){
+    sockaddr_in address = {};
+    address.sin_family = AF_INET;
+    address.sin_port = htons(port);
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    return address;
+}
+
+int connect_nonblocking(uint16_t port){
+    int sock = socket(AF_INET, SOCK_STREAM, 0);
+    fcntl(sock, F_SETFL, O_NONBLOCK);
+    sockaddr_in address = loopback(port);
+    connect(sock, (sockaddr*)&address, sizeof(address));
+    return sock;
+}
+
+void stop(StandIn& server){
+    if (server.listener >= 0) close(server.listener);
+    for (int sock : server.fillers) close(sock);
+    server.listener = -1;
+    server.fillers.clear();
+}
+
+void start(StandIn& server, stand_in_mode mode){
+    stop(server);
+    if (mode == REFUSED) return;
+
+    server.listener = socket(AF_INET, SOCK_STREAM, 0);
+    int one = 1;
+    setsockopt(server.listener, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+    sockaddr_in address = loopback(server.port);
+    if (bind(server.listener, (sockaddr*)&address, sizeof(address)) != 0){
+        perror("bind");
+        exit(1);
+    }
+
+    // with its accept queue full the kernel drops new connections without an answer, like a host that went away
+    listen(server.listener, mode == DROPPED ? 0 : 128);
+    if (mode == DROPPED){
+        for (int i = 0; i < 4; i++) server.fillers.push_back(connect_nonblocking(server.port));
+        usleep(20000);
+    }
+}
+
+// same as the device's esp32 probes
+struct Probe {
+    int fd = -1;
+};
+
+bool probe_done(Probe& probe, bool* connected){
+    pollfd fd = {probe.fd, POLLOUT, 0};
+    if (poll(&fd, 1, 0) <= 0) return false;
+
+    int error = 0;
+    socklen_t length = sizeof(error);
+    getsockopt(probe.fd, SOL_SOCKET, SO_ERROR, &error, &length);
+    *connected = error == 0;
+    return true;
+}
+
+void probe_close(Probe& probe){
+    if (probe.fd >= 0) close(probe.fd);
+    probe.fd = -1;
+}
+
+// runs a race like race_tick does, returns the winner or -1 and how long it took
+int run_race(const std::vector<StandIn>& servers, int64_t* took_ms){
+    ConnectionRace race;
+    Probe probes[RACE_MAX_SERVERS];
+    int64_t begin = now_ms();
+    race_begin(race, servers.size(), 0);
+
+    while (true){
+        uint32_t now = now_ms() - begin;
+
+        int8_t index;
+        while ((index = race_next_start(race, now)) >= 0){
+            probes[index].fd = connect_nonblocking(servers[index].port);
+        }
+
+        for (uint8_t i = 0; i < race.started; i++){
+            bool connected;
+            if (race.attempts[i] == ATTEMPT_PENDING && probe_done(probes[i], &connected)) race_result(race, i, connected);
+        }
+
+        while ((index = race_expired(race, now)) >= 0){
+            probe_close(probes[index]);
+        }
+
+        if (race_status(race) != RACE_RUNNING) break;
+        usleep(1000);
+    }
+
+    *took_ms = now_ms() - begin;
+    for (Probe& probe : probes) probe_close(probe);
+    return race.winner;
+}
+
+void scenario(const char* name, std::vector<StandIn>& servers, std::vector<stand_in_mode> modes){
+    for (size_t i = 0; i < servers.size(); i++) start(servers[i], modes[i]);
+
+    int64_t took;
+    int winner = run_race(servers, &took);
+    if (winner < 0) printf("%-34s no server after %5lldms\n", name, (long long)took);
+    else printf("%-34s server %d after %5lldms\n", name, winner, (long long)took);
+}
+
+// connected to a backup, the primary comes back at a random point between checks
+void migration(std::vector<StandIn>& servers){
+    std::mt19937 rng(3);
+    std::vector<int64_t> moved;
+
+    for (int trial = 0; trial < TRIALS; trial++){
+        start(servers[0], DROPPED);
+        int64_t next_check = now_ms() + PRIMARY_CHECK_MS;
+
+        // the primary restarts at some point during the check interval
+        int64_t restart = now_ms() + rng() % PRIMARY_CHECK_MS;
+        bool restarted = false;
+
+        Probe probe;
+        int64_t probe_started = 0;
+        while (true){
+            int64_t now = now_ms();
+            if (!restarted && now >= restart){
+                start(servers[0], UP);
+                restarted = true;
+            }
+
+            // same as primary_tick
+            if (probe.fd < 0){
+                if (now >= next_check){
+                    probe.fd = connect_nonblocking(servers[0].port);
+                    probe_started = now;
+                }
+            }
+            else {
+                bool connected = false;
+                bool done = probe_done(probe, &connected);
+                if (done || now - probe_started >= CONNECTION_ATTEMPT_TIMEOUT_MS){
+                    probe_close(probe);
+                    next_check = now + PRIMARY_CHECK_MS;
+                    if (done && connected){
+                        moved.push_back(now - restart);
+                        break;
+                    }
+                }
+            }
+
+            usleep(1000);
+        }
+    }
+
+    std::sort(moved.begin(), moved.end());
+    printf("%-34s p50 %5lldms  max %5lldms  (checks every %dms)\n", "back on the primary after restart",
+        (long long)moved[moved.size() / 2], (long long)moved.back(), PRIMARY_CHECK_MS);
+}
+
+int main(){
+    std::vector<StandIn> servers(3);
+    for (size_t i = 0; i < servers.size(); i++) servers[i].port = FIRST_PORT + i;
+
+    printf("stagger %dms, attempt timeout %dms\n", CONNECTION_STAGGER_MS, CONNECTION_ATTEMPT_TIMEOUT_MS);
+    scenario("all up", servers, {UP, UP, UP});
+    scenario("primary refusing", servers, {REFUSED, UP, UP});
+    scenario("primary dropping", servers, {DROPPED, UP, UP});
+    scenario("primary and backup dropping", servers, {DROPPED, DROPPED, UP});
+    scenario("all dropping", servers, {DROPPED, DROPPED, DROPPED});
+
+    // what one server meant before: nothing until it came back
+    std::vector<StandIn> single(servers.begin(), servers.begin() + 1);
+    scenario("single server dropping", single, {DROPPED});
+
+    migration(servers);
+
+    for (StandIn& server : servers) stop(server);
+    return 0;
+}
@@ -0,0 +1,172 @@
+// receives the UDP frame stream from a device, reassembles the frames and reports
+// fps, throughput, losses and latency once a second
+//
+// usage: frame_receiver [port]
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <map>
+#include <vector>
+
+#include "bece_protocol.h"
+#include "FrameStream/FrameStream.h"
+
+// a frame still waiting for fragments
+struct PartialFrame {
+    std::vector<uint8_t> data;
+    std::vector<bool> received;
+    uint16_t fragments_left;
+    uint32_t device_us;
+    int64_t first_arrival_us;
+};
+
+// frames older than this many ids behind the newest are given up on
+const uint32_t REASSEMBLY_WINDOW = 8;
+
+int64_t now_us(){
+    return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+int64_t percentile(std::vector<int64_t>& values, double p){
+    if (values.empty()) return 0;
+
+    size_t index = std::min(values.size() - 1, (size_t)(p * values.size()));
+    std::nth_element(values.begin(), values.begin() + index, values.end());
+    return values[index];
+}
+
+int main(int argc, char** argv){
+    uint16_t port = argc > 1 ? atoi(argv[1]) : 15001;
+
+    int sock = socket(AF_INET, SOCK_DGRAM, 0);
+    int buffer_size = 4 * 1024 * 1024;
+    setsockopt(sock, SOL_SOCKET, SO_RCVBUF, &buffer_size, sizeof(buffer_size));
+
+    sockaddr_in address = {};
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = htonl(INADDR_ANY);
+    address.sin_port = htons(port);
+    if (bind(sock, (sockaddr*)&address, sizeof(address)) != 0){
+        perror("bind");
+        return 1;
+    }
+
+    printf("listening for frames on udp %u\n", port);
+
+    std::map<uint32_t, PartialFrame> partial;
+    bool have_frame = false;
+    uint32_t newest_id = 0;
+
+    // the smallest arrival - device time seen. Latency is reported on top of it
+    bool have_offset = false;
+    int64_t best_offset = 0;
+    uint32_t last_device_us = 0;
+    int64_t device_wraps = 0;
+
+    // counters for the current report
+    uint64_t frames = 0, bytes = 0, incomplete = 0, skipped = 0, bad = 0;
+    std::vector<int64_t> latency, reassembly;
+    int64_t report_start = now_us();
+
+    uint8_t datagram[65536];
+    for (;;){
+        pollfd fd = {sock, POLLIN, 0};
+        if (poll(&fd, 1, 100) > 0){
+            ssize_t length = recv(sock, datagram, sizeof(datagram), 0);
+            int64_t arrival = now_us();
+
+            const PacketHeader* header = (const PacketHeader*)datagram;
+            if (length <= 0 || !bece::valid_frame(datagram, length) || header->type != bece::FRAME_FRAGMENT
+                || header->payload_len < sizeof(FragmentHeader)){
+                bad ++;
+                continue;
+            }
+
+            FragmentHeader fragment;
+            memcpy(&fragment, datagram + sizeof(PacketHeader), sizeof(fragment));
+            const uint8_t* data = datagram + sizeof(PacketHeader) + sizeof(fragment);
+            size_t data_length = header->payload_len - sizeof(fragment);
+
+            // ids jumped over were dropped by the device or lost on the way
+            if (!have_frame || (int32_t)(fragment.frame_id - newest_id) > 0){
+                if (have_frame) skipped += fragment.frame_id - newest_id - 1;
+                newest_id = fragment.frame_id;
+                have_frame = true;
+            }
+
+            // give up on frames that fell out of the window
+            for (auto it = partial.begin(); it != partial.end();){
+                if (newest_id - it->first >= REASSEMBLY_WINDOW){
+                    incomplete ++;
+                    it = partial.erase(it);
+                }
+                else {
+                    ++it;
+                }
+            }
+            if (newest_id - fragment.frame_id >= REASSEMBLY_WINDOW) continue;
+
+            auto found = partial.find(fragment.frame_id);
+            if (found == partial.end()){
+                PartialFrame frame;
+                frame.data.resize(fragment.frame_length);
+                frame.received.assign(fragment.fragment_count, false);
+                frame.fragments_left = fragment.fragment_count;
+                frame.device_us = fragment.timestamp_us;
+                frame.first_arrival_us = arrival;
+                uint32_t frame_id = fragment.frame_id;
+                found = partial.emplace(frame_id, std::move(frame)).first;
+            }
+
+            PartialFrame& frame = found->second;
+            size_t start = (size_t)fragment.fragment_index * FRAME_FRAGMENT_DATA;
+            if (fragment.fragment_index >= frame.received.size() || frame.received[fragment.fragment_index]
+                || start + data_length > frame.data.size()){
+                continue;
+            }
+
+            memcpy(frame.data.data() + start, data, data_length);
+            frame.received[fragment.fragment_index] = true;
+            if (--frame.fragments_left > 0) continue;
+
+            // complete frame. Unwrap the 32 bit device clock
+            if (frame.device_us < last_device_us && last_device_us - frame.device_us > 0x80000000u) device_wraps ++;
+            last_device_us = frame.device_us;
+            int64_t offset = arrival - (int64_t)(device_wraps * 0x100000000LL + frame.device_us);
+
+            if (!have_offset || offset < best_offset){
+                best_offset = offset;
+                have_offset = true;
+            }
+
+            latency.push_back(offset - best_offset);
+            reassembly.push_back(arrival - frame.first_arrival_us);
+            frames ++;
+            bytes += frame.data.size();
+            partial.erase(found);
+        }
+
+        int64_t elapsed = now_us() - report_start;
+        if (elapsed < 1000000) continue;
+
+        double seconds = elapsed / 1e6;
+        printf("%6.1f fps %8.1f kB/s  lost %llu  incomplete %llu  bad %llu  latency p50 %lldus p99 %lldus  reassembly p99 %lldus\n",
+            frames / seconds, bytes / seconds / 1000, (unsigned long long)skipped, (unsigned long long)incomplete,
+            (unsigned long long)bad, (long long)percentile(latency, 0.5), (long long)percentile(latency, 0.99),
+            (long long)percentile(reassembly, 0.99));
+        fflush(stdout);
+
+        frames = bytes = incomplete = skipped = bad = 0;
+        latency.clear();
+        reassembly.clear();
+        report_start = now_us();
+    }
+}
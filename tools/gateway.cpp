@@ -0,0 +1,71 @@
+// terminates device connections and passes their frames to the server over a few upstream connections.
+// See gateway.h for what the server sees. Point devices at this host instead of the server
+//
+// usage: gateway [-p listen port] [-n upstreams] [-b batch us] server ip[:port]
+
+#include <signal.h>
+
+#include <cstdlib>
+#include <thread>
+
+#include "gateway.h"
+
+std::atomic<bool> stop(false);
+
+int main(int argc, char** argv){
+    gateway::Options options;
+
+    int option;
+    while ((option = getopt(argc, argv, "p:n:b:")) != -1){
+        switch (option){
+            case 'p': options.listen_port = atoi(optarg); break;
+            case 'n': options.upstreams = std::max(1, atoi(optarg)); break;
+            case 'b': options.batch_us = std::max(1, atoi(optarg)); break;
+            default:
+                fprintf(stderr, "usage: %s [-p listen port] [-n upstreams] [-b batch us] server ip[:port]\n", argv[0]);
+                return 1;
+        }
+    }
+
+    if (optind >= argc){
+        fprintf(stderr, "usage: %s [-p listen port] [-n upstreams] [-b batch us] server ip[:port]\n", argv[0]);
+        return 1;
+    }
+
+    // the server port defaults to the one devices use
+    char host[64];
+    snprintf(host, sizeof(host), "%s", argv[optind]);
+    uint16_t port = 15000;
+    char* colon = strchr(host, ':');
+    if (colon != nullptr){
+        *colon = '\0';
+        port = atoi(colon + 1);
+    }
+
+    options.server.sin_family = AF_INET;
+    options.server.sin_port = htons(port);
+    if (inet_pton(AF_INET, host, &options.server.sin_addr) != 1){
+        fprintf(stderr, "bad server address %s\n", host);
+        return 1;
+    }
+
+    signal(SIGINT, [](int){ stop = true; });
+    signal(SIGPIPE, SIG_IGN);
+
+    gateway::Gateway gateway;
+    if (!gateway.start(options)) return 1;
+
+    std::thread stats([&]{
+        while (!stop){
+            std::this_thread::sleep_for(std::chrono::seconds(10));
+            gateway::Stats s = gateway.snapshot();
+            printf("devices %llu  frames up %llu in %llu batches  frames down %llu  dropped devices %llu\n",
+                (unsigned long long)s.devices, (unsigned long long)s.frames_up, (unsigned long long)s.batches_up,
+                (unsigned long long)s.frames_down, (unsigned long long)s.dropped_devices);
+        }
+    });
+
+    gateway.run(stop);
+    stats.join();
+    return 0;
+}
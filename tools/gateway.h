@@ -0,0 +1,540 @@
+#pragma once
+
+// a gateway that sits between many devices and the server. Devices connect to it as if it were the server. It sends
+// their frames on over a few upstream connections, batched and tagged with the device they came from, and passes
+// the server's frames back to the right device. Used by the gateway tool and gateway_bench
+//
+// On the upstream connections both sides send GATEWAY_BATCH packets, framed like the packets a device sends (crc
+// after the payload). The payload is a run of [GatewayEntry][frame] with the frames untouched. The server sees
+// a device come and go as ENTRY_OPEN and ENTRY_CLOSE, and can send one frame to every device with ALL_DEVICES.
+// If an upstream connection drops, the devices on it are closed, since the server has forgotten them. The
+// upstream is connected again without blocking the others, backing off while the server stays away. Devices
+// that connect while their upstream is down are turned away and come back through it when they retry
+//
+// Only the TCP connection goes through the gateway. Devices send UDP (send_UDP, the frame stream, reporting and
+// ESTABLISH_UDP) and fetch OTA updates over HTTP from the address they connected to, which is now the gateway
+// host, and none of that reaches the server. Use devices behind it over TCP only, and run an HTTP server for the
+// firmware files (ota_server will do) on the gateway host on OTA_HTTP_PORT
+
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <sys/timerfd.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cstdio>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+#include "bece_protocol.h"
+
+namespace gateway {
+    // only used between the gateway and the server, devices never see it
+    const uint16_t GATEWAY_BATCH = 65280;
+
+    const size_t MAX_BATCH_PAYLOAD = 0xFFFF;
+
+    // the device tag the server uses to send a frame to every device
+    const uint32_t ALL_DEVICES = 0xFFFFFFFF;
+
+    enum entry_kind : uint8_t {
+        ENTRY_FRAME = 0, // a frame to or from the device
+        ENTRY_OPEN  = 1, // a device connected. Followed by its address and port, 6 bytes
+        ENTRY_CLOSE = 2, // a device disconnected, or the server wants it dropped. Nothing follows
+    };
+
+    // in front of everything in a batch
+    struct GatewayEntry {
+        uint32_t device;    // tag the gateway gave the device's connection
+        uint8_t kind;       // entry_kind
+        uint16_t length;    // bytes that follow
+    } __attribute__((packed));
+
+    struct Options {
+        uint16_t listen_port = 15000;
+        sockaddr_in server = {};
+        int upstreams = 2;
+        int batch_us = 500;          // longest a frame waits for others to share its batch
+        size_t batch_bytes = 16384;  // a batch this big goes straight away
+        size_t device_backlog = 65536; // bytes waiting for a device before it counts as stuck and is dropped
+        int reconnect_ms = 100;      // first wait before connecting a lost upstream again, doubled each failure
+        int reconnect_max_ms = 5000;
+    };
+
+    struct Stats {
+        uint64_t devices = 0;         // connected now
+        uint64_t frames_up = 0;
+        uint64_t frames_down = 0;
+        uint64_t batches_up = 0;
+        uint64_t batches_down = 0;
+        uint64_t dropped_devices = 0;
+    };
+
+    enum connection_kind : uint8_t { LISTENER, DEVICE, UPSTREAM, TIMER };
+
+    struct Connection {
+        connection_kind kind;
+        uint32_t device;
+        std::vector<uint8_t> in;
+        std::vector<uint8_t> out;
+        size_t out_sent = 0;
+        bool writable_armed = false;
+    };
+
+    struct Upstream {
+        int fd = -1;                  // -1 while waiting to connect again
+        bool connecting = false;      // a non-blocking connect hasn't finished
+        std::vector<uint8_t> batch;
+        int64_t retry_at_ms = 0;
+        int backoff_ms = 0;
+    };
+
+    class Gateway {
+    public:
+        bool start(const Options& options){
+            this->options = options;
+            epoll = epoll_create1(0);
+
+            listener = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK, 0);
+            int one = 1;
+            setsockopt(listener, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+            sockaddr_in address = {};
+            address.sin_family = AF_INET;
+            address.sin_port = htons(options.listen_port);
+            if (bind(listener, (sockaddr*)&address, sizeof(address)) != 0 || listen(listener, 4096) != 0){
+                perror("gateway listen");
+                return false;
+            }
+            add(listener, LISTENER, 0);
+
+            // nothing is being served yet, so these can block. A server that isn't there is reported straight away
+            upstreams.resize(options.upstreams);
+            for (int i = 0; i < options.upstreams; i++){
+                int sock = socket(AF_INET, SOCK_STREAM, 0);
+                if (connect(sock, (const sockaddr*)&options.server, sizeof(options.server)) != 0){
+                    perror("gateway upstream");
+                    close(sock);
+                    return false;
+                }
+                set_nonblocking(sock);
+                upstreams[i].fd = sock;
+                add(sock, UPSTREAM, i);
+            }
+
+            timer = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK);
+            add(timer, TIMER, 0);
+            return true;
+        }
+
+        void run(const std::atomic<bool>& stop){
+            epoll_event events[256];
+            while (!stop){
+                int count = epoll_wait(epoll, events, 256, 100);
+                for (int i = 0; i < count; i++){
+                    int fd = events[i].data.fd;
+                    if (fd >= (int)connections.size() || connections[fd] == nullptr) continue;
+
+                    switch (connections[fd]->kind){
+                        case LISTENER: accept_devices(); break;
+                        case TIMER: flush_all(); break;
+                        case DEVICE:
+                        case UPSTREAM:
+                            if (connections[fd]->kind == UPSTREAM && upstreams[connections[fd]->device].connecting){
+                                connect_finished(fd);
+                                break;
+                            }
+                            if (events[i].events & EPOLLOUT) write_out(fd);
+                            if (events[i].events & (EPOLLIN | EPOLLHUP | EPOLLERR)) read_in(fd);
+                        break;
+                    }
+                }
+
+                retry_upstreams();
+                publish_stats();
+            }
+
+            publish_stats();
+        }
+
+        // safe to call from another thread while run is going
+        Stats snapshot(){
+            std::lock_guard<std::mutex> lock(stats_mutex);
+            return published_stats;
+        }
+
+    private:
+        Options options;
+        int epoll = -1;
+        int listener = -1;
+        int timer = -1;
+        bool timer_armed = false;
+        uint32_t next_device = 1;
+
+        // only touched by the thread in run, copied to published_stats for snapshot after every wakeup
+        Stats stats;
+        Stats published_stats;
+        std::mutex stats_mutex;
+
+        std::vector<Connection*> connections;
+        std::unordered_map<uint32_t, int> devices;
+        std::vector<Upstream> upstreams;
+
+        static void set_nonblocking(int fd){
+            fcntl(fd, F_SETFL, fcntl(fd, F_GETFL, 0) | O_NONBLOCK);
+            int one = 1;
+            setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+        }
+
+        void publish_stats(){
+            std::lock_guard<std::mutex> lock(stats_mutex);
+            published_stats = stats;
+        }
+
+        static int64_t now_ms(){
+            return std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+        }
+
+        bool upstream_up(size_t upstream){
+            return upstreams[upstream].fd >= 0 && !upstreams[upstream].connecting;
+        }
+
+        void retry_upstreams(){
+            int64_t now = now_ms();
+            for (size_t i = 0; i < upstreams.size(); i++){
+                if (upstreams[i].fd < 0 && now >= upstreams[i].retry_at_ms) connect_upstream(i);
+            }
+        }
+
+        // starts a connect and leaves it to finish in run, the other upstreams and devices keep being served
+        void connect_upstream(size_t upstream){
+            int sock = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK, 0);
+            int result = connect(sock, (const sockaddr*)&options.server, sizeof(options.server));
+            if (result != 0 && errno != EINPROGRESS){
+                close(sock);
+                connect_failed(upstream, errno);
+                return;
+            }
+
+            int one = 1;
+            setsockopt(sock, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+            upstreams[upstream].fd = sock;
+            upstreams[upstream].connecting = true;
+            add(sock, UPSTREAM, upstream);
+
+            // writable once the connect has finished one way or the other
+            watch_writable(sock, true);
+        }
+
+        void connect_finished(int fd){
+            size_t upstream = connections[fd]->device;
+
+            int error = 0;
+            socklen_t length = sizeof(error);
+            getsockopt(fd, SOL_SOCKET, SO_ERROR, &error, &length);
+            if (error != 0){
+                close_connection(fd);
+                connect_failed(upstream, error);
+                return;
+            }
+
+            fprintf(stderr, "gateway: upstream connection %zu connected again\n", upstream);
+            upstreams[upstream].connecting = false;
+            upstreams[upstream].backoff_ms = 0;
+            watch_writable(fd, false);
+        }
+
+        void connect_failed(size_t upstream, int error){
+            // waits twice as long each time the server still isn't there
+            Upstream& up = upstreams[upstream];
+            up.fd = -1;
+            up.connecting = false;
+            up.backoff_ms = std::min(std::max(up.backoff_ms * 2, options.reconnect_ms), options.reconnect_max_ms);
+            up.retry_at_ms = now_ms() + up.backoff_ms;
+
+            fprintf(stderr, "gateway: upstream connection %zu: %s, trying again in %dms\n", upstream, strerror(error), up.backoff_ms);
+        }
+
+        void add(int fd, connection_kind kind, uint32_t device){
+            if (fd >= (int)connections.size()) connections.resize(fd + 1, nullptr);
+            connections[fd] = new Connection{kind, device, {}, {}};
+
+            epoll_event event = {};
+            event.events = EPOLLIN;
+            event.data.fd = fd;
+            epoll_ctl(epoll, EPOLL_CTL_ADD, fd, &event);
+        }
+
+        void accept_devices(){
+            sockaddr_in peer;
+            socklen_t peer_length = sizeof(peer);
+            int fd;
+            while ((fd = accept4(listener, (sockaddr*)&peer, &peer_length, SOCK_NONBLOCK)) >= 0){
+                int one = 1;
+                setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+
+                uint32_t device = next_device++;
+                if (next_device == ALL_DEVICES) next_device = 1;
+
+                // the server can't be told about it until its upstream is back
+                if (!upstream_up(device % upstreams.size())){
+                    close(fd);
+                    peer_length = sizeof(peer);
+                    continue;
+                }
+
+                add(fd, DEVICE, device);
+                devices[device] = fd;
+                stats.devices ++;
+
+                // the server gets the address the device connected from
+                uint8_t address[6];
+                memcpy(address, &peer.sin_addr.s_addr, 4);
+                memcpy(address + 4, &peer.sin_port, 2);
+                queue_up(device, ENTRY_OPEN, address, sizeof(address));
+                peer_length = sizeof(peer);
+            }
+        }
+
+        void close_connection(int fd){
+            Connection* connection = connections[fd];
+            connection_kind kind = connection->kind;
+            uint32_t device = connection->device;
+            if (kind == DEVICE){
+                devices.erase(device);
+                stats.devices --;
+                queue_up(device, ENTRY_CLOSE, nullptr, 0);
+            }
+
+            epoll_ctl(epoll, EPOLL_CTL_DEL, fd, nullptr);
+            close(fd);
+            delete connection;
+            connections[fd] = nullptr;
+
+            if (kind == UPSTREAM && upstream_up(device)) upstream_closed(device);
+        }
+
+        // the server forgot every device on the upstream, so they're closed before it is connected again. Its fd
+        // is taken out first, it can be handed to the next socket opened
+        void upstream_closed(size_t upstream){
+            fprintf(stderr, "gateway: upstream connection %zu closed, reconnecting\n", upstream);
+            Upstream& up = upstreams[upstream];
+            up.fd = -1;
+            up.batch.clear();
+
+            std::vector<int> stranded;
+            for (const auto& device : devices){
+                if (device.first % upstreams.size() == upstream) stranded.push_back(device.second);
+            }
+            for (int device_fd : stranded) close_connection(device_fd);
+
+            // straight away the first time, the server may only have dropped this one connection
+            up.backoff_ms = 0;
+            up.retry_at_ms = now_ms();
+        }
+
+        void read_in(int fd){
+            Connection* connection = connections[fd];
+            uint8_t chunk[65536];
+
+            while (true){
+                ssize_t received = read(fd, chunk, sizeof(chunk));
+                if (received == 0 || (received < 0 && errno != EAGAIN && errno != EINTR)){
+                    close_connection(fd);
+                    return;
+                }
+                if (received < 0) break;
+
+                connection->in.insert(connection->in.end(), chunk, chunk + received);
+                if (received < (ssize_t)sizeof(chunk)) break;
+            }
+
+            // both sides frame the way a device sends, so one loop splits them
+            std::vector<uint8_t>& in = connection->in;
+            size_t offset = 0;
+            while (in.size() - offset >= sizeof(PacketHeader)){
+                PacketHeader header;
+                memcpy(&header, in.data() + offset, sizeof(header));
+
+                // nothing after a bad header can be trusted
+                if (header.magic != MAGIC){
+                    close_connection(fd);
+                    return;
+                }
+
+                size_t length = sizeof(PacketHeader) + header.payload_len + sizeof(uint16_t);
+                if (in.size() - offset < length) break;
+
+                if (connection->kind == DEVICE){
+                    stats.frames_up ++;
+                    queue_up(connection->device, ENTRY_FRAME, in.data() + offset, length);
+                }
+                else {
+                    handle_batch(in.data() + offset, length);
+                }
+                offset += length;
+            }
+
+            in.erase(in.begin(), in.begin() + offset);
+        }
+
+        // a frame for the server goes in the batch of the upstream its device always uses, so its frames stay in order
+        void queue_up(uint32_t device, entry_kind kind, const uint8_t* data, uint16_t length){
+            size_t upstream = device % upstreams.size();
+            std::vector<uint8_t>& batch = upstreams[upstream].batch;
+
+            // the upstream is being replaced and the server doesn't know the device any more
+            if (!upstream_up(upstream)) return;
+
+            // the batch length has to fit the header
+            size_t entry_size = sizeof(GatewayEntry) + length;
+            if (entry_size > MAX_BATCH_PAYLOAD) return;
+            if (!batch.empty() && batch.size() - sizeof(PacketHeader) + entry_size > MAX_BATCH_PAYLOAD) flush(upstream);
+            if (batch.empty()) batch.resize(sizeof(PacketHeader));
+
+            GatewayEntry entry = {device, kind, length};
+            const uint8_t* entry_bytes = (const uint8_t*)&entry;
+            batch.insert(batch.end(), entry_bytes, entry_bytes + sizeof(entry));
+            batch.insert(batch.end(), data, data + length);
+
+            if (batch.size() >= options.batch_bytes) flush(upstream);
+            else arm_timer();
+        }
+
+        void arm_timer(){
+            if (timer_armed) return;
+
+            itimerspec when = {};
+            when.it_value.tv_nsec = options.batch_us * 1000L;
+            timerfd_settime(timer, 0, &when, nullptr);
+            timer_armed = true;
+        }
+
+        void flush_all(){
+            uint64_t expirations;
+            while (read(timer, &expirations, sizeof(expirations)) > 0){}
+            timer_armed = false;
+
+            for (size_t i = 0; i < upstreams.size(); i++){
+                if (!upstreams[i].batch.empty()) flush(i);
+            }
+        }
+
+        void flush(size_t upstream){
+            std::vector<uint8_t>& batch = upstreams[upstream].batch;
+            uint16_t payload_length = batch.size() - sizeof(PacketHeader);
+
+            PacketHeader header = {MAGIC, COMMAND_SET, GATEWAY_BATCH, (uint32_t)stats.batches_up, 0, 1, payload_length, 0};
+            memcpy(batch.data(), &header, sizeof(header));
+
+            uint16_t crc = bece::crc16(batch.data(), batch.size());
+            const uint8_t* crc_bytes = (const uint8_t*)&crc;
+            batch.insert(batch.end(), crc_bytes, crc_bytes + sizeof(crc));
+
+            stats.batches_up ++;
+            send_to(upstreams[upstream].fd, batch.data(), batch.size());
+            batch.clear();
+        }
+
+        void handle_batch(const uint8_t* frame, size_t length){
+            if (!bece::valid_frame(frame, length)) return;
+
+            PacketHeader header;
+            memcpy(&header, frame, sizeof(header));
+            if (header.type != GATEWAY_BATCH) return;
+            stats.batches_down ++;
+
+            const uint8_t* payload = frame + sizeof(PacketHeader);
+            for (size_t offset = 0; offset + sizeof(GatewayEntry) <= header.payload_len;){
+                GatewayEntry entry;
+                memcpy(&entry, payload + offset, sizeof(entry));
+                offset += sizeof(entry);
+                if (offset + entry.length > header.payload_len) return;
+
+                const uint8_t* data = payload + offset;
+                offset += entry.length;
+
+                if (entry.device == ALL_DEVICES && entry.kind == ENTRY_FRAME){
+                    // a device too far behind is closed while sending, which would change the map under us
+                    std::vector<int> targets;
+                    targets.reserve(devices.size());
+                    for (const auto& device : devices) targets.push_back(device.second);
+
+                    for (int fd : targets){
+                        stats.frames_down ++;
+                        send_to(fd, data, entry.length);
+                    }
+                    continue;
+                }
+
+                auto device = devices.find(entry.device);
+                if (device == devices.end()) continue;
+
+                if (entry.kind == ENTRY_CLOSE){
+                    close_connection(device->second);
+                    continue;
+                }
+
+                stats.frames_down ++;
+                send_to(device->second, data, entry.length);
+            }
+        }
+
+        void send_to(int fd, const uint8_t* data, size_t length){
+            Connection* connection = connections[fd];
+            if (connection == nullptr) return;
+
+            // straight out if nothing is waiting, otherwise behind what is
+            size_t written = 0;
+            if (connection->out.size() == connection->out_sent){
+                connection->out.clear();
+                connection->out_sent = 0;
+
+                ssize_t result = write(fd, data, length);
+                if (result > 0) written = result;
+            }
+
+            if (written == length) return;
+
+            if (connection->kind == DEVICE && connection->out.size() - connection->out_sent + length - written > options.device_backlog){
+                stats.dropped_devices ++;
+                close_connection(fd);
+                return;
+            }
+
+            connection->out.insert(connection->out.end(), data + written, data + length);
+            watch_writable(fd, true);
+        }
+
+        void write_out(int fd){
+            Connection* connection = connections[fd];
+            while (connection->out_sent < connection->out.size()){
+                ssize_t result = write(fd, connection->out.data() + connection->out_sent, connection->out.size() - connection->out_sent);
+                if (result <= 0) return;
+                connection->out_sent += result;
+            }
+
+            connection->out.clear();
+            connection->out_sent = 0;
+            watch_writable(fd, false);
+        }
+
+        void watch_writable(int fd, bool watch){
+            Connection* connection = connections[fd];
+            if (connection->writable_armed == watch) return;
+
+            epoll_event event = {};
+            event.events = EPOLLIN | (watch ? (uint32_t)EPOLLOUT : 0u);
+            event.data.fd = fd;
+            epoll_ctl(epoll, EPOLL_CTL_MOD, fd, &event);
+            connection->writable_armed = watch;
+        }
+    };
+}
@@ -0,0 +1,393 @@
+// simulated devices pinging a stand-in server, once connected straight to it and once through the gateway in gateway.h.
+// Reports round trips for both, so the difference is what the gateway adds, the gateway's CPU use and from that
+// how many connections one core can carry, and how long a command sent to every device takes to reach them all
+//
+// usage: gateway_bench [-d devices] [-r pings per device per second] [-s seconds] [-n upstreams] [-b batch us]
+
+#include <sys/resource.h>
+
+#include <csignal>
+
+#include <algorithm>
+#include <cstdlib>
+#include <queue>
+#include <thread>
+
+#include "gateway.h"
+
+const uint16_t SERVER_PORT = 27000;
+const uint16_t GATEWAY_PORT = 27001;
+
+// the device pings the server and the server answers with the same payload, the server broadcasts on its own
+const uint16_t PING = 1;
+const uint16_t BROADCAST = 2;
+
+struct Ping {
+    int64_t sent_ns;
+    uint32_t device;
+} __attribute__((packed));
+
+int64_t now_ns(){
+    timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec * 1000000000LL + now.tv_nsec;
+}
+
+int64_t thread_cpu_ns(){
+    timespec now;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &now);
+    return now.tv_sec * 1000000000LL + now.tv_nsec;
+}
+
+sockaddr_in loopback(uint16_t port){
+    sockaddr_in address = {};
+    address.sin_family = AF_INET;
+    address.sin_port = htons(port);
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    return address;
+}
+
+// framed the way a device sends, crc after the payload
+std::vector<uint8_t> device_frame(uint16_t type, const void* payload, uint16_t length){
+    PacketHeader header = {MAGIC, COMMAND_SET, type, 0, 0, 1, length, 0};
+    std::vector<uint8_t> frame(sizeof(header) + length + sizeof(uint16_t));
+    memcpy(frame.data(), &header, sizeof(header));
+    memcpy(frame.data() + sizeof(header), payload, length);
+    uint16_t crc = bece::crc16(frame.data(), sizeof(header) + length);
+    memcpy(frame.data() + sizeof(header) + length, &crc, sizeof(crc));
+    return frame;
+}
+
+// framed the way the server sends, the payload length counts the crc
+std::vector<uint8_t> server_frame(uint16_t type, const void* payload, uint16_t length){
+    std::vector<uint8_t> frame = device_frame(type, payload, length);
+    PacketHeader header;
+    memcpy(&header, frame.data(), sizeof(header));
+    header.payload_len += sizeof(uint16_t);
+    memcpy(frame.data(), &header, sizeof(header));
+
+    uint16_t crc = bece::crc16(frame.data(), sizeof(header) + length);
+    memcpy(frame.data() + sizeof(header) + length, &crc, sizeof(crc));
+    return frame;
+}
+
+void add_entry(std::vector<uint8_t>& batch, uint32_t device, const std::vector<uint8_t>& frame){
+    gateway::GatewayEntry entry = {device, gateway::ENTRY_FRAME, (uint16_t)frame.size()};
+    batch.insert(batch.end(), (uint8_t*)&entry, (uint8_t*)&entry + sizeof(entry));
+    batch.insert(batch.end(), frame.begin(), frame.end());
+}
+
+void write_all(int fd, const std::vector<uint8_t>& data){
+    for (size_t sent = 0; sent < data.size();){
+        ssize_t result = write(fd, data.data() + sent, data.size() - sent);
+        if (result > 0) sent += result;
+        else if (errno != EAGAIN && errno != EINTR) return;
+    }
+}
+
+// the stand-in server. Devices connect straight to it, or gateways connect with batches
+void server(int listener, bool through_gateway, std::atomic<bool>& broadcast, const std::atomic<bool>& stop){
+    int epoll = epoll_create1(0);
+    epoll_event event = {};
+    event.events = EPOLLIN;
+    event.data.fd = listener;
+    epoll_ctl(epoll, EPOLL_CTL_ADD, listener, &event);
+
+    std::vector<std::vector<uint8_t>> buffers;
+    std::vector<int> clients;
+    uint8_t chunk[65536];
+    epoll_event events[256];
+
+    while (!stop){
+        if (broadcast.exchange(false)){
+            Ping ping = {now_ns(), 0};
+            std::vector<uint8_t> command = server_frame(BROADCAST, &ping, sizeof(ping));
+
+            // one entry for every device, or one frame to each connection
+            if (through_gateway){
+                std::vector<uint8_t> batch(sizeof(PacketHeader));
+                add_entry(batch, gateway::ALL_DEVICES, command);
+                std::vector<uint8_t> packet = device_frame(gateway::GATEWAY_BATCH, batch.data() + sizeof(PacketHeader), batch.size() - sizeof(PacketHeader));
+                write_all(clients.front(), packet);
+            }
+            else {
+                for (int fd : clients) write_all(fd, command);
+            }
+        }
+
+        int count = epoll_wait(epoll, events, 256, 5);
+        for (int i = 0; i < count; i++){
+            int fd = events[i].data.fd;
+            if (fd == listener){
+                int client;
+                while ((client = accept4(listener, nullptr, nullptr, 0)) >= 0){
+                    int one = 1;
+                    setsockopt(client, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+                    fcntl(client, F_SETFL, O_NONBLOCK);
+                    if (client >= (int)buffers.size()) buffers.resize(client + 1);
+                    clients.push_back(client);
+
+                    epoll_event client_event = {};
+                    client_event.events = EPOLLIN;
+                    client_event.data.fd = client;
+                    epoll_ctl(epoll, EPOLL_CTL_ADD, client, &client_event);
+                }
+                continue;
+            }
+
+            ssize_t received;
+            std::vector<uint8_t>& in = buffers[fd];
+            while ((received = read(fd, chunk, sizeof(chunk))) > 0) in.insert(in.end(), chunk, chunk + received);
+
+            // answer every ping, the replies to one read of a gateway go back in one batch
+            std::vector<uint8_t> replies(sizeof(PacketHeader));
+            size_t offset = 0;
+            while (in.size() - offset >= sizeof(PacketHeader)){
+                PacketHeader header;
+                memcpy(&header, in.data() + offset, sizeof(header));
+                size_t length = sizeof(header) + header.payload_len + sizeof(uint16_t);
+                if (in.size() - offset < length) break;
+
+                const uint8_t* payload = in.data() + offset + sizeof(header);
+                if (!through_gateway && header.type == PING){
+                    write_all(fd, server_frame(PING, payload, header.payload_len));
+                }
+                else if (through_gateway && header.type == gateway::GATEWAY_BATCH){
+                    for (size_t at = 0; at + sizeof(gateway::GatewayEntry) <= header.payload_len;){
+                        gateway::GatewayEntry entry;
+                        memcpy(&entry, payload + at, sizeof(entry));
+                        at += sizeof(entry);
+
+                        PacketHeader inner;
+                        memcpy(&inner, payload + at, sizeof(inner));
+                        if (entry.kind == gateway::ENTRY_FRAME && inner.type == PING){
+                            add_entry(replies, entry.device, server_frame(PING, payload + at + sizeof(inner), inner.payload_len));
+                        }
+                        at += entry.length;
+                    }
+                }
+                offset += length;
+            }
+            in.erase(in.begin(), in.begin() + offset);
+
+            if (replies.size() > sizeof(PacketHeader)){
+                write_all(fd, device_frame(gateway::GATEWAY_BATCH, replies.data() + sizeof(PacketHeader), replies.size() - sizeof(PacketHeader)));
+            }
+        }
+    }
+
+    for (int fd : clients) close(fd);
+    close(epoll);
+}
+
+struct Result {
+    std::vector<int64_t> round_trips;
+    std::vector<int64_t> broadcast;
+    int connected = 0;
+};
+
+// the simulated devices, all on one epoll loop. Each pings at its own steady rate
+void devices(uint16_t port, int device_count, int rate, int seconds, std::atomic<bool>& broadcast, Result& result){
+    int epoll = epoll_create1(0);
+    std::vector<int> socks;
+    std::vector<std::vector<uint8_t>> buffers;
+    std::unordered_map<int, uint32_t> device_of;
+
+    sockaddr_in address = loopback(port);
+    for (int i = 0; i < device_count; i++){
+        int sock = socket(AF_INET, SOCK_STREAM, 0);
+        if (connect(sock, (sockaddr*)&address, sizeof(address)) != 0){
+            close(sock);
+            break;
+        }
+        int one = 1;
+        setsockopt(sock, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+        fcntl(sock, F_SETFL, O_NONBLOCK);
+        socks.push_back(sock);
+        device_of[sock] = i;
+
+        epoll_event event = {};
+        event.events = EPOLLIN;
+        event.data.fd = sock;
+        epoll_ctl(epoll, EPOLL_CTL_ADD, sock, &event);
+    }
+    result.connected = socks.size();
+    buffers.resize(socks.size());
+
+    // pings spread evenly over the interval so they don't all go at once
+    int64_t interval = 1000000000LL / rate;
+    typedef std::pair<int64_t, uint32_t> Due;
+    std::priority_queue<Due, std::vector<Due>, std::greater<Due>> schedule;
+    int64_t begin = now_ns() + 200000000LL;
+    for (uint32_t i = 0; i < socks.size(); i++) schedule.push({begin + interval * i / socks.size(), i});
+
+    int64_t end = begin + seconds * 1000000000LL;
+    int64_t broadcast_at = end + 100000000LL;
+    bool broadcast_sent = false;
+
+    uint8_t chunk[65536];
+    epoll_event events[256];
+    while (true){
+        int64_t now = now_ns();
+        if (now > broadcast_at + 1000000000LL) break;
+
+        if (!broadcast_sent && now >= broadcast_at){
+            broadcast = true;
+            broadcast_sent = true;
+        }
+
+        while (!schedule.empty() && schedule.top().first <= now){
+            Due due = schedule.top();
+            schedule.pop();
+            if (due.first >= end) continue;
+
+            Ping ping = {now, due.second};
+            write_all(socks[due.second], device_frame(PING, &ping, sizeof(ping)));
+            schedule.push({due.first + interval, due.second});
+        }
+
+        int count = epoll_wait(epoll, events, 256, 1);
+        for (int i = 0; i < count; i++){
+            int fd = events[i].data.fd;
+            std::vector<uint8_t>& in = buffers[device_of[fd]];
+
+            ssize_t received;
+            while ((received = read(fd, chunk, sizeof(chunk))) > 0) in.insert(in.end(), chunk, chunk + received);
+
+            size_t offset = 0;
+            int64_t arrived = now_ns();
+            while (in.size() - offset >= sizeof(PacketHeader)){
+                PacketHeader header;
+                memcpy(&header, in.data() + offset, sizeof(header));
+                size_t length = sizeof(header) + header.payload_len;
+                if (in.size() - offset < length) break;
+
+                Ping ping;
+                memcpy(&ping, in.data() + offset + sizeof(header), sizeof(ping));
+                if (header.type == PING) result.round_trips.push_back(arrived - ping.sent_ns);
+                else if (header.type == BROADCAST) result.broadcast.push_back(arrived - ping.sent_ns);
+                offset += length;
+            }
+            in.erase(in.begin(), in.begin() + offset);
+        }
+    }
+
+    for (int sock : socks) close(sock);
+    close(epoll);
+}
+
+int listen_on(uint16_t port){
+    int listener = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK, 0);
+    int one = 1;
+    setsockopt(listener, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+    sockaddr_in address = loopback(port);
+    if (bind(listener, (sockaddr*)&address, sizeof(address)) != 0 || listen(listener, 4096) != 0){
+        perror("listen");
+        exit(1);
+    }
+    return listener;
+}
+
+int64_t percentile(std::vector<int64_t>& values, int percent){
+    if (values.empty()) return 0;
+    std::sort(values.begin(), values.end());
+    return values[std::min(values.size() - 1, values.size() * percent / 100)];
+}
+
+void print_result(const char* name, Result& result){
+    printf("%-16s %5d devices  %7zu round trips  p50 %7.3fms  p99 %7.3fms   broadcast reached all in %7.3fms\n",
+        name, result.connected, result.round_trips.size(), percentile(result.round_trips, 50) / 1e6,
+        percentile(result.round_trips, 99) / 1e6, percentile(result.broadcast, 100) / 1e6);
+}
+
+Result run(bool through_gateway, int device_count, int rate, int seconds, const gateway::Options& options, gateway::Stats* stats, double* gateway_cpu){
+    std::atomic<bool> stop(false);
+    std::atomic<bool> broadcast(false);
+
+    int listener = listen_on(SERVER_PORT);
+    std::thread server_thread(server, listener, through_gateway, std::ref(broadcast), std::cref(stop));
+
+    gateway::Gateway gateway;
+    std::thread gateway_thread;
+    int64_t gateway_cpu_ns = 0;
+    if (through_gateway){
+        if (!gateway.start(options)) exit(1);
+        gateway_thread = std::thread([&]{
+            int64_t start = thread_cpu_ns();
+            gateway.run(stop);
+            gateway_cpu_ns = thread_cpu_ns() - start;
+        });
+    }
+
+    Result result;
+    int64_t begin = now_ns();
+    devices(through_gateway ? GATEWAY_PORT : SERVER_PORT, device_count, rate, seconds, broadcast, result);
+    int64_t wall = now_ns() - begin;
+
+    stop = true;
+    server_thread.join();
+    if (through_gateway){
+        gateway_thread.join();
+        *stats = gateway.snapshot();
+        *gateway_cpu = (double)gateway_cpu_ns / wall;
+    }
+    close(listener);
+    return result;
+}
+
+int main(int argc, char** argv){
+    int device_count = 2000;
+    int rate = 5;
+    int seconds = 5;
+    gateway::Options options;
+
+    int option;
+    while ((option = getopt(argc, argv, "d:r:s:n:b:")) != -1){
+        switch (option){
+            case 'd': device_count = std::max(1, atoi(optarg)); break;
+            case 'r': rate = std::max(1, atoi(optarg)); break;
+            case 's': seconds = std::max(1, atoi(optarg)); break;
+            case 'n': options.upstreams = std::max(1, atoi(optarg)); break;
+            case 'b': options.batch_us = std::max(1, atoi(optarg)); break;
+            default:
+                fprintf(stderr, "usage: %s [-d devices] [-r pings per device per second] [-s seconds] [-n upstreams] [-b batch us]\n", argv[0]);
+                return 1;
+        }
+    }
+
+    // a few descriptors per device: its socket, the gateway's and the server's
+    rlimit files;
+    getrlimit(RLIMIT_NOFILE, &files);
+    files.rlim_cur = files.rlim_max;
+    setrlimit(RLIMIT_NOFILE, &files);
+    signal(SIGPIPE, SIG_IGN);
+
+    options.listen_port = GATEWAY_PORT;
+    options.server = loopback(SERVER_PORT);
+
+    printf("%d devices pinging %d times a second for %ds, %d upstreams, batches wait up to %dus\n",
+        device_count, rate, seconds, options.upstreams, options.batch_us);
+
+    gateway::Stats stats;
+    double gateway_cpu = 0;
+    Result direct = run(false, device_count, rate, seconds, options, &stats, &gateway_cpu);
+    Result through = run(true, device_count, rate, seconds, options, &stats, &gateway_cpu);
+
+    print_result("direct", direct);
+    print_result("through gateway", through);
+
+    printf("added latency    p50 %7.3fms  p99 %7.3fms\n",
+        (percentile(through.round_trips, 50) - percentile(direct.round_trips, 50)) / 1e6,
+        (percentile(through.round_trips, 99) - percentile(direct.round_trips, 99)) / 1e6);
+
+    printf("server sockets   %d direct, %d through the gateway\n", direct.connected, options.upstreams);
+    printf("gateway          %.1f%% of a core, %.1f frames per upstream batch, %llu devices dropped\n",
+        gateway_cpu * 100, stats.batches_up > 0 ? (double)stats.frames_up / stats.batches_up : 0.0,
+        (unsigned long long)stats.dropped_devices);
+    if (gateway_cpu > 0){
+        printf("                 about %.0f connections per core at %d pings per device per second\n",
+            through.connected / gateway_cpu, rate);
+    }
+
+    return 0;
+}
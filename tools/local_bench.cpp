@@ -0,0 +1,250 @@
+// measures command round trips over the device's local control port against going through the server.
+//
+// usage: local_bench                         both paths simulated on loopback
+//        local_bench <device ip> <command>   real device, sends the command id to its local port. It has to be
+//                                            one of the device's own visible commands, the built in ones are
+//                                            refused locally. This host must be in the device's Local Peers list
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <thread>
+#include <vector>
+
+#include "bece_protocol.h"
+#include "Local/Local.h"
+
+const uint16_t SIM_SERVER_PORT = 25000;
+const uint16_t SIM_DEVICE_PORT = 25002;
+const int ROUND_TRIPS = 5000;
+
+// the simulated device answers any id. A real one only runs its own commands for local peers
+const uint16_t SIMULATED_COMMAND = 1;
+
+int64_t now_ns(){
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+sockaddr_in address_of(const char* ip, uint16_t port){
+    sockaddr_in address = {};
+    address.sin_family = AF_INET;
+    address.sin_port = htons(port);
+    inet_pton(AF_INET, ip, &address.sin_addr);
+    return address;
+}
+
+// a framed packet with typed arguments already encoded in payload
+std::vector<uint8_t> build_frame(uint16_t type, uint32_t packet_id, const uint8_t* payload, uint16_t length, uint8_t arguments){
+    PacketHeader header = {MAGIC, COMMAND_SET, type, packet_id, 0, 1, length, arguments};
+    std::vector<uint8_t> frame(sizeof(header) + length + sizeof(uint16_t));
+    memcpy(frame.data(), &header, sizeof(header));
+    if (length > 0) memcpy(frame.data() + sizeof(header), payload, length);
+
+    uint16_t crc = bece::crc16(frame.data(), sizeof(header) + length);
+    memcpy(frame.data() + sizeof(header) + length, &crc, sizeof(crc));
+    return frame;
+}
+
+// the REPLY the device sends for a command
+std::vector<uint8_t> build_reply(uint32_t packet_id){
+    uint8_t payload[1 + sizeof(uint32_t) + 2] = {Argument::UINT32};
+    memcpy(payload + 1, &packet_id, sizeof(packet_id));
+    payload[5] = Argument::UINT8;
+    payload[6] = REPLY_OK;
+    return build_frame(bece::REPLY, packet_id, payload, sizeof(payload), 2);
+}
+
+// the packet id a REPLY answers
+bool reply_id(const uint8_t* frame, size_t length, uint32_t* packet_id){
+    const PacketHeader* header = (const PacketHeader*)frame;
+    if (!bece::valid_frame(frame, length) || header->type != bece::REPLY) return false;
+
+    memcpy(packet_id, frame + sizeof(PacketHeader) + 1, sizeof(*packet_id));
+    return true;
+}
+
+// reads one whole frame from a stream socket
+bool read_frame(int sock, std::vector<uint8_t>& frame){
+    frame.resize(sizeof(PacketHeader));
+    if (recv(sock, frame.data(), sizeof(PacketHeader), MSG_WAITALL) != sizeof(PacketHeader)) return false;
+
+    uint16_t rest = ((const PacketHeader*)frame.data())->payload_len + sizeof(uint16_t);
+    frame.resize(sizeof(PacketHeader) + rest);
+    return recv(sock, frame.data() + sizeof(PacketHeader), rest, MSG_WAITALL) == rest;
+}
+
+int stream_socket(){
+    int sock = socket(AF_INET, SOCK_STREAM, 0);
+    int one = 1;
+    setsockopt(sock, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    setsockopt(sock, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+    return sock;
+}
+
+void print_latency(const char* name, std::vector<int64_t>& latency){
+    if (latency.empty()){
+        printf("%-16s no replies\n", name);
+        return;
+    }
+
+    std::sort(latency.begin(), latency.end());
+    printf("%-16s %5zu round trips  p50 %7.1fus  p99 %7.1fus  max %7.1fus\n", name, latency.size(),
+        latency[latency.size() / 2] / 1e3, latency[latency.size() * 99 / 100] / 1e3, latency.back() / 1e3);
+}
+
+// the device side: answers commands from its local port and from the server connection
+void simulated_device(int server_sock, int local_sock){
+    std::vector<uint8_t> frame;
+    uint8_t datagram[2048];
+
+    pollfd fds[2] = {{server_sock, POLLIN, 0}, {local_sock, POLLIN, 0}};
+    while (poll(fds, 2, -1) > 0){
+        if (fds[0].revents & POLLIN){
+            if (!read_frame(server_sock, frame)) return;
+            std::vector<uint8_t> reply = build_reply(((const PacketHeader*)frame.data())->packet_id);
+            send(server_sock, reply.data(), reply.size(), 0);
+        }
+
+        if (fds[1].revents & POLLIN){
+            sockaddr_in from;
+            socklen_t from_length = sizeof(from);
+            ssize_t length = recvfrom(local_sock, datagram, sizeof(datagram), 0, (sockaddr*)&from, &from_length);
+            if (length <= 0 || !bece::valid_frame(datagram, length)) continue;
+
+            std::vector<uint8_t> reply = build_reply(((const PacketHeader*)datagram)->packet_id);
+            sendto(local_sock, reply.data(), reply.size(), 0, (sockaddr*)&from, from_length);
+        }
+    }
+}
+
+// the server side: forwards client commands to the device and replies back, frame by frame
+void simulated_server(int client_sock, int device_sock){
+    std::vector<uint8_t> frame;
+    while (read_frame(client_sock, frame)){
+        send(device_sock, frame.data(), frame.size(), 0);
+        if (!read_frame(device_sock, frame)) return;
+        send(client_sock, frame.data(), frame.size(), 0);
+    }
+}
+
+void simulate(){
+    // the server listens, the device connects to it like it would with tcp_client, then the client connects
+    int listener = stream_socket();
+    sockaddr_in server_address = address_of("127.0.0.1", SIM_SERVER_PORT);
+    if (bind(listener, (sockaddr*)&server_address, sizeof(server_address)) != 0 || listen(listener, 2) != 0){
+        perror("bind");
+        exit(1);
+    }
+
+    int device_side = stream_socket();
+    connect(device_side, (sockaddr*)&server_address, sizeof(server_address));
+    int server_device_side = accept(listener, nullptr, nullptr);
+
+    int client = stream_socket();
+    connect(client, (sockaddr*)&server_address, sizeof(server_address));
+    int server_client_side = accept(listener, nullptr, nullptr);
+
+    int device_local = socket(AF_INET, SOCK_DGRAM, 0);
+    sockaddr_in local_address = address_of("127.0.0.1", SIM_DEVICE_PORT);
+    bind(device_local, (sockaddr*)&local_address, sizeof(local_address));
+
+    std::thread device(simulated_device, device_side, device_local);
+    std::thread server(simulated_server, server_client_side, server_device_side);
+
+    std::vector<uint8_t> frame;
+
+    // through the server
+    std::vector<int64_t> routed;
+    for (uint32_t id = 0; id < ROUND_TRIPS; id++){
+        std::vector<uint8_t> command = build_frame(SIMULATED_COMMAND, id, nullptr, 0, 0);
+        int64_t start = now_ns();
+        send(client, command.data(), command.size(), 0);
+
+        uint32_t answered;
+        if (read_frame(client, frame) && reply_id(frame.data(), frame.size(), &answered) && answered == id){
+            routed.push_back(now_ns() - start);
+        }
+    }
+
+    // straight to the device
+    int peer = socket(AF_INET, SOCK_DGRAM, 0);
+    connect(peer, (sockaddr*)&local_address, sizeof(local_address));
+
+    std::vector<int64_t> local;
+    uint8_t datagram[2048];
+    for (uint32_t id = 0; id < ROUND_TRIPS; id++){
+        std::vector<uint8_t> command = build_frame(SIMULATED_COMMAND, id, nullptr, 0, 0);
+        int64_t start = now_ns();
+        send(peer, command.data(), command.size(), 0);
+
+        ssize_t length = recv(peer, datagram, sizeof(datagram), 0);
+        uint32_t answered;
+        if (length > 0 && reply_id(datagram, length, &answered) && answered == id){
+            local.push_back(now_ns() - start);
+        }
+    }
+
+    print_latency("via server", routed);
+    print_latency("local control", local);
+
+    // closing the client ends the server thread, which ends the device
+    shutdown(client, SHUT_RDWR);
+    server.join();
+    shutdown(server_device_side, SHUT_RDWR);
+    shutdown(device_side, SHUT_RDWR);
+    device.join();
+}
+
+void real_device(const char* ip, uint16_t command_id){
+    int peer = socket(AF_INET, SOCK_DGRAM, 0);
+    sockaddr_in device_address = address_of(ip, LOCAL_CONTROL_PORT);
+    connect(peer, (sockaddr*)&device_address, sizeof(device_address));
+
+    // ids from the clock so a rerun isn't taken for resends of the last run
+    uint32_t first_id = (uint32_t)(now_ns() / 1000);
+
+    std::vector<int64_t> latency;
+    int lost = 0;
+    uint8_t datagram[2048];
+    for (uint32_t i = 0; i < 200; i++){
+        std::vector<uint8_t> command = build_frame(command_id, first_id + i, nullptr, 0, 0);
+        int64_t start = now_ns();
+        send(peer, command.data(), command.size(), 0);
+
+        // wait for this reply, skipping anything late from an earlier one
+        bool answered = false;
+        pollfd fd = {peer, POLLIN, 0};
+        while (!answered && poll(&fd, 1, 1000) > 0){
+            ssize_t length = recv(peer, datagram, sizeof(datagram), 0);
+            uint32_t id;
+            answered = length > 0 && reply_id(datagram, length, &id) && id == first_id + i;
+        }
+
+        if (answered) latency.push_back(now_ns() - start);
+        else lost ++;
+
+        usleep(10000);
+    }
+
+    print_latency("local control", latency);
+    printf("%d without a reply\n", lost);
+}
+
+int main(int argc, char** argv){
+    if (argc == 3) real_device(argv[1], atoi(argv[2]));
+    else if (argc == 1) simulate();
+    else {
+        fprintf(stderr, "usage: %s [<device ip> <command id>]\n", argv[0]);
+        return 1;
+    }
+
+    return 0;
+}
@@ -0,0 +1,218 @@
+// runs the device's offline log (OfflineLog.cpp) on a file that stands in for the flash partition. Checks frames
+// come back in order after a reboot, a record cut off by a power loss is skipped, a full log drops its oldest
+// sectors and a log that would overlap the config is refused. Then times append and replay
+//
+// usage: offline_bench [frames to time]
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <vector>
+
+#include "Offline/Offline.h"
+#include "Config/Config.h"
+#include "Packet/Wire.h"
+
+// the file standing in for the partition, and what was done to it
+int flash_file = -1;
+uint64_t bytes_written = 0;
+uint32_t sectors_erased = 0;
+
+// writes that still go through before a power cut, negative for no cut
+int writes_left = -1;
+
+bool power_cut(){
+    if (writes_left == 0) return true;
+    if (writes_left > 0) writes_left --;
+    return false;
+}
+
+bool file_read(uint32_t address, uint8_t* data, uint32_t length){
+    if (address + length > flash.size) return false;
+    return pread(flash_file, data, length, address) == (ssize_t)length;
+}
+
+// flash can only clear bits, so the new data is ANDed with what's there
+bool file_write(uint32_t address, const uint8_t* data, uint32_t length){
+    if (power_cut() || address + length > flash.size) return false;
+
+    std::vector<uint8_t> current(length);
+    if (pread(flash_file, current.data(), length, address) != (ssize_t)length) return false;
+    for (uint32_t i = 0; i < length; i++) current[i] &= data[i];
+
+    bytes_written += length;
+    return pwrite(flash_file, current.data(), length, address) == (ssize_t)length;
+}
+
+bool file_erase_sector(uint32_t address){
+    if (power_cut() || address + FLASH_SECTOR_SIZE > flash.size) return false;
+
+    uint8_t erased[FLASH_SECTOR_SIZE];
+    memset(erased, 0xFF, sizeof(erased));
+
+    sectors_erased ++;
+    return pwrite(flash_file, erased, sizeof(erased), address) == (ssize_t)sizeof(erased);
+}
+
+FlashBackend flash = {file_read, file_write, file_erase_sector, 0};
+
+// Wire.cpp's parse_argument logs through the device's send_log, nothing here calls it
+namespace BEC_E {
+    void send_log(const char*){}
+}
+
+// a blank partition with room for the log and the config
+void blank_flash(uint32_t sectors){
+    if (flash_file >= 0) close(flash_file);
+
+    char path[] = "/tmp/offline_bench_XXXXXX";
+    flash_file = mkstemp(path);
+    unlink(path);
+
+    flash.size = sectors * FLASH_SECTOR_SIZE;
+    for (uint32_t address = 0; address < flash.size; address += FLASH_SECTOR_SIZE) file_erase_sector(address);
+    bytes_written = 0;
+    sectors_erased = 0;
+}
+
+// a frame whose bytes say which frame it is
+std::vector<uint8_t> make_frame(uint32_t index, std::mt19937& rng){
+    std::vector<uint8_t> frame(16 + rng() % 240);
+    for (size_t i = 0; i < frame.size(); i++) frame[i] = (uint8_t)(index * 31 + i);
+    memcpy(frame.data(), &index, sizeof(index));
+    return frame;
+}
+
+// replays everything left, checking each frame is whole. Returns the frame numbers in the order they came out
+std::vector<uint32_t> replay_all(uint64_t* bytes = nullptr){
+    std::vector<uint32_t> order;
+    uint8_t frame[OFFLINE_MAX_FRAME];
+
+    OfflineRecord record;
+    while (offline_next(record)){
+        if (offline_read(record, frame)){
+            uint32_t index;
+            memcpy(&index, frame, sizeof(index));
+            order.push_back(index);
+            if (bytes) *bytes += record.length;
+        }
+        offline_pop(record);
+    }
+
+    return order;
+}
+
+bool in_order(const std::vector<uint32_t>& order, uint32_t first, uint32_t last){
+    if (order.size() != last - first) return false;
+    for (uint32_t i = 0; i < order.size(); i++){
+        if (order[i] != first + i) return false;
+    }
+    return true;
+}
+
+int failed = 0;
+
+void check(const char* name, bool passed){
+    printf("%-44s %s\n", name, passed ? "ok" : "FAIL");
+    failed += !passed;
+}
+
+double seconds_since(std::chrono::steady_clock::time_point start){
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+int main(int argc, char** argv){
+    uint32_t frames = argc > 1 ? atoi(argv[1]) : 2000;
+    std::mt19937 rng(5);
+    const uint32_t full_size = OFFLINE_SECTOR_COUNT + CONFIG_SECTOR_COUNT;
+
+    // few enough for the checks to fit in the log
+    const uint32_t check_frames = 200;
+
+    printf("%d sectors of %d bytes, replay paced every %dms on the device\n",
+        OFFLINE_SECTOR_COUNT, FLASH_SECTOR_SIZE, OFFLINE_REPLAY_INTERVAL_MS);
+
+    // frames survive a reboot and come back in order
+    blank_flash(full_size);
+    offline_open();
+    for (uint32_t i = 0; i < check_frames; i++){
+        std::vector<uint8_t> frame = make_frame(i, rng);
+        offline_append(frame.data(), frame.size());
+    }
+    offline_open();
+    check("frames come back in order after a reboot", in_order(replay_all(), 0, check_frames));
+
+    // replayed frames stay replayed after the next reboot
+    offline_open();
+    check("nothing replayed twice after a reboot", !offline_pending());
+
+    // the power goes while a record is being written, the frames before it are kept
+    blank_flash(full_size);
+    offline_open();
+    for (uint32_t i = 0; i < 10; i++){
+        std::vector<uint8_t> frame = make_frame(i, rng);
+        offline_append(frame.data(), frame.size());
+    }
+    {
+        // offline_append writes the header, then the frame, then marks it written. Cut it off before the last
+        std::vector<uint8_t> frame = make_frame(10, rng);
+        writes_left = 2;
+        offline_append(frame.data(), frame.size());
+        writes_left = -1;
+    }
+    offline_open();
+    check("a record cut off by a power loss is skipped", in_order(replay_all(), 0, 10));
+
+    // more than the log holds, the oldest sectors go and the rest stay in order
+    blank_flash(full_size);
+    offline_open();
+    uint32_t overflow = check_frames * 20;
+    for (uint32_t i = 0; i < overflow; i++){
+        std::vector<uint8_t> frame = make_frame(i, rng);
+        offline_append(frame.data(), frame.size());
+    }
+    std::vector<uint32_t> kept = replay_all();
+    check("a full log drops its oldest frames", !kept.empty() && kept.back() == overflow - 1
+        && in_order(kept, kept.front(), overflow));
+
+    // a partition too small for the log and the config
+    blank_flash(full_size - 1);
+    std::vector<uint8_t> frame = make_frame(0, rng);
+    check("a log overlapping the config is refused", !offline_open() && !offline_append(frame.data(), frame.size()));
+
+    // throughput. More frames than fit wrap around the log like a long outage would. Replay isn't paced here,
+    // on the device it's limited by OFFLINE_REPLAY_INTERVAL_MS
+    blank_flash(full_size);
+    offline_open();
+    std::vector<std::vector<uint8_t>> batch;
+    uint64_t payload = 0;
+    for (uint32_t i = 0; i < frames; i++){
+        batch.push_back(make_frame(i, rng));
+        payload += batch.back().size();
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    for (const std::vector<uint8_t>& frame : batch) offline_append(frame.data(), frame.size());
+    double append_s = seconds_since(start);
+    uint64_t append_written = bytes_written;
+    uint32_t append_erased = sectors_erased;
+
+    start = std::chrono::steady_clock::now();
+    uint64_t replayed_bytes = 0;
+    std::vector<uint32_t> replayed = replay_all(&replayed_bytes);
+    double replay_s = seconds_since(start);
+
+    printf("\n%u frames, %.0f bytes each on average\n", frames, (double)payload / frames);
+    printf("append  %9.0f frames/s  %7.2f MB/s   %.2f flash bytes written per payload byte, %u sectors erased\n",
+        frames / append_s, payload / append_s / 1e6, (double)append_written / payload, append_erased);
+    printf("replay  %9.0f frames/s  %7.2f MB/s   %zu frames still in the log\n",
+        replayed.size() / replay_s, replayed_bytes / replay_s / 1e6, replayed.size());
+
+    close(flash_file);
+    return failed == 0 ? 0 : 1;
+}
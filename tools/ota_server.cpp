@@ -0,0 +1,181 @@
+// stands in for the server's HTTP side during an update. Serves files from a directory laid out the way the
+// device asks for them, honours the Range header it sends when resuming, and can misbehave on purpose so the
+// resume and retry paths get exercised
+//
+// usage: ota_server [-p port] [-d drop after bytes] [-t bytes per second] [-i] root
+//   root holds IOT/firmware/<name>_version.txt, IOT/firmware/<name>/firmware.md5 and IOT/firmware/<name>/firmware.txt
+//   -d closes the connection after sending that many bytes of a body, like a dropped link
+//   -t throttles bodies to that rate so an update takes long enough to watch the progress packets
+//   -i ignores Range headers and always sends the whole file, like a server without range support
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <chrono>
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <thread>
+
+struct Options {
+    uint16_t port = 80;
+    uint32_t drop_after = 0;
+    uint32_t rate = 0;
+    bool ignore_range = false;
+    std::string root;
+};
+
+bool send_all(int sock, const char* data, size_t length){
+    while (length > 0){
+        ssize_t sent = send(sock, data, length, 0);
+        if (sent <= 0) return false;
+        data += sent;
+        length -= sent;
+    }
+    return true;
+}
+
+// reads up to the blank line ending the headers
+bool read_request(int sock, std::string& request){
+    char c;
+    while (request.find("\r\n\r\n") == std::string::npos){
+        if (recv(sock, &c, 1, 0) != 1 || request.size() > 4096) return false;
+        request += c;
+    }
+    return true;
+}
+
+void send_status(int sock, const char* status){
+    char response[128];
+    int length = snprintf(response, sizeof(response), "HTTP/1.0 %s\r\nContent-Length: 0\r\n\r\n", status);
+    send_all(sock, response, length);
+}
+
+void serve(int sock, const Options& options){
+    std::string request;
+    if (!read_request(sock, request)) return;
+
+    char path[256];
+    if (sscanf(request.c_str(), "GET %255s", path) != 1){
+        send_status(sock, "400 Bad Request");
+        return;
+    }
+
+    // the device only asks for files under the root
+    if (strstr(path, "..") != nullptr){
+        send_status(sock, "403 Forbidden");
+        return;
+    }
+
+    std::string file = options.root + path;
+    FILE* input = fopen(file.c_str(), "rb");
+    struct stat info;
+    if (input == nullptr || fstat(fileno(input), &info) != 0){
+        printf("GET %s  404\n", path);
+        send_status(sock, "404 Not Found");
+        if (input) fclose(input);
+        return;
+    }
+    uint32_t size = info.st_size;
+
+    // a resuming device asks for bytes=<offset>-
+    uint32_t start = 0;
+    const char* range = strcasestr(request.c_str(), "\r\nRange: bytes=");
+    if (range != nullptr && !options.ignore_range) start = strtoul(range + 15, nullptr, 10);
+
+    char headers[256];
+    int length;
+    if (range != nullptr && !options.ignore_range && start < size){
+        length = snprintf(headers, sizeof(headers),
+            "HTTP/1.0 206 Partial Content\r\nContent-Length: %u\r\nContent-Range: bytes %u-%u/%u\r\n\r\n",
+            size - start, start, size - 1, size);
+    }
+    else {
+        start = 0;
+        length = snprintf(headers, sizeof(headers), "HTTP/1.0 200 OK\r\nContent-Length: %u\r\n\r\n", size);
+    }
+
+    printf("GET %s  from %u of %u%s\n", path, start, size, range != nullptr && options.ignore_range ? " (range ignored)" : "");
+    fflush(stdout);
+    send_all(sock, headers, length);
+
+    fseek(input, start, SEEK_SET);
+    char chunk[1024];
+    uint32_t sent = 0;
+    auto begin = std::chrono::steady_clock::now();
+
+    size_t read;
+    while ((read = fread(chunk, 1, sizeof(chunk), input)) > 0){
+        // stop part way through, the device should come back for the rest
+        if (options.drop_after > 0 && sent + read > options.drop_after){
+            send_all(sock, chunk, options.drop_after - sent);
+            sent = options.drop_after;
+            printf("    dropped after %u bytes\n", sent);
+            fflush(stdout);
+            break;
+        }
+
+        if (!send_all(sock, chunk, read)) break;
+        sent += read;
+
+        if (options.rate > 0){
+            std::this_thread::sleep_until(begin + std::chrono::microseconds((uint64_t)sent * 1000000 / options.rate));
+        }
+    }
+
+    fclose(input);
+}
+
+int main(int argc, char** argv){
+    Options options;
+
+    int option;
+    while ((option = getopt(argc, argv, "p:d:t:i")) != -1){
+        switch (option){
+            case 'p': options.port = atoi(optarg); break;
+            case 'd': options.drop_after = strtoul(optarg, nullptr, 10); break;
+            case 't': options.rate = strtoul(optarg, nullptr, 10); break;
+            case 'i': options.ignore_range = true; break;
+            default:
+                fprintf(stderr, "usage: %s [-p port] [-d drop after bytes] [-t bytes per second] [-i] root\n", argv[0]);
+                return 1;
+        }
+    }
+
+    if (optind >= argc){
+        fprintf(stderr, "usage: %s [-p port] [-d drop after bytes] [-t bytes per second] [-i] root\n", argv[0]);
+        return 1;
+    }
+    options.root = argv[optind];
+    signal(SIGPIPE, SIG_IGN);
+
+    int listener = socket(AF_INET, SOCK_STREAM, 0);
+    int one = 1;
+    setsockopt(listener, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+
+    sockaddr_in address = {};
+    address.sin_family = AF_INET;
+    address.sin_port = htons(options.port);
+    address.sin_addr.s_addr = htonl(INADDR_ANY);
+    if (bind(listener, (sockaddr*)&address, sizeof(address)) != 0 || listen(listener, 8) != 0){
+        perror("listen");
+        return 1;
+    }
+
+    printf("serving %s on port %d\n", options.root.c_str(), options.port);
+    fflush(stdout);
+
+    // one device at a time, it only ever has one request open
+    while (true){
+        int sock = accept(listener, nullptr, nullptr);
+        if (sock < 0) continue;
+
+        serve(sock, options);
+        close(sock);
+    }
+}
@@ -0,0 +1,159 @@
+// compares sending every reading as its own packet with the delta/zigzag/varint sample batches, in bytes on the wire
+// and host CPU time per sample. The batches are decoded again to check nothing is lost
+//
+// usage: sampling_bench [samples]
+
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+#include "bece_protocol.h"
+#include "Encoding/Encoding.h"
+#include "Sampling/Sampling.h"
+
+const size_t FRAME_OVERHEAD = sizeof(PacketHeader) + sizeof(uint16_t);
+
+// keeps the compiler from throwing the work away
+volatile uint32_t sink;
+
+int64_t now_ns(){
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// the current way: one typed UINT32/INT32 argument per packet
+size_t per_reading(const std::vector<int32_t>& samples){
+    uint8_t frame[FRAME_OVERHEAD + 1 + sizeof(int32_t)];
+    size_t bytes = 0;
+
+    for (size_t i = 0; i < samples.size(); i++){
+        PacketHeader header = {MAGIC, COMMAND_SET, 1, (uint32_t)i, 0, 1, 1 + sizeof(int32_t), 1};
+        memcpy(frame, &header, sizeof(header));
+        frame[sizeof(header)] = Argument::INT32;
+        memcpy(frame + sizeof(header) + 1, &samples[i], sizeof(int32_t));
+
+        uint16_t crc = bece::crc16(frame, sizeof(frame) - sizeof(crc));
+        memcpy(frame + sizeof(frame) - sizeof(crc), &crc, sizeof(crc));
+
+        sink += frame[sizeof(frame) - 1];
+        bytes += sizeof(frame);
+    }
+
+    return bytes;
+}
+
+// the sampling module: records batched into SAMPLE_PACKET_SIZE packets
+size_t batched(const std::vector<int32_t>& records, uint8_t width, bool check){
+    uint8_t frame[sizeof(PacketHeader) + SAMPLE_PACKET_SIZE + sizeof(uint16_t)];
+    uint8_t* payload = frame + sizeof(PacketHeader);
+    size_t bytes = 0;
+
+    size_t total = records.size() / width;
+    for (size_t start = 0; start < total;){
+        uint16_t count = (uint16_t)std::min<size_t>(total - start, UINT16_MAX);
+        uint16_t written;
+        size_t length = encode_deltas(records.data() + start * width, count, width, payload + sizeof(SampleBatchHeader),
+            SAMPLE_PACKET_SIZE - sizeof(SampleBatchHeader), &written);
+
+        SampleBatchHeader batch = {1, written, 0, Argument::INT32, 1, 1000, start * 1000, 0, 0};
+        memcpy(payload, &batch, sizeof(batch));
+
+        PacketHeader header = {MAGIC, COMMAND_SET, bece::SAMPLE_BATCH, (uint32_t)start, 0, 1, (uint16_t)(sizeof(batch) + length), 0};
+        memcpy(frame, &header, sizeof(header));
+        size_t frame_length = sizeof(header) + sizeof(batch) + length;
+        uint16_t crc = bece::crc16(frame, frame_length);
+        memcpy(frame + frame_length, &crc, sizeof(crc));
+
+        if (check){
+            std::vector<int32_t> decoded(written * width);
+            if (decode_deltas(payload + sizeof(batch), length, written, width, decoded.data()) != length
+                || memcmp(decoded.data(), records.data() + start * width, decoded.size() * sizeof(int32_t)) != 0){
+                printf("decode mismatch at record %zu\n", start);
+                exit(1);
+            }
+        }
+
+        sink += crc;
+        bytes += frame_length + sizeof(crc);
+        start += written;
+    }
+
+    return bytes;
+}
+
+// min, max and mean of every window samples, as the SAMPLE_DECIMATE records
+std::vector<int32_t> decimate(const std::vector<int32_t>& samples, size_t window){
+    std::vector<int32_t> records;
+
+    for (size_t start = 0; start + window <= samples.size(); start += window){
+        int32_t low = samples[start], high = samples[start];
+        int64_t sum = 0;
+        for (size_t i = start; i < start + window; i++){
+            low = std::min(low, samples[i]);
+            high = std::max(high, samples[i]);
+            sum += samples[i];
+        }
+
+        records.push_back(low);
+        records.push_back(high);
+        records.push_back((int32_t)(sum / (int64_t)window));
+    }
+
+    return records;
+}
+
+template <typename F>
+double time_per_sample(size_t samples, F work){
+    int64_t start = now_ns();
+    work();
+    return (double)(now_ns() - start) / samples;
+}
+
+void report(const char* name, const std::vector<int32_t>& samples){
+    size_t n = samples.size();
+    const size_t window = 10;
+    std::vector<int32_t> decimated = decimate(samples, window);
+
+    batched(samples, 1, true);
+    batched(decimated, 3, true);
+
+    size_t single_bytes = 0, batch_bytes = 0, decimated_bytes = 0;
+    double single_ns = time_per_sample(n, [&](){ single_bytes = per_reading(samples); });
+    double batch_ns = time_per_sample(n, [&](){ batch_bytes = batched(samples, 1, false); });
+    double decimated_ns = time_per_sample(n, [&](){ decimated_bytes = batched(decimated, 3, false); });
+
+    printf("%-14s packet per reading %6.2f B/sample %6.1f ns | raw batch %5.2f B/sample %5.1f ns | decimate 1:%zu %5.2f B/sample %5.1f ns\n",
+        name, (double)single_bytes / n, single_ns, (double)batch_bytes / n, batch_ns, window, (double)decimated_bytes / n, decimated_ns);
+}
+
+int main(int argc, char** argv){
+    size_t n = argc > 1 ? atol(argv[1]) : 200000;
+    srand(1);
+
+    // a temperature in hundredths of a degree wandering slowly
+    std::vector<int32_t> temperature(n);
+    int32_t t = 2150;
+    for (size_t i = 0; i < n; i++){
+        if (rand() % 8 == 0) t += rand() % 3 - 1;
+        temperature[i] = t;
+    }
+
+    // an accelerometer axis: a vibration with sensor noise
+    std::vector<int32_t> vibration(n);
+    for (size_t i = 0; i < n; i++){
+        vibration[i] = (int32_t)(800 * sin(i * 0.05) + rand() % 41 - 20);
+    }
+
+    // a free running counter
+    std::vector<int32_t> counter(n);
+    for (size_t i = 0; i < n; i++){
+        counter[i] = (int32_t)(0xFFFFFF00u + i * 3);
+    }
+
+    report("temperature", temperature);
+    report("vibration", vibration);
+    report("counter", counter);
+
+    return 0;
+}
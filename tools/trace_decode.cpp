@@ -0,0 +1,132 @@
+// turns TRACE_DUMP packets from a device into Chrome trace JSON, which can be opened in Perfetto or chrome://tracing.
+// The input is the raw bytes sent by the device, anything that isn't a valid TRACE_DUMP packet is skipped
+//
+// usage: trace_decode dump.bin > trace.json
+
+#include <cstdio>
+#include <map>
+#include <vector>
+
+#include "bece_protocol.h"
+#include "Trace/Trace.h"
+
+const char* event_name(uint16_t event){
+    switch (event){
+        case TRACE_PACKET_HEADER:   return "packet header";
+        case TRACE_PACKET_RECEIVED: return "packet received";
+        case TRACE_PACKET_BAD_CRC:  return "bad crc";
+        case TRACE_PACKET_SENT:     return "packet sent";
+        case TRACE_PACKET_QUEUED:   return "packet queued";
+        case TRACE_COMMAND:         return "command";
+        case TRACE_COMMAND_UNKNOWN: return "unknown command";
+        case TRACE_CONNECTED:       return "connected";
+        case TRACE_DISCONNECTED:    return "disconnected";
+        case TRACE_CONNECT_FAILED:  return "connect failed";
+        case TRACE_CONNECT_RACE:    return "connect race";
+    }
+    return nullptr;
+}
+
+const char* category_name(uint8_t category){
+    switch (category){
+        case TRACE_CATEGORY_PACKET:     return "packet";
+        case TRACE_CATEGORY_COMMAND:    return "command";
+        case TRACE_CATEGORY_CONNECTION: return "connection";
+        case TRACE_CATEGORY_USER:       return "user";
+    }
+    return "unknown";
+}
+
+int main(int argc, char** argv){
+    if (argc < 2){
+        fprintf(stderr, "usage: %s dump.bin > trace.json\n", argv[0]);
+        return 1;
+    }
+
+    FILE* file = fopen(argv[1], "rb");
+    if (file == nullptr){
+        perror(argv[1]);
+        return 1;
+    }
+
+    std::vector<uint8_t> data;
+    uint8_t chunk[4096];
+    size_t read;
+    while ((read = fread(chunk, 1, sizeof(chunk), file)) > 0) data.insert(data.end(), chunk, chunk + read);
+    fclose(file);
+
+    // events by their index since boot, so packets sent twice or out of order don't matter
+    std::map<uint32_t, TraceEvent> events;
+    uint32_t overwritten = 0;
+
+    for (size_t offset = 0; offset + sizeof(PacketHeader) + sizeof(uint16_t) <= data.size();){
+        PacketHeader header;
+        memcpy(&header, data.data() + offset, sizeof(header));
+        size_t length = sizeof(PacketHeader) + header.payload_len + sizeof(uint16_t);
+
+        if (offset + length > data.size() || !bece::valid_frame(data.data() + offset, length)){
+            offset ++;
+            continue;
+        }
+
+        const uint8_t* payload = data.data() + offset + sizeof(PacketHeader);
+        offset += length;
+
+        if (header.type != bece::TRACE_DUMP || header.payload_len < sizeof(TraceDumpHeader)) continue;
+
+        TraceDumpHeader dump;
+        memcpy(&dump, payload, sizeof(dump));
+        if (sizeof(dump) + dump.event_count * sizeof(TraceEvent) > header.payload_len) continue;
+
+        if (dump.total_events > TRACE_RING_SIZE) overwritten = dump.total_events - TRACE_RING_SIZE;
+
+        for (uint16_t i = 0; i < dump.event_count; i++){
+            TraceEvent event;
+            memcpy(&event, payload + sizeof(dump) + i * sizeof(TraceEvent), sizeof(event));
+            events[dump.first_index + i] = event;
+        }
+    }
+
+    if (events.empty()){
+        fprintf(stderr, "no trace events found\n");
+        return 1;
+    }
+
+    printf("{\"traceEvents\":[\n");
+
+    // one track per category
+    bool first = true;
+    for (uint8_t category : {TRACE_CATEGORY_PACKET, TRACE_CATEGORY_COMMAND, TRACE_CATEGORY_CONNECTION, TRACE_CATEGORY_USER}){
+        printf("%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%u,\"args\":{\"name\":\"%s\"}}",
+            first ? "" : ",\n", category, category_name(category));
+        first = false;
+    }
+
+    // micros() wraps every 71 minutes, keep the times increasing
+    uint64_t wraps = 0;
+    uint32_t last_us = events.begin()->second.timestamp_us;
+
+    for (const auto& entry : events){
+        const TraceEvent& event = entry.second;
+        if (event.timestamp_us < last_us && last_us - event.timestamp_us > 0x80000000u) wraps ++;
+        last_us = event.timestamp_us;
+
+        uint8_t category = TRACE_EVENT_CATEGORY(event.event);
+        const char* phase = event.phase == TRACE_BEGIN ? "B" : event.phase == TRACE_END ? "E" : "i";
+
+        char name[32];
+        const char* known = event_name(event.event);
+        if (known != nullptr) snprintf(name, sizeof(name), "%s", known);
+        else snprintf(name, sizeof(name), "%s %u", category_name(category), event.event & 0xFF);
+
+        printf(",\n{\"name\":\"%s\",\"cat\":\"%s\",\"ph\":\"%s\",%s\"ts\":%llu,\"pid\":1,\"tid\":%u,\"args\":{\"index\":%u,\"arg0\":%u,\"arg1\":%u}}",
+            name, category_name(category), phase, event.phase == TRACE_INSTANT ? "\"s\":\"t\"," : "",
+            (unsigned long long)(wraps * 0x100000000ULL + event.timestamp_us), category, entry.first, event.arg0, event.arg1);
+    }
+
+    printf("\n]}\n");
+
+    fprintf(stderr, "%zu events, %u overwritten before the dump\n", events.size(), overwritten);
+
+    return 0;
+}
@@ -0,0 +1,99 @@
+// drives the device's wifi_connect_step against a fake radio on a simulated clock, the way connect_wifi does.
+// Checks each scenario ends the way it should, then prints how long the fast path and the scan took
+//
+// usage: wifi_connect_sim
+
+#include <cstdio>
+#include <cstring>
+
+#include "FastConnect/FastConnect.h"
+
+// how long the fake access point takes to answer. A scan has to listen on every channel and then do DHCP
+const unsigned long ASSOCIATE_MS = 180;
+const unsigned long SCAN_MS = 2400;
+
+// a fake radio with one access point. Only connects once its association time has passed
+struct FakeRadio {
+    bool present = true;            // whether the access point is there at all
+    uint8_t channel = 6;
+    uint8_t bssid[6] = {2, 0, 0, 0, 0, 1};
+
+    bool associating = false;
+    unsigned long connect_at = 0;
+
+    void begin_fast(uint8_t cached_channel, const uint8_t* cached_bssid, unsigned long now){
+        // a direct association only works if the access point is still where the cache says
+        associating = present && cached_channel == channel && memcmp(cached_bssid, bssid, sizeof(bssid)) == 0;
+        connect_at = now + ASSOCIATE_MS;
+    }
+
+    void begin_scan(unsigned long now){
+        associating = present;
+        connect_at = now + SCAN_MS;
+    }
+
+    bool connected(unsigned long now) const {
+        return associating && now >= connect_at;
+    }
+};
+
+struct Scenario {
+    const char* name;
+    bool has_cache;
+    uint8_t cached_channel;     // the access point is always on channel 6
+    bool present;
+    wifi_connect_phase expect;  // how the attempt has to end
+    bool expect_fast;           // whether it should have got there without scanning
+};
+
+// the same loop as connect_wifi, with the radio calls going to the fake and delay advancing the clock
+bool run(const Scenario& scenario, WiFiConnectState& state){
+    FakeRadio radio;
+    radio.present = scenario.present;
+
+    uint8_t cached_bssid[6] = {2, 0, 0, 0, 0, 1};
+    unsigned long now = 1000;
+    wifi_connect_init(state, scenario.has_cache, now);
+
+    while (true){
+        switch (wifi_connect_step(state, radio.connected(now), now)){
+            case WIFI_BEGIN_FAST:
+                radio.begin_fast(scenario.cached_channel, cached_bssid, now);
+            break;
+            case WIFI_BEGIN_SCAN:
+                radio.begin_scan(now);
+            break;
+            case WIFI_WAIT:
+                now += WIFI_POLL_INTERVAL_MS;
+            break;
+            case WIFI_DONE:
+            case WIFI_GIVE_UP:
+                return state.phase == scenario.expect && (state.scan_ms == 0) == scenario.expect_fast;
+        }
+    }
+}
+
+int main(){
+    const Scenario scenarios[] = {
+        {"first boot, nothing cached",      false, 0, true,  WIFI_CONNECTED, false},
+        {"cached access point",             true,  6, true,  WIFI_CONNECTED, true},
+        {"access point changed channel",    true,  11, true, WIFI_CONNECTED, false},
+        {"no network, nothing cached",      false, 0, false, WIFI_FAILED,    false},
+        {"no network, cached",              true,  6, false, WIFI_FAILED,    false},
+    };
+
+    printf("poll every %dms, fast path times out after %dms, scan after %ds\n",
+        WIFI_POLL_INTERVAL_MS, WIFI_FAST_CONNECT_TIMEOUT_MS, WIFI_TIMEOUT_SECONDS);
+
+    int failed = 0;
+    for (const Scenario& scenario : scenarios){
+        WiFiConnectState state;
+        bool passed = run(scenario, state);
+        failed += !passed;
+
+        printf("%-34s %-4s %-9s in %5lums (fast %4lums, scan %5lums)\n", scenario.name, passed ? "ok" : "FAIL",
+            state.phase == WIFI_CONNECTED ? "connected" : "gave up", state.total_ms, state.fast_ms, state.scan_ms);
+    }
+
+    return failed == 0 ? 0 : 1;
+}